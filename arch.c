@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2004, Apple Computer, Inc. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1.  Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer. 
+ * 2.  Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution. 
+ * 3.  Neither the name of Apple Computer, Inc. ("Apple") nor the names of
+ *     its contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY APPLE AND ITS CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL APPLE OR ITS CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * Adapted from Apple sources for segedit compilation on Linux.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arch.h"
+
+/*
+ * The array of all currently know architecture flags (terminated with an entry
+ * with all zeros).
+ */
+static const struct arch_flag arch_flags[] = {
+    /* architecture families */
+    { "ppc",    CPU_TYPE_POWERPC, CPU_SUBTYPE_POWERPC_ALL },
+    { "ppc64",  CPU_TYPE_POWERPC64, CPU_SUBTYPE_POWERPC_ALL },
+    { "i386",   CPU_TYPE_I386,    CPU_SUBTYPE_I386_ALL },
+    { "x86_64", CPU_TYPE_X86_64, CPU_SUBTYPE_X86_64_ALL },
+    { "x86_64h", CPU_TYPE_X86_64, CPU_SUBTYPE_X86_64_H },
+    { "arm",    CPU_TYPE_ARM,     CPU_SUBTYPE_ARM_ALL },
+    { "arm64",  CPU_TYPE_ARM64,     CPU_SUBTYPE_ARM64_ALL },
+    { "arm64e", CPU_TYPE_ARM64,     CPU_SUBTYPE_ARM64E },
+    { "arm64_32", CPU_TYPE_ARM64_32, CPU_SUBTYPE_ARM64_32_ALL },
+    { "m68k",   CPU_TYPE_MC680x0, CPU_SUBTYPE_MC680x0_ALL },
+    { "hppa",   CPU_TYPE_HPPA,    CPU_SUBTYPE_HPPA_ALL },
+    { "sparc",	CPU_TYPE_SPARC,   CPU_SUBTYPE_SPARC_ALL },
+    { "m88k",   CPU_TYPE_MC88000, CPU_SUBTYPE_MC88000_ALL },
+    { "i860",   CPU_TYPE_I860,    CPU_SUBTYPE_I860_ALL },
+    /* specific architecture implementations */
+    { "ppc601", CPU_TYPE_POWERPC, CPU_SUBTYPE_POWERPC_601 },
+    { "ppc603", CPU_TYPE_POWERPC, CPU_SUBTYPE_POWERPC_603 },
+    { "ppc603e",CPU_TYPE_POWERPC, CPU_SUBTYPE_POWERPC_603e },
+    { "ppc603ev",CPU_TYPE_POWERPC,CPU_SUBTYPE_POWERPC_603ev },
+    { "ppc604", CPU_TYPE_POWERPC, CPU_SUBTYPE_POWERPC_604 },
+    { "ppc604e",CPU_TYPE_POWERPC, CPU_SUBTYPE_POWERPC_604e },
+    { "ppc750", CPU_TYPE_POWERPC, CPU_SUBTYPE_POWERPC_750 },
+    { "ppc7400",CPU_TYPE_POWERPC, CPU_SUBTYPE_POWERPC_7400 },
+    { "ppc7450",CPU_TYPE_POWERPC, CPU_SUBTYPE_POWERPC_7450 },
+    { "ppc970", CPU_TYPE_POWERPC, CPU_SUBTYPE_POWERPC_970 },
+    { "ppc970-64",  CPU_TYPE_POWERPC64, CPU_SUBTYPE_POWERPC_970 },
+    { "i486",   CPU_TYPE_I386,    CPU_SUBTYPE_486 },
+    { "i486SX", CPU_TYPE_I386,    CPU_SUBTYPE_486SX },
+    { "pentium",CPU_TYPE_I386,    CPU_SUBTYPE_PENT }, /* same as i586 */
+    { "i586",   CPU_TYPE_I386,    CPU_SUBTYPE_PENT },
+    { "pentpro", CPU_TYPE_I386, CPU_SUBTYPE_PENTPRO }, /* same as i686 */
+    { "i686",   CPU_TYPE_I386, CPU_SUBTYPE_PENTPRO },
+    { "pentIIm3",CPU_TYPE_I386, CPU_SUBTYPE_PENTII_M3 },
+    { "pentIIm5",CPU_TYPE_I386, CPU_SUBTYPE_PENTII_M5 },
+    { "pentium4",CPU_TYPE_I386, CPU_SUBTYPE_PENTIUM_4 },
+    { "m68030", CPU_TYPE_MC680x0, CPU_SUBTYPE_MC68030_ONLY },
+    { "m68040", CPU_TYPE_MC680x0, CPU_SUBTYPE_MC68040 },
+    { "hppa7100LC", CPU_TYPE_HPPA,  CPU_SUBTYPE_HPPA_7100LC },
+    { "armv4t", CPU_TYPE_ARM,     CPU_SUBTYPE_ARM_V4T},
+    { "armv5",  CPU_TYPE_ARM,     CPU_SUBTYPE_ARM_V5TEJ},
+    { "xscale", CPU_TYPE_ARM,     CPU_SUBTYPE_ARM_XSCALE},
+    { "armv6",  CPU_TYPE_ARM,     CPU_SUBTYPE_ARM_V6 },
+    { "armv6m", CPU_TYPE_ARM,     CPU_SUBTYPE_ARM_V6M },
+    { "armv7",  CPU_TYPE_ARM,     CPU_SUBTYPE_ARM_V7 },
+    { "armv7f", CPU_TYPE_ARM,     CPU_SUBTYPE_ARM_V7F },
+    { "armv7s", CPU_TYPE_ARM,     CPU_SUBTYPE_ARM_V7S },
+    { "armv7k", CPU_TYPE_ARM,     CPU_SUBTYPE_ARM_V7K },
+    { "armv7m", CPU_TYPE_ARM,     CPU_SUBTYPE_ARM_V7M },
+    { "armv7em", CPU_TYPE_ARM,    CPU_SUBTYPE_ARM_V7EM },
+    { "armv8",  CPU_TYPE_ARM,     CPU_SUBTYPE_ARM_V8 },
+    { "arm64v8",CPU_TYPE_ARM64,   CPU_SUBTYPE_ARM64_V8 },
+    { NULL,	0,		  0 }
+};
+
+/*
+ * get_arch_from_flag() is passed a name of an architecture flag and returns
+ * zero if that flag is not known and non-zero if the flag is known.
+ * If the pointer to the arch_flag is not NULL it is filled in with the
+ * arch_flag struct that matches the name.
+ */
+__private_extern__
+int
+get_arch_from_flag(
+char *name,
+struct arch_flag *arch_flag)
+{
+    uint32_t i;
+
+	for(i = 0; arch_flags[i].name != NULL; i++){
+	    if(strcmp(arch_flags[i].name, name) == 0){
+		if(arch_flag != NULL)
+		    *arch_flag = arch_flags[i];
+		return(1);
+	    }
+	}
+	if(arch_flag != NULL)
+	    memset(arch_flag, '\0', sizeof(struct arch_flag));
+	return(0);
+}
+
+/*
+ * get_arch_name_from_types() returns the name of the architecture for the
+ * specified cputype and cpusubtype if known.  If unknown it returns a pointer
+ * to the an allocated string "cputype X cpusubtype Y" where X and Y are decimal
+ * values.
+ */
+__private_extern__
+const char *
+get_arch_name_from_types(
+cpu_type_t cputype,
+cpu_subtype_t cpusubtype)
+{
+    const char *name;
+    char *p;
+
+	if((p = malloc(ARCH_NAME_SIZE)) == NULL)
+	    return("unknown");
+	name = format_arch_name(cputype, cpusubtype, p, ARCH_NAME_SIZE);
+	if(name != p)
+	    free(p);
+	return(name);
+}
+
+/*
+ * format_arch_name() is get_arch_name_from_types() without the allocation: the
+ * name of an unknown architecture is written to buf, which is returned, and is
+ * cut short if it does not fit in size bytes.
+ */
+__private_extern__
+const char *
+format_arch_name(
+cpu_type_t cputype,
+cpu_subtype_t cpusubtype,
+char *buf,
+size_t size)
+{
+    uint32_t i;
+
+	for(i = 0; arch_flags[i].name != NULL; i++){
+	    if(arch_flags[i].cputype == cputype &&
+	       (arch_flags[i].cpusubtype & ~CPU_SUBTYPE_MASK) ==
+	       (cpusubtype & ~CPU_SUBTYPE_MASK))
+		return(arch_flags[i].name);
+	}
+	snprintf(buf, size, "cputype %d cpusubtype %d", cputype,
+		 cpusubtype & ~CPU_SUBTYPE_MASK);
+	return(buf);
+}
+
+/*
+ * arch_flag_matches() returns non-zero if the cputype and cpusubtype of an
+ * object are those of the specified arch_flag.  The capability bits of the
+ * cpusubtype are ignored.
+ */
+__private_extern__
+int
+arch_flag_matches(
+struct arch_flag *arch_flag,
+cpu_type_t cputype,
+cpu_subtype_t cpusubtype)
+{
+	return(arch_flag->cputype == cputype &&
+	       (arch_flag->cpusubtype & ~CPU_SUBTYPE_MASK) ==
+	       (cpusubtype & ~CPU_SUBTYPE_MASK));
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2004, Apple Computer, Inc. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1.  Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer. 
+ * 2.  Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution. 
+ * 3.  Neither the name of Apple Computer, Inc. ("Apple") nor the names of
+ *     its contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY APPLE AND ITS CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL APPLE OR ITS CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * Adapted from Apple sources for segedit compilation on Linux.
+ */
+#ifndef _STUFF_ARCH_H_
+#define _STUFF_ARCH_H_
+
+#if !defined(__private_extern__)
+#define __private_extern__ 
+#endif
+
+#include <stddef.h>
+#include "mach-machine.h"
+
+/*
+ * The structure describing an architecture flag with the string of the flag
+ * name, and the cputype and cpusubtype.
+ */
+struct arch_flag {
+    char *name;
+    cpu_type_t cputype;
+    cpu_subtype_t cpusubtype;
+};
+
+/*
+ * get_arch_from_flag() is passed a name of an architecture flag and returns
+ * zero if that flag is not known and non-zero if the flag is known.
+ * If the pointer to the arch_flag is not NULL it is filled in with the
+ * arch_flag struct that matches the name.
+ */
+__private_extern__ int get_arch_from_flag(
+    char *name,
+    struct arch_flag *arch_flag);
+
+/*
+ * get_arch_name_from_types() returns the name of the architecture for the
+ * specified cputype and cpusubtype if known.  If unknown it returns a pointer
+ * to the an allocated string "cputype X cpusubtype Y" where X and Y are decimal
+ * values.
+ */
+__private_extern__ const char *get_arch_name_from_types(
+    cpu_type_t cputype,
+    cpu_subtype_t cpusubtype);
+
+/*
+ * format_arch_name() is get_arch_name_from_types() without the allocation: the
+ * name of an unknown architecture is written to buf, which is returned, and is
+ * cut short if it does not fit in size bytes.  ARCH_NAME_SIZE bytes hold the
+ * name of any architecture.
+ */
+#define ARCH_NAME_SIZE 64
+__private_extern__ const char *format_arch_name(
+    cpu_type_t cputype,
+    cpu_subtype_t cpusubtype,
+    char *buf,
+    size_t size);
+
+/*
+ * arch_flag_matches() returns non-zero if the cputype and cpusubtype of an
+ * object are those of the specified arch_flag.  The capability bits of the
+ * cpusubtype are ignored.
+ */
+__private_extern__ int arch_flag_matches(
+    struct arch_flag *arch_flag,
+    cpu_type_t cputype,
+    cpu_subtype_t cpusubtype);
+
+#endif /* _STUFF_ARCH_H_ */
@@ -0,0 +1,499 @@
+/*
+ * benchgen, which writes synthetic Mach-O files for the benchmark.
+ *
+ * Each file has one __DATA segment with the requested number of sections,
+ * named __sect0, __sect1 and so on, each of the same size.  The section
+ * contents follow the load commands, 16 byte aligned, and are filled with a
+ * byte pattern unless -sparse is given, in which case the file is extended
+ * over them without writing them.  With -nsegs the segments __SEG1, __SEG2 and
+ * so on follow, with the same sections, each starting on a page in the file
+ * and a megabyte further in memory, so that segments can grow and move.  With
+ * -nsyms a symbol table follows, with symbols named _sym0, _sym1 and so on
+ * that are spread over the sections of __DATA, 16 bytes apart.  The headers
+ * and symbols are written from the structs in mach-o-loader.h and
+ * mach-o-nlist.h, in the host byte sex or with -swapped in the other one.
+ */
+#define _FILE_OFFSET_BITS 64
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#include "mach-machine.h"
+#include "mach-o-loader.h"
+#include "bytesex.h"
+
+/* from <mach/vm_prot.h>, which is not included here */
+#define VM_PROT_READ	((vm_prot_t) 0x01)
+#define VM_PROT_WRITE	((vm_prot_t) 0x02)
+
+#define fatal(...) { \
+  fprintf(stderr, "%s: ", progname); \
+  fprintf(stderr, __VA_ARGS__); \
+  fprintf(stderr, "\n"); \
+  exit(1); \
+}
+
+static char *progname;
+
+/* These variables are set from the command line arguments */
+static int is_32;		/* write 32-bit objects */
+static int swapped;		/* write the headers in the other byte sex */
+static int sparse;		/* don't write the section contents */
+static uint32_t nsegs = 1;	/* number of segments in each object */
+static uint32_t nsects = 1;	/* number of sections in each segment */
+static uint32_t nsyms;		/* number of symbols, 0 for no symbol table */
+static uint64_t sectsize = 4096;/* size of each section */
+static uint32_t count = 1;	/* number of files to write */
+static int numbered;		/* append numbers to the file names */
+
+/* Internal routines */
+static void write_object(
+    const char *filename);
+static uint64_t headers_size(void);
+static char *make_headers(
+    uint64_t symbols_size,
+    uint64_t *header_size,
+    uint64_t *file_size);
+static char *make_symbols(
+    uint64_t *symbols_size);
+static void write_all(
+    int fd,
+    const char *filename,
+    const char *buf,
+    uint64_t size);
+static uint64_t get_number(
+    const char *option,
+    const char *arg);
+static void usage(void);
+
+int
+main(
+int argc,
+char *argv[])
+{
+    int i;
+    uint32_t j;
+    char *output, *filename;
+
+	progname = argv[0];
+	output = NULL;
+	for(i = 1; i < argc; i++){
+	    if(strcmp(argv[i], "-32") == 0)
+		is_32 = 1;
+	    else if(strcmp(argv[i], "-swapped") == 0)
+		swapped = 1;
+	    else if(strcmp(argv[i], "-sparse") == 0)
+		sparse = 1;
+	    else if(strcmp(argv[i], "-nsegs") == 0 && i + 1 < argc){
+		nsegs = get_number(argv[i], argv[i + 1]);
+		i++;
+	    }
+	    else if(strcmp(argv[i], "-nsects") == 0 && i + 1 < argc){
+		nsects = get_number(argv[i], argv[i + 1]);
+		i++;
+	    }
+	    else if(strcmp(argv[i], "-nsyms") == 0 && i + 1 < argc){
+		nsyms = get_number(argv[i], argv[i + 1]);
+		i++;
+	    }
+	    else if(strcmp(argv[i], "-size") == 0 && i + 1 < argc){
+		sectsize = get_number(argv[i], argv[i + 1]);
+		i++;
+	    }
+	    else if(strcmp(argv[i], "-count") == 0 && i + 1 < argc){
+		count = get_number(argv[i], argv[i + 1]);
+		numbered = 1;
+		i++;
+	    }
+	    else if(argv[i][0] == '-' || output != NULL)
+		usage();
+	    else
+		output = argv[i];
+	}
+	if(output == NULL || nsegs == 0 || nsects == 0 || count == 0)
+	    usage();
+	if(is_32 && sectsize > UINT32_MAX)
+	    fatal("section size too large for a 32-bit object: %llu",
+		  (unsigned long long)sectsize);
+	if((uint64_t)(nsyms + nsects - 1) / nsects * 16 > sectsize)
+	    fatal("too many symbols for sections of %llu bytes: %u",
+		  (unsigned long long)sectsize, nsyms);
+
+	/* with -count the files are named <output>.0, <output>.1 and so on */
+	if(numbered == 0){
+	    write_object(output);
+	    return(0);
+	}
+	filename = malloc(strlen(output) + 12);
+	if(filename == NULL)
+	    fatal("virtual memory exhausted (malloc failed)");
+	for(j = 0; j < count; j++){
+	    sprintf(filename, "%s.%u", output, j);
+	    write_object(filename);
+	}
+	free(filename);
+	return(0);
+}
+
+/*
+ * write_object writes one object to the file.
+ */
+static
+void
+write_object(
+const char *filename)
+{
+    int fd;
+    char *headers, *buf, *symbols;
+    uint64_t header_size, file_size, symbols_size, pos, len;
+
+	symbols = NULL;
+	symbols_size = 0;
+	if(nsyms != 0)
+	    symbols = make_symbols(&symbols_size);
+	headers = make_headers(symbols_size, &header_size, &file_size);
+	if((fd = open(filename, O_WRONLY|O_CREAT|O_TRUNC, 0644)) == -1)
+	    fatal("can't create: %s (%s)", filename, strerror(errno));
+	write_all(fd, filename, headers, header_size);
+	if(sparse){
+	    if(ftruncate(fd, file_size) == -1)
+		fatal("can't extend: %s (%s)", filename, strerror(errno));
+	}
+	else{
+	    if((buf = malloc(1024 * 1024)) == NULL)
+		fatal("virtual memory exhausted (malloc failed)");
+	    for(len = 0; len < 1024 * 1024; len++)
+		buf[len] = "segedit benchmark\n"[len % 18];
+	    for(pos = header_size; pos < file_size; pos += len){
+		len = file_size - pos > 1024 * 1024 ? 1024 * 1024 :
+						      file_size - pos;
+		write_all(fd, filename, buf, len);
+	    }
+	    free(buf);
+	}
+	if(nsyms != 0){
+	    if(lseek(fd, file_size, SEEK_SET) == -1)
+		fatal("can't seek: %s (%s)", filename, strerror(errno));
+	    write_all(fd, filename, symbols, symbols_size);
+	    free(symbols);
+	}
+	if(close(fd) == -1)
+	    fatal("can't close: %s (%s)", filename, strerror(errno));
+	free(headers);
+}
+
+/*
+ * headers_size returns the size of the mach header and load commands of the
+ * object, rounded up to the offset of the first section.
+ */
+static
+uint64_t
+headers_size(void)
+{
+    uint64_t offset;
+
+	if(is_32)
+	    offset = sizeof(struct mach_header) + nsegs *
+		(sizeof(struct segment_command) +
+		 (uint64_t)nsects * sizeof(struct section));
+	else
+	    offset = sizeof(struct mach_header_64) + nsegs *
+		(sizeof(struct segment_command_64) +
+		 (uint64_t)nsects * sizeof(struct section_64));
+	if(nsyms != 0)
+	    offset += sizeof(struct symtab_command);
+	return((offset + 15) & ~(uint64_t)15);
+}
+
+/*
+ * make_headers returns the mach header and load commands of the object, and
+ * the padding after them up to the first section.  Their size is left in
+ * header_size and the size of the object up to the symbol table, which is
+ * symbols_size bytes with its string table, in file_size.
+ */
+static
+char *
+make_headers(
+uint64_t symbols_size,
+uint64_t *header_size,
+uint64_t *file_size)
+{
+    enum byte_sex target_byte_sex;
+    uint64_t offset, sizeofcmds, segsize, stride, fileoff, vmaddr;
+    uint32_t i, k;
+    char *buf, *p, segname[16], name[24];
+    struct mach_header *mh;
+    struct mach_header_64 *mh64;
+    struct segment_command *sg;
+    struct segment_command_64 *sg64;
+    struct section *s;
+    struct section_64 *s64;
+    struct symtab_command *st;
+
+	if(HOST_BYTE_SEX == BIG_ENDIAN_BYTE_SEX)
+	    target_byte_sex = swapped ? LITTLE_ENDIAN_BYTE_SEX :
+					BIG_ENDIAN_BYTE_SEX;
+	else
+	    target_byte_sex = swapped ? BIG_ENDIAN_BYTE_SEX :
+					LITTLE_ENDIAN_BYTE_SEX;
+	if(is_32)
+	    segsize = sizeof(struct segment_command) +
+		      (uint64_t)nsects * sizeof(struct section);
+	else
+	    segsize = sizeof(struct segment_command_64) +
+		      (uint64_t)nsects * sizeof(struct section_64);
+	sizeofcmds = nsegs * segsize;
+	if(nsyms != 0)
+	    sizeofcmds += sizeof(struct symtab_command);
+	offset = headers_size();
+	stride = (sectsize + 15) & ~15ULL;
+
+	/* the first segment follows the headers, the others start on a page */
+	*file_size = offset + (uint64_t)nsects * stride;
+	for(k = 1; k < nsegs; k++)
+	    *file_size = ((*file_size + 4095) & ~4095ULL) +
+			 (uint64_t)nsects * stride;
+	if(segsize > UINT32_MAX || sizeofcmds > UINT32_MAX ||
+	   *file_size - stride > UINT32_MAX)
+	    fatal("too many sections for 32-bit section offsets: %u", nsects);
+	*header_size = offset;
+	if((buf = calloc(1, offset)) == NULL)
+	    fatal("virtual memory exhausted (calloc failed)");
+
+	if(is_32){
+	    mh = (struct mach_header *)buf;
+	    mh->magic = MH_MAGIC;
+	    mh->cputype = swapped ? CPU_TYPE_POWERPC : CPU_TYPE_I386;
+	    mh->cpusubtype = swapped ? CPU_SUBTYPE_POWERPC_ALL :
+				       CPU_SUBTYPE_I386_ALL;
+	    mh->filetype = MH_KEXT_BUNDLE;
+	    mh->ncmds = nsegs + (nsyms != 0);
+	    mh->sizeofcmds = sizeofcmds;
+	    p = (char *)(mh + 1);
+	}
+	else{
+	    mh64 = (struct mach_header_64 *)buf;
+	    mh64->magic = MH_MAGIC_64;
+	    mh64->cputype = swapped ? CPU_TYPE_POWERPC64 : CPU_TYPE_X86_64;
+	    mh64->cpusubtype = swapped ? CPU_SUBTYPE_POWERPC_ALL :
+					 CPU_SUBTYPE_X86_64_ALL;
+	    mh64->filetype = MH_KEXT_BUNDLE;
+	    mh64->ncmds = nsegs + (nsyms != 0);
+	    mh64->sizeofcmds = sizeofcmds;
+	    p = (char *)(mh64 + 1);
+	}
+
+	fileoff = offset;
+	for(k = 0; k < nsegs; k++, p += segsize){
+	    if(k == 0)
+		strcpy(segname, SEG_DATA);
+	    else
+		sprintf(segname, "__SEG%u", k);
+	    if(k != 0)
+		fileoff = (fileoff + 4095) & ~4095ULL;
+	    vmaddr = fileoff + (uint64_t)k * 0x100000;
+	    if(is_32){
+		sg = (struct segment_command *)p;
+		sg->cmd = LC_SEGMENT;
+		sg->cmdsize = segsize;
+		strncpy(sg->segname, segname, sizeof(sg->segname));
+		sg->vmaddr = vmaddr;
+		sg->fileoff = fileoff;
+		sg->filesize = (uint64_t)nsects * stride;
+		sg->vmsize = sg->filesize;
+		sg->maxprot = VM_PROT_READ | VM_PROT_WRITE;
+		sg->initprot = VM_PROT_READ | VM_PROT_WRITE;
+		sg->nsects = nsects;
+		s = (struct section *)(sg + 1);
+		for(i = 0; i < nsects; i++){
+		    sprintf(name, "__sect%u", i);
+		    strncpy(s[i].sectname, name, sizeof(s[i].sectname));
+		    strncpy(s[i].segname, segname, sizeof(s[i].segname));
+		    s[i].offset = fileoff + i * stride;
+		    s[i].addr = vmaddr + i * stride;
+		    s[i].size = sectsize;
+		    s[i].align = 4;
+		}
+		if(swapped){
+		    swap_section(s, nsects, target_byte_sex);
+		    swap_segment_command(sg, target_byte_sex);
+		}
+	    }
+	    else{
+		sg64 = (struct segment_command_64 *)p;
+		sg64->cmd = LC_SEGMENT_64;
+		sg64->cmdsize = segsize;
+		strncpy(sg64->segname, segname, sizeof(sg64->segname));
+		sg64->vmaddr = vmaddr;
+		sg64->fileoff = fileoff;
+		sg64->filesize = (uint64_t)nsects * stride;
+		sg64->vmsize = sg64->filesize;
+		sg64->maxprot = VM_PROT_READ | VM_PROT_WRITE;
+		sg64->initprot = VM_PROT_READ | VM_PROT_WRITE;
+		sg64->nsects = nsects;
+		s64 = (struct section_64 *)(sg64 + 1);
+		for(i = 0; i < nsects; i++){
+		    sprintf(name, "__sect%u", i);
+		    strncpy(s64[i].sectname, name, sizeof(s64[i].sectname));
+		    strncpy(s64[i].segname, segname, sizeof(s64[i].segname));
+		    s64[i].offset = fileoff + i * stride;
+		    s64[i].addr = vmaddr + i * stride;
+		    s64[i].size = sectsize;
+		    s64[i].align = 4;
+		}
+		if(swapped){
+		    swap_section_64(s64, nsects, target_byte_sex);
+		    swap_segment_command_64(sg64, target_byte_sex);
+		}
+	    }
+	    fileoff += (uint64_t)nsects * stride;
+	}
+	if(nsyms != 0){
+	    st = (struct symtab_command *)p;
+	    st->cmd = LC_SYMTAB;
+	    st->cmdsize = sizeof(struct symtab_command);
+	    st->symoff = *file_size;
+	    st->nsyms = nsyms;
+	    st->stroff = *file_size + (uint64_t)nsyms *
+			 (is_32 ? sizeof(struct nlist) : sizeof(struct nlist_64));
+	    st->strsize = *file_size + symbols_size - st->stroff;
+	    if(*file_size + symbols_size > UINT32_MAX)
+		fatal("too many symbols for 32-bit symbol table offsets: %u",
+		      nsyms);
+	    if(swapped)
+		swap_symtab_command(st, target_byte_sex);
+	}
+	if(swapped){
+	    if(is_32)
+		swap_mach_header((struct mach_header *)buf, target_byte_sex);
+	    else
+		swap_mach_header_64((struct mach_header_64 *)buf,
+				    target_byte_sex);
+	}
+	return(buf);
+}
+
+/*
+ * make_symbols returns the symbol table of the object followed by its string
+ * table, and leaves their size in symbols_size.  Symbol i is in section
+ * i % nsects of __DATA, 16 bytes after symbol i - nsects.
+ */
+static
+char *
+make_symbols(
+uint64_t *symbols_size)
+{
+    enum byte_sex target_byte_sex;
+    uint64_t offset, stride, nlistsize;
+    uint32_t i, strx;
+    char *buf, *strings;
+    struct nlist *nl;
+    struct nlist_64 *nl64;
+
+	if(HOST_BYTE_SEX == BIG_ENDIAN_BYTE_SEX)
+	    target_byte_sex = swapped ? LITTLE_ENDIAN_BYTE_SEX :
+					BIG_ENDIAN_BYTE_SEX;
+	else
+	    target_byte_sex = swapped ? BIG_ENDIAN_BYTE_SEX :
+					LITTLE_ENDIAN_BYTE_SEX;
+	/* the sections of __DATA are at their file offsets in memory */
+	offset = headers_size();
+	stride = (sectsize + 15) & ~15ULL;
+
+	nlistsize = is_32 ? sizeof(struct nlist) : sizeof(struct nlist_64);
+	/* the string table is padded to 8 bytes */
+	if((buf = calloc(1, nsyms * nlistsize + 8 +
+			 (uint64_t)nsyms * sizeof("_sym4294967295"))) == NULL)
+	    fatal("virtual memory exhausted (calloc failed)");
+	strings = buf + nsyms * nlistsize;
+	strx = 1;
+	for(i = 0; i < nsyms; i++){
+	    if(is_32){
+		nl = (struct nlist *)buf + i;
+		nl->n_un.n_strx = strx;
+		nl->n_type = N_SECT | N_EXT;
+		nl->n_sect = 1 + i % nsects;
+		nl->n_value = offset + (i % nsects) * stride + (i / nsects) * 16;
+	    }
+	    else{
+		nl64 = (struct nlist_64 *)buf + i;
+		nl64->n_un.n_strx = strx;
+		nl64->n_type = N_SECT | N_EXT;
+		nl64->n_sect = 1 + i % nsects;
+		nl64->n_value = offset + (i % nsects) * stride +
+				(i / nsects) * 16;
+	    }
+	    strx += sprintf(strings + strx, "_sym%u", i) + 1;
+	}
+	if(swapped){
+	    if(is_32)
+		swap_nlist((struct nlist *)buf, nsyms, target_byte_sex);
+	    else
+		swap_nlist_64((struct nlist_64 *)buf, nsyms, target_byte_sex);
+	}
+	*symbols_size = nsyms * nlistsize + ((strx + 7) & ~7U);
+	return(buf);
+}
+
+/*
+ * write_all writes the size bytes at buf to fd, or exits with an error.
+ */
+static
+void
+write_all(
+int fd,
+const char *filename,
+const char *buf,
+uint64_t size)
+{
+    ssize_t n;
+
+	while(size != 0){
+	    n = write(fd, buf, size > 1024 * 1024 ? 1024 * 1024 : size);
+	    if(n == -1 && errno == EINTR)
+		continue;
+	    if(n <= 0)
+		fatal("can't write: %s (%s)", filename,
+		      n == 0 ? "no space" : strerror(errno));
+	    buf += n;
+	    size -= n;
+	}
+}
+
+/*
+ * get_number returns the argument of the option as a number, which may have a
+ * k, m or g suffix for KiB, MiB or GiB.
+ */
+static
+uint64_t
+get_number(
+const char *option,
+const char *arg)
+{
+    char *endp;
+    uint64_t n;
+
+	n = strtoull(arg, &endp, 0);
+	switch(*endp){
+	case 'k': n <<= 10; endp++; break;
+	case 'm': n <<= 20; endp++; break;
+	case 'g': n <<= 30; endp++; break;
+	}
+	if(endp == arg || *endp != '\0')
+	    fatal("bad argument to %s option: %s", option, arg);
+	return(n);
+}
+
+static
+void
+usage(void)
+{
+	fprintf(stderr, "Usage: %s [-32] [-swapped] [-nsegs <n>] [-nsects <n>] "
+		"[-nsyms <n>] [-size <bytes>] [-sparse] [-count <n>] "
+		"<output>\n", progname);
+	exit(1);
+}
@@ -0,0 +1,577 @@
+/*
+ * benchmark, which times segedit on a synthetic corpus written by benchgen.
+ *
+ * For each case a corpus of Mach-O files is written and then operated on in
+ * two ways, each timed over a number of runs after a warm-up run, of which the
+ * fastest is kept:
+ *   extract  segedit itself is run on the files listed with -files-from, so
+ *	      the mapping, parsing and copying of the sections to output files
+ *	      is timed end to end.
+ *   parse    the files are mapped and their sections walked with libsegedit
+ *	      in this process, without writing anything, which times the
+ *	      parsing on its own.
+ * The results are printed and can be saved as JSON, and compared against a
+ * baseline saved before, in which case it exits 1 if any result is slower than
+ * the baseline by more than the tolerance.
+ */
+#define _GNU_SOURCE	/* for nftw() FTW_PHYS */
+#define _FILE_OFFSET_BITS 64
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <ftw.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "segedit.h"
+
+#define fatal(...) { \
+  fprintf(stderr, "%s: ", progname); \
+  fprintf(stderr, __VA_ARGS__); \
+  fprintf(stderr, "\n"); \
+  exit(1); \
+}
+
+static char *progname;
+
+/* These variables are set from the command line arguments */
+static char *segedit_path = "./segedit";
+static char *benchgen_path = "./benchgen";
+static char *dir;		/* directory the corpus is written in */
+static int keep;		/* don't remove the corpus afterwards */
+static int made_dir;		/* set if dir was created here */
+static int large;		/* also run the cases marked large */
+static uint32_t nruns = 3;	/* number of timed runs */
+static double tolerance = 0.30;	/* fraction a result may be slower by */
+
+/*
+ * A benchmark case: the corpus written by benchgen with the arguments, and the
+ * sections extracted from it, all of them if sectname is NULL.  The cases with
+ * thousands of small sections write them to a tar archive, as creating that
+ * many output files takes longer than the rest together and its time depends
+ * more on the file system than on segedit.
+ */
+struct bench_case {
+    const char *name;
+    const char *args[4];	/* extra benchgen arguments */
+    uint32_t count;		/* number of files */
+    uint32_t nsects;		/* number of sections in each file */
+    uint64_t size;		/* size of each section */
+    const char *sectname;	/* the one section extracted, or NULL */
+    int tar;			/* extract to a tar archive with -tar */
+    int large;			/* only run with -large */
+};
+
+static const struct bench_case cases[] = {
+    { "small-64", { NULL }, 2000, 4, 4096, NULL, 1, 0 },
+    { "small-32-swapped", { "-32", "-swapped", NULL }, 2000, 4, 4096,
+      NULL, 1, 0 },
+    { "sections-64", { NULL }, 50, 5000, 64, "__sect4999", 0, 0 },
+    { "sections-64-swapped", { "-swapped", NULL }, 50, 5000, 64,
+      "__sect4999", 0, 0 },
+    { "large-64", { NULL }, 1, 1, 256 << 20, NULL, 0, 0 },
+    { "huge-64-sparse", { "-sparse", NULL }, 1, 1, 4ULL << 30, NULL, 0, 1 },
+};
+#define NCASES (sizeof(cases) / sizeof(cases[0]))
+
+/* The names of the results of a case, as they are in the JSON */
+static const char *metrics[] = {
+    "extract_gbps", "extract_files_per_s", "parse_files_per_s"
+};
+#define NMETRICS (sizeof(metrics) / sizeof(metrics[0]))
+
+/* the least number of files parsed in a run of time_parse() */
+#define PARSE_MIN 1000
+
+/* Internal routines */
+static void make_corpus(
+    const struct bench_case *bc,
+    const char *case_dir);
+static double time_extract(
+    const struct bench_case *bc,
+    const char *case_dir);
+static double time_parse(
+    const struct bench_case *bc,
+    const char *case_dir);
+static void parse_file(
+    char *path,
+    uint64_t *total);
+static int sum_section(
+    void *arg,
+    const struct segedit_section *section);
+static void run(
+    char *const argv[]);
+static double now(void);
+static void remove_tree(
+    const char *path);
+static int remove_entry(
+    const char *path,
+    const struct stat *sb,
+    int typeflag,
+    struct FTW *ftwbuf);
+static char *read_baseline(
+    const char *filename);
+static int get_baseline(
+    const char *baseline,
+    const char *case_name,
+    const char *metric,
+    double *value);
+static void usage(void);
+
+int
+main(
+int argc,
+char *argv[])
+{
+    int i, regressions;
+    uint32_t c, m, nresults;
+    char *baseline_name, *save_name, *baseline, *case_dir, *tmpdir;
+    double extract_time, parse_time, results[NCASES][NMETRICS], base;
+    uint64_t bytes;
+    FILE *save;
+
+	progname = argv[0];
+	baseline_name = NULL;
+	save_name = NULL;
+	for(i = 1; i < argc; i++){
+	    if(strcmp(argv[i], "-large") == 0)
+		large = 1;
+	    else if(strcmp(argv[i], "-keep") == 0)
+		keep = 1;
+	    else if(i + 1 == argc)
+		usage();
+	    else if(strcmp(argv[i], "-segedit") == 0)
+		segedit_path = argv[++i];
+	    else if(strcmp(argv[i], "-benchgen") == 0)
+		benchgen_path = argv[++i];
+	    else if(strcmp(argv[i], "-dir") == 0)
+		dir = argv[++i];
+	    else if(strcmp(argv[i], "-baseline") == 0)
+		baseline_name = argv[++i];
+	    else if(strcmp(argv[i], "-save") == 0)
+		save_name = argv[++i];
+	    else if(strcmp(argv[i], "-runs") == 0)
+		nruns = strtoul(argv[++i], NULL, 10);
+	    else if(strcmp(argv[i], "-tolerance") == 0)
+		tolerance = strtod(argv[++i], NULL) / 100;
+	    else
+		usage();
+	}
+	if(nruns == 0)
+	    usage();
+	baseline = baseline_name != NULL ? read_baseline(baseline_name) : NULL;
+
+	if(dir == NULL){
+	    tmpdir = getenv("TMPDIR");
+	    if(tmpdir == NULL)
+		tmpdir = "/tmp";
+	    if((dir = malloc(strlen(tmpdir) + 24)) == NULL)
+		fatal("virtual memory exhausted (malloc failed)");
+	    sprintf(dir, "%s/segedit-bench.XXXXXX", tmpdir);
+	    if(mkdtemp(dir) == NULL)
+		fatal("can't create: %s (%s)", dir, strerror(errno));
+	    made_dir = 1;
+	}
+	else if(mkdir(dir, 0755) == 0)
+	    made_dir = 1;
+	else if(errno != EEXIST)
+	    fatal("can't create: %s (%s)", dir, strerror(errno));
+
+	printf("%-22s %10s %12s %14s %14s\n", "case", "extract s",
+	       "extract GB/s", "extract file/s", "parse file/s");
+	nresults = 0;
+	regressions = 0;
+	for(c = 0; c < NCASES; c++){
+	    if(cases[c].large && large == 0)
+		continue;
+	    if((case_dir = malloc(strlen(dir) + strlen(cases[c].name) + 2)) ==
+	       NULL)
+		fatal("virtual memory exhausted (malloc failed)");
+	    sprintf(case_dir, "%s/%s", dir, cases[c].name);
+	    make_corpus(cases + c, case_dir);
+	    extract_time = time_extract(cases + c, case_dir);
+	    parse_time = time_parse(cases + c, case_dir);
+	    if(keep == 0)
+		remove_tree(case_dir);
+	    free(case_dir);
+
+	    bytes = (uint64_t)cases[c].count * cases[c].size *
+		    (cases[c].sectname != NULL ? 1 : cases[c].nsects);
+	    results[c][0] = bytes / extract_time / 1e9;
+	    results[c][1] = cases[c].count / extract_time;
+	    results[c][2] = cases[c].count / parse_time;
+	    nresults++;
+	    printf("%-22s %10.3f %12.3f %14.0f %14.0f", cases[c].name,
+		   extract_time, results[c][0], results[c][1], results[c][2]);
+	    for(m = 0; baseline != NULL && m < NMETRICS; m++){
+		if(get_baseline(baseline, cases[c].name, metrics[m],
+				&base) == 0 &&
+		   results[c][m] < base * (1 - tolerance)){
+		    printf("  REGRESSION %s %.3g < %.3g", metrics[m],
+			   results[c][m], base);
+		    regressions++;
+		}
+	    }
+	    printf("\n");
+	    fflush(stdout);
+	}
+	/*
+	 * Only what was created here is removed: the case directories, which
+	 * are created new, are already gone, and an existing -dir is left.
+	 */
+	if(keep == 0 && made_dir)
+	    rmdir(dir);
+
+	if(save_name != NULL){
+	    if((save = fopen(save_name, "w")) == NULL)
+		fatal("can't create: %s (%s)", save_name, strerror(errno));
+	    fprintf(save, "{\n");
+	    for(c = 0; c < NCASES; c++){
+		if(cases[c].large && large == 0)
+		    continue;
+		fprintf(save, "  \"%s\": {", cases[c].name);
+		for(m = 0; m < NMETRICS; m++)
+		    fprintf(save, "%s\"%s\": %.4g", m == 0 ? " " : ", ",
+			    metrics[m], results[c][m]);
+		fprintf(save, " }%s\n", --nresults != 0 ? "," : "");
+	    }
+	    fprintf(save, "}\n");
+	    if(fclose(save) == EOF)
+		fatal("can't write: %s (%s)", save_name, strerror(errno));
+	}
+	if(regressions != 0){
+	    fprintf(stderr, "%s: %d result(s) more than %.0f%% slower than "
+		    "the baseline in: %s\n", progname, regressions,
+		    tolerance * 100, baseline_name);
+	    return(1);
+	}
+	return(0);
+}
+
+/*
+ * make_corpus writes the files of the case with benchgen into case_dir, named
+ * in.0, in.1 and so on, and their names into the file list.
+ */
+static
+void
+make_corpus(
+const struct bench_case *bc,
+const char *case_dir)
+{
+    char *argv[16], nsects[16], size[24], count[16], *path;
+    uint32_t i, j;
+    FILE *list;
+
+	if(mkdir(case_dir, 0755) == -1)
+	    fatal("can't create: %s (%s)", case_dir, strerror(errno));
+	if((path = malloc(strlen(case_dir) + 16)) == NULL)
+	    fatal("virtual memory exhausted (malloc failed)");
+	sprintf(nsects, "%u", bc->nsects);
+	sprintf(size, "%llu", (unsigned long long)bc->size);
+	sprintf(count, "%u", bc->count);
+	sprintf(path, "%s/in", case_dir);
+	i = 0;
+	argv[i++] = benchgen_path;
+	for(j = 0; bc->args[j] != NULL; j++)
+	    argv[i++] = (char *)bc->args[j];
+	argv[i++] = "-nsects";
+	argv[i++] = nsects;
+	argv[i++] = "-size";
+	argv[i++] = size;
+	argv[i++] = "-count";
+	argv[i++] = count;
+	argv[i++] = path;
+	argv[i] = NULL;
+	run(argv);
+
+	sprintf(path, "%s/list", case_dir);
+	if((list = fopen(path, "w")) == NULL)
+	    fatal("can't create: %s (%s)", path, strerror(errno));
+	for(i = 0; i < bc->count; i++)
+	    fprintf(list, "%s/in.%u\n", case_dir, i);
+	if(fclose(list) == EOF)
+	    fatal("can't write: %s (%s)", path, strerror(errno));
+	free(path);
+}
+
+/*
+ * time_extract runs segedit on the files of the case and returns the time of
+ * the fastest run in seconds.  The output files are removed after each run.
+ */
+static
+double
+time_extract(
+const struct bench_case *bc,
+const char *case_dir)
+{
+    char *argv[16], *list, *output, *out_dir;
+    uint32_t i, r;
+    double start, t, best;
+
+	list = malloc(strlen(case_dir) + 16);
+	out_dir = malloc(strlen(case_dir) + 16);
+	output = malloc(strlen(case_dir) + 32);
+	if(list == NULL || out_dir == NULL || output == NULL)
+	    fatal("virtual memory exhausted (malloc failed)");
+	sprintf(list, "%s/list", case_dir);
+	sprintf(out_dir, "%s/out", case_dir);
+	i = 0;
+	argv[i++] = segedit_path;
+	argv[i++] = "-files-from";
+	argv[i++] = list;
+	if(bc->tar){
+	    sprintf(output, "%s/out.tar", out_dir);
+	    argv[i++] = "-tar";
+	    argv[i++] = output;
+	    argv[i++] = "-extract-all";
+	    argv[i++] = "x";
+	}
+	else if(bc->sectname != NULL){
+	    sprintf(output, "%s/%%i", out_dir);
+	    argv[i++] = "-extract";
+	    argv[i++] = SEG_DATA;
+	    argv[i++] = (char *)bc->sectname;
+	    argv[i++] = output;
+	}
+	else{
+	    sprintf(output, "%s/%%i/%%s/%%c", out_dir);
+	    argv[i++] = "-extract-all";
+	    argv[i++] = output;
+	}
+	argv[i] = NULL;
+
+	best = 0;
+	for(r = 0; r <= nruns; r++){
+	    if(mkdir(out_dir, 0755) == -1)
+		fatal("can't create: %s (%s)", out_dir, strerror(errno));
+	    /* don't time the writeback of the run before */
+	    sync();
+	    start = now();
+	    run(argv);
+	    t = now() - start;
+	    remove_tree(out_dir);
+	    /* the first run is to warm up the page cache */
+	    if(r == 1 || (r > 1 && t < best))
+		best = t;
+	}
+	free(list);
+	free(out_dir);
+	free(output);
+	return(best);
+}
+
+/*
+ * time_parse maps each file of the case with libsegedit and walks its
+ * sections, and returns the time of the fastest run in seconds per count
+ * files.  The files are gone through as many times as it takes to parse
+ * PARSE_MIN files in each run, so that small cases can be timed.
+ */
+static
+double
+time_parse(
+const struct bench_case *bc,
+const char *case_dir)
+{
+    char *path;
+    uint32_t i, r, p, npasses;
+    uint64_t total;
+    double start, t, best;
+
+	if((path = malloc(strlen(case_dir) + 16)) == NULL)
+	    fatal("virtual memory exhausted (malloc failed)");
+	npasses = (PARSE_MIN + bc->count - 1) / bc->count;
+	best = 0;
+	for(r = 0; r <= nruns; r++){
+	    total = 0;
+	    start = now();
+	    for(p = 0; p < npasses; p++){
+		for(i = 0; i < bc->count; i++){
+		    sprintf(path, "%s/in.%u", case_dir, i);
+		    parse_file(path, &total);
+		}
+	    }
+	    t = (now() - start) / npasses;
+	    if(total != (uint64_t)npasses * bc->count * bc->nsects * bc->size)
+		fatal("sections of the wrong size in: %s", case_dir);
+	    if(r == 1 || (r > 1 && t < best))
+		best = t;
+	}
+	free(path);
+	return(best);
+}
+
+/*
+ * parse_file maps the file with libsegedit and adds the sizes of the sections
+ * of each of its objects to total.
+ */
+static
+void
+parse_file(
+char *path,
+uint64_t *total)
+{
+    uint32_t i;
+    struct segedit_file sf;
+
+	segedit_init(&sf, path);
+	if(segedit_open(&sf) != SEGEDIT_OK)
+	    fatal("%s", sf.message);
+	for(i = 0; i < segedit_narchs(&sf); i++){
+	    if(segedit_map_arch(&sf, i) != SEGEDIT_OK)
+		fatal("%s", sf.message);
+	    segedit_sections(&sf, sum_section, total);
+	}
+	segedit_close(&sf);
+}
+
+/*
+ * sum_section adds the size of the section to the total at arg.
+ */
+static
+int
+sum_section(
+void *arg,
+const struct segedit_section *section)
+{
+	*(uint64_t *)arg += section->size;
+	return(0);
+}
+
+/*
+ * run runs the program with the arguments and waits for it, and exits if it
+ * fails.
+ */
+static
+void
+run(
+char *const argv[])
+{
+    pid_t pid;
+    int status;
+
+	fflush(stdout);
+	if((pid = fork()) == -1)
+	    fatal("can't fork (%s)", strerror(errno));
+	if(pid == 0){
+	    execv(argv[0], argv);
+	    fprintf(stderr, "%s: can't run: %s (%s)\n", progname, argv[0],
+		    strerror(errno));
+	    _exit(127);
+	}
+	while(waitpid(pid, &status, 0) == -1){
+	    if(errno != EINTR)
+		fatal("can't wait for: %s (%s)", argv[0], strerror(errno));
+	}
+	if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+	    fatal("%s failed", argv[0]);
+}
+
+/*
+ * now returns the monotonic time in seconds.
+ */
+static
+double
+now(void)
+{
+    struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return(ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+/*
+ * remove_tree removes the directory tree at path.
+ */
+static
+void
+remove_tree(
+const char *path)
+{
+	if(nftw(path, remove_entry, 16, FTW_DEPTH | FTW_PHYS) == -1)
+	    fatal("can't remove: %s (%s)", path, strerror(errno));
+}
+
+static
+int
+remove_entry(
+const char *path,
+const struct stat *sb,
+int typeflag,
+struct FTW *ftwbuf)
+{
+	if(remove(path) == -1)
+	    fatal("can't remove: %s (%s)", path, strerror(errno));
+	return(0);
+}
+
+/*
+ * read_baseline returns the contents of the baseline file.
+ */
+static
+char *
+read_baseline(
+const char *filename)
+{
+    FILE *f;
+    char *buf;
+    size_t len, n;
+
+	if((f = fopen(filename, "r")) == NULL)
+	    fatal("can't open: %s (%s)", filename, strerror(errno));
+	buf = NULL;
+	len = 0;
+	do{
+	    if((buf = realloc(buf, len + 4096 + 1)) == NULL)
+		fatal("virtual memory exhausted (realloc failed)");
+	    n = fread(buf + len, 1, 4096, f);
+	    len += n;
+	}while(n != 0);
+	if(ferror(f))
+	    fatal("can't read: %s (%s)", filename, strerror(errno));
+	fclose(f);
+	buf[len] = '\0';
+	return(buf);
+}
+
+/*
+ * get_baseline looks up the metric of the case in the baseline, which is the
+ * JSON written with -save: an object with an object of numbers for each case.
+ * It returns -1 if the baseline has no such metric.
+ */
+static
+int
+get_baseline(
+const char *baseline,
+const char *case_name,
+const char *metric,
+double *value)
+{
+    char key[64];
+    const char *p, *end, *q;
+
+	snprintf(key, sizeof(key), "\"%s\"", case_name);
+	if((p = strstr(baseline, key)) == NULL ||
+	   (end = strchr(p, '}')) == NULL)
+	    return(-1);
+	snprintf(key, sizeof(key), "\"%s\"", metric);
+	if((q = strstr(p, key)) == NULL || q > end ||
+	   (q = strchr(q + strlen(key), ':')) == NULL)
+	    return(-1);
+	*value = strtod(q + 1, NULL);
+	return(0);
+}
+
+static
+void
+usage(void)
+{
+	fprintf(stderr, "Usage: %s [-segedit <path>] [-benchgen <path>] "
+		"[-dir <dir>] [-keep] [-large] [-runs <n>] [-baseline <file>] "
+		"[-save <file>] [-tolerance <percent>]\n", progname);
+	exit(1);
+}
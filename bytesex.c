@@ -34,80 +34,204 @@
 #include "mach-o-loader.h"
 #include "bytesex.h"
 
-__private_extern__
-long long
-SWAP_LONG_LONG(
-long long ll)
-{
-	union {
-	    char c[8];
-	    long long ll;
-	} in, out;
-	in.ll = ll;
-	out.c[0] = in.c[7];
-	out.c[1] = in.c[6];
-	out.c[2] = in.c[5];
-	out.c[3] = in.c[4];
-	out.c[4] = in.c[3];
-	out.c[5] = in.c[2];
-	out.c[6] = in.c[1];
-	out.c[7] = in.c[0];
-	return(out.ll);
-}
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SWAP_SIMD
+#endif
 
-__private_extern__
-double
-SWAP_DOUBLE(
-double d)
-{
-	union {
-	    char c[8];
-	    double d;
-	} in, out;
-	in.d = d;
-	out.c[0] = in.c[7];
-	out.c[1] = in.c[6];
-	out.c[2] = in.c[5];
-	out.c[3] = in.c[4];
-	out.c[4] = in.c[3];
-	out.c[5] = in.c[2];
-	out.c[6] = in.c[1];
-	out.c[7] = in.c[0];
-	return(out.d);
-}
+/*
+ * The layout of a struct to be swapped in arrays of them, as runs of fields of
+ * the same width.  Fields of width 1 are not swapped.  The layout ends with a
+ * run of count 0.
+ */
+struct swap_field {
+    unsigned char width;
+    unsigned char count;
+};
 
-__private_extern__
-float
-SWAP_FLOAT(
-float f)
+static const struct swap_field fat_arch_fields[] = {
+    { 4, 5 }, { 0, 0 }
+};
+static const struct swap_field fat_arch_64_fields[] = {
+    { 4, 2 }, { 8, 2 }, { 4, 2 }, { 0, 0 }
+};
+static const struct swap_field section_fields[] = {
+    { 1, 32 }, { 4, 9 }, { 0, 0 }
+};
+static const struct swap_field section_64_fields[] = {
+    { 1, 32 }, { 8, 2 }, { 4, 7 }, { 1, 4 }, { 0, 0 }
+};
+static const struct swap_field nlist_fields[] = {
+    { 4, 1 }, { 1, 2 }, { 2, 1 }, { 4, 1 }, { 0, 0 }
+};
+static const struct swap_field nlist_64_fields[] = {
+    { 4, 1 }, { 1, 2 }, { 2, 1 }, { 8, 1 }, { 0, 0 }
+};
+
+#ifdef SWAP_SIMD
+/*
+ * Arrays smaller than this are swapped a field at a time, as building the
+ * shuffle masks costs more than it saves.
+ */
+#define SWAP_SIMD_MIN 256
+
+/*
+ * The shuffle masks repeat every least common multiple of the struct size and
+ * the vector size, which is largest for struct section: 17 * 32 bytes.
+ */
+#define SWAP_PERIOD_MAX 1024
+
+enum swap_kernel {
+    SWAP_KERNEL_UNKNOWN,
+    SWAP_KERNEL_SCALAR,
+    SWAP_KERNEL_SSSE3,
+    SWAP_KERNEL_AVX2
+};
+static enum swap_kernel swap_kernel = SWAP_KERNEL_UNKNOWN;
+
+static int swap_array(
+    void *p,
+    unsigned long n,
+    unsigned long size,
+    const struct swap_field *fields);
+static unsigned long swap_ssse3(
+    unsigned char *p,
+    unsigned long len,
+    const unsigned char *mask,
+    unsigned long period);
+static unsigned long swap_avx2(
+    unsigned char *p,
+    unsigned long len,
+    const unsigned char *mask,
+    unsigned long period);
+
+/*
+ * swap_array() swaps the n structs of size bytes at p, with the layout fields,
+ * with the pshufb instruction when the processor has it.  A shuffle mask is
+ * built for each vector in one period of the layout, that moves each byte of
+ * a field to its swapped place.  pshufb only moves bytes within 16 byte lanes,
+ * so layouts with fields that cross lanes are not handled, nor are small
+ * arrays.  It returns 1 if it swapped the structs and 0 if they must be
+ * swapped a field at a time.
+ */
+static
+int
+swap_array(
+void *p,
+unsigned long n,
+unsigned long size,
+const struct swap_field *fields)
 {
-	union {
-	    char c[7];
-	    float f;
-	} in, out;
-	in.f = f;
-	out.c[0] = in.c[3];
-	out.c[1] = in.c[2];
-	out.c[2] = in.c[1];
-	out.c[3] = in.c[0];
-	return(out.f);
+    enum swap_kernel kernel;
+    unsigned long i, j, k, len, period, off;
+    unsigned char mask[SWAP_PERIOD_MAX], tail[32];
+    const struct swap_field *f;
+
+	kernel = __atomic_load_n(&swap_kernel, __ATOMIC_RELAXED);
+	if(kernel == SWAP_KERNEL_UNKNOWN){
+	    __builtin_cpu_init();
+	    if(__builtin_cpu_supports("avx2"))
+		kernel = SWAP_KERNEL_AVX2;
+	    else if(__builtin_cpu_supports("ssse3"))
+		kernel = SWAP_KERNEL_SSSE3;
+	    else
+		kernel = SWAP_KERNEL_SCALAR;
+	    __atomic_store_n(&swap_kernel, kernel, __ATOMIC_RELAXED);
+	}
+	len = n * size;
+	if(kernel == SWAP_KERNEL_SCALAR || len < SWAP_SIMD_MIN)
+	    return(0);
+
+	/* the period is the least common multiple of size and 32 */
+	for(period = size; period % 32 != 0; period += size)
+	    ;
+	if(period > SWAP_PERIOD_MAX)
+	    return(0);
+
+	/* mask[i] is the index of the byte that goes to i, within its lane */
+	for(i = 0; i < period; ){
+	    for(f = fields; f->count != 0; f++){
+		for(j = 0; j < f->count; j++){
+		    if((i & ~15UL) != ((i + f->width - 1) & ~15UL))
+			return(0);
+		    for(k = 0; k < f->width; k++)
+			mask[i + k] = (i & 15) + f->width - 1 - k;
+		    i += f->width;
+		}
+	    }
+	}
+
+	if(kernel == SWAP_KERNEL_AVX2)
+	    off = swap_avx2(p, len, mask, period);
+	else
+	    off = swap_ssse3(p, len, mask, period);
+
+	/* the fields left are less than a vector, swap them from a copy */
+	i = len - len % 16;
+	if(kernel == SWAP_KERNEL_AVX2)
+	    i = len - len % 32;
+	memcpy(tail, (unsigned char *)p + i, len - i);
+	for(j = 0; j < len - i; j++)
+	    ((unsigned char *)p)[i + j] = tail[(j & ~15UL) + mask[off + j]];
+	return(1);
 }
 
 /*
- * get_host_byte_sex() returns the enum constant for the byte sex of the host
- * it is running on.
+ * swap_ssse3() and swap_avx2() shuffle the whole vectors in the len bytes at p
+ * with the masks for each vector in a period, and return the offset into the
+ * period where they stopped.
  */
-__private_extern__
-enum byte_sex
-get_host_byte_sex(
-void)
+__attribute__((target("ssse3")))
+static
+unsigned long
+swap_ssse3(
+unsigned char *p,
+unsigned long len,
+const unsigned char *mask,
+unsigned long period)
 {
-    uint32_t s;
+    unsigned long off;
+    __m128i v, m;
 
-	s = (BIG_ENDIAN_BYTE_SEX << 24) | LITTLE_ENDIAN_BYTE_SEX;
-	return((enum byte_sex)*((char *)&s));
+	off = 0;
+	for( ; len >= 16; len -= 16, p += 16){
+	    v = _mm_loadu_si128((__m128i *)p);
+	    m = _mm_loadu_si128((const __m128i *)(mask + off));
+	    _mm_storeu_si128((__m128i *)p, _mm_shuffle_epi8(v, m));
+	    off += 16;
+	    if(off == period)
+		off = 0;
+	}
+	return(off);
 }
 
+__attribute__((target("avx2")))
+static
+unsigned long
+swap_avx2(
+unsigned char *p,
+unsigned long len,
+const unsigned char *mask,
+unsigned long period)
+{
+    unsigned long off;
+    __m256i v, m;
+
+	off = 0;
+	for( ; len >= 32; len -= 32, p += 32){
+	    v = _mm256_loadu_si256((__m256i *)p);
+	    m = _mm256_loadu_si256((const __m256i *)(mask + off));
+	    _mm256_storeu_si256((__m256i *)p, _mm256_shuffle_epi8(v, m));
+	    off += 32;
+	    if(off == period)
+		off = 0;
+	}
+	return(off);
+}
+#else /* !defined(SWAP_SIMD) */
+#define swap_array(p, n, size, fields) ((void)(fields), 0)
+#endif /* SWAP_SIMD */
+
 __private_extern__
 void
 swap_fat_header(
@@ -136,6 +260,9 @@ enum byte_sex target_byte_sex)
         dummy = target_byte_sex;
 #endif
 
+	if(swap_array(fat_archs, nfat_arch, sizeof(struct fat_arch),
+		      fat_arch_fields))
+	    return;
 	for(i = 0; i < nfat_arch; i++){
 	    fat_archs[i].cputype    = SWAP_INT(fat_archs[i].cputype);
 	    fat_archs[i].cpusubtype = SWAP_INT(fat_archs[i].cpusubtype);
@@ -145,6 +272,32 @@ enum byte_sex target_byte_sex)
 	}
 }
 
+__private_extern__
+void
+swap_fat_arch_64(
+struct fat_arch_64 *fat_archs64,
+unsigned long nfat_arch,
+enum byte_sex target_byte_sex)
+{
+    uint32_t i;
+#ifdef __MWERKS__
+    enum byte_sex dummy;
+        dummy = target_byte_sex;
+#endif
+
+	if(swap_array(fat_archs64, nfat_arch, sizeof(struct fat_arch_64),
+		      fat_arch_64_fields))
+	    return;
+	for(i = 0; i < nfat_arch; i++){
+	    fat_archs64[i].cputype    = SWAP_INT(fat_archs64[i].cputype);
+	    fat_archs64[i].cpusubtype = SWAP_INT(fat_archs64[i].cpusubtype);
+	    fat_archs64[i].offset     = SWAP_LONG_LONG(fat_archs64[i].offset);
+	    fat_archs64[i].size       = SWAP_LONG_LONG(fat_archs64[i].size);
+	    fat_archs64[i].align      = SWAP_INT(fat_archs64[i].align);
+	    fat_archs64[i].reserved   = SWAP_INT(fat_archs64[i].reserved);
+	}
+}
+
 __private_extern__
 void
 swap_mach_header(
@@ -257,6 +410,8 @@ enum byte_sex target_byte_sex)
         dummy = target_byte_sex;
 #endif
 
+	if(swap_array(s, nsects, sizeof(struct section), section_fields))
+	    return;
 	for(i = 0; i < nsects; i++){
 	    /* sectname[16] */
 	    /* segname[16] */
@@ -285,6 +440,8 @@ enum byte_sex target_byte_sex)
         dummy = target_byte_sex;
 #endif
 
+	if(swap_array(s, nsects, sizeof(struct section_64), section_64_fields))
+	    return;
 	for(i = 0; i < nsects; i++){
 	    /* sectname[16] */
 	    /* segname[16] */
@@ -365,3 +522,52 @@ enum byte_sex target_byte_sex)
 	ss->offset = SWAP_INT(ss->offset);
 	ss->size = SWAP_INT(ss->size);
 }
+
+__private_extern__
+void
+swap_nlist(
+struct nlist *symbols,
+unsigned long nsymbols,
+enum byte_sex target_byte_sex)
+{
+    unsigned long i;
+#ifdef __MWERKS__
+    enum byte_sex dummy;
+        dummy = target_byte_sex;
+#endif
+
+	if(swap_array(symbols, nsymbols, sizeof(struct nlist), nlist_fields))
+	    return;
+	for(i = 0; i < nsymbols; i++){
+	    symbols[i].n_un.n_strx = SWAP_INT(symbols[i].n_un.n_strx);
+	    /* n_type */
+	    /* n_sect */
+	    symbols[i].n_desc = SWAP_SHORT(symbols[i].n_desc);
+	    symbols[i].n_value = SWAP_INT(symbols[i].n_value);
+	}
+}
+
+__private_extern__
+void
+swap_nlist_64(
+struct nlist_64 *symbols,
+unsigned long nsymbols,
+enum byte_sex target_byte_sex)
+{
+    unsigned long i;
+#ifdef __MWERKS__
+    enum byte_sex dummy;
+        dummy = target_byte_sex;
+#endif
+
+	if(swap_array(symbols, nsymbols, sizeof(struct nlist_64),
+		      nlist_64_fields))
+	    return;
+	for(i = 0; i < nsymbols; i++){
+	    symbols[i].n_un.n_strx = SWAP_INT(symbols[i].n_un.n_strx);
+	    /* n_type */
+	    /* n_sect */
+	    symbols[i].n_desc = SWAP_SHORT(symbols[i].n_desc);
+	    symbols[i].n_value = SWAP_LONG_LONG(symbols[i].n_value);
+	}
+}
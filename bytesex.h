@@ -36,7 +36,10 @@
 #define __private_extern__ 
 #endif
 
+#include <stdint.h>
+#include <string.h>
 #include "mach-o-fat.h"
+#include "mach-o-nlist.h"
 
 enum byte_sex {
     UNKNOWN_BYTE_SEX,
@@ -44,31 +47,151 @@ enum byte_sex {
     LITTLE_ENDIAN_BYTE_SEX
 };
 
-#define SWAP_SHORT(a) ( ((a & 0xff) << 8) | ((unsigned short)(a) >> 8) )
-
-#define SWAP_INT(a)  ( ((a) << 24) | \
-		      (((a) << 8) & 0x00ff0000) | \
-		      (((a) >> 8) & 0x0000ff00) | \
-	 ((unsigned int)(a) >> 24) )
-
-//#ifndef __LP64__
-#define SWAP_LONG(a) ( ((a) << 24) | \
-		      (((a) << 8) & 0x00ff0000) | \
-		      (((a) >> 8) & 0x0000ff00) | \
-	((unsigned long)(a) >> 24) )
-//#endif
+/*
+ * HOST_BYTE_SEX is the byte sex of the host, known when compiling with gcc or
+ * clang.  With other compilers it is found out when running.
+ */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define HOST_BYTE_SEX BIG_ENDIAN_BYTE_SEX
+#elif defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define HOST_BYTE_SEX LITTLE_ENDIAN_BYTE_SEX
+#else
+#define HOST_BYTE_SEX get_host_byte_sex()
+#endif
 
-__private_extern__ long long SWAP_LONG_LONG(
-    long long ll);
+/*
+ * The swap primitives are built on the compiler's byte swap builtins, which
+ * become a single bswap (or movbe with the load) instruction.
+ */
+#define SWAP_SHORT(a) ((unsigned short)__builtin_bswap16((unsigned short)(a)))
+
+#define SWAP_INT(a) ((unsigned int)__builtin_bswap32((unsigned int)(a)))
+
+/* SWAP_LONG swaps 32 bits, as longs are in the 32-bit Mach-O structs */
+#define SWAP_LONG(a) ((unsigned long)__builtin_bswap32((unsigned int)(a)))
+
+static inline
+long long
+SWAP_LONG_LONG(
+long long ll)
+{
+	return((long long)__builtin_bswap64((unsigned long long)ll));
+}
+
+static inline
+float
+SWAP_FLOAT(
+float f)
+{
+    uint32_t u;
+
+	memcpy(&u, &f, sizeof(uint32_t));
+	u = __builtin_bswap32(u);
+	memcpy(&f, &u, sizeof(uint32_t));
+	return(f);
+}
+
+static inline
+double
+SWAP_DOUBLE(
+double d)
+{
+    uint64_t u;
+
+	memcpy(&u, &d, sizeof(uint64_t));
+	u = __builtin_bswap64(u);
+	memcpy(&d, &u, sizeof(uint64_t));
+	return(d);
+}
 
-__private_extern__ float SWAP_FLOAT(
-    float f);
+/*
+ * get_host_byte_sex() returns the enum constant for the byte sex of the host
+ * it is running on.
+ */
+static inline
+enum byte_sex
+get_host_byte_sex(
+void)
+{
+#if defined(__BYTE_ORDER__)
+	return(HOST_BYTE_SEX);
+#else
+    uint32_t s;
+
+	s = (BIG_ENDIAN_BYTE_SEX << 24) | LITTLE_ENDIAN_BYTE_SEX;
+	return((enum byte_sex)*((char *)&s));
+#endif
+}
 
-__private_extern__ double SWAP_DOUBLE(
-    double d);
+/*
+ * get_uint16(), get_uint32() and get_uint64() load the possibly unaligned
+ * value at p in the host byte sex, swapping it if swapped is set.  Routines
+ * that are specialized on a constant swapped get plain loads for files in the
+ * host byte sex.
+ */
+static inline
+uint16_t
+get_uint16(
+const void *p,
+int swapped)
+{
+    uint16_t v;
+
+	memcpy(&v, p, sizeof(uint16_t));
+	return(swapped ? __builtin_bswap16(v) : v);
+}
+
+static inline
+uint32_t
+get_uint32(
+const void *p,
+int swapped)
+{
+    uint32_t v;
+
+	memcpy(&v, p, sizeof(uint32_t));
+	return(swapped ? __builtin_bswap32(v) : v);
+}
+
+static inline
+uint64_t
+get_uint64(
+const void *p,
+int swapped)
+{
+    uint64_t v;
+
+	memcpy(&v, p, sizeof(uint64_t));
+	return(swapped ? __builtin_bswap64(v) : v);
+}
 
-__private_extern__ enum byte_sex get_host_byte_sex(
-    void);
+/*
+ * put_uint32() and put_uint64() store v at the possibly unaligned p, swapping
+ * it from the host byte sex if swapped is set.
+ */
+static inline
+void
+put_uint32(
+void *p,
+uint32_t v,
+int swapped)
+{
+	if(swapped)
+	    v = __builtin_bswap32(v);
+	memcpy(p, &v, sizeof(uint32_t));
+}
+
+static inline
+void
+put_uint64(
+void *p,
+uint64_t v,
+int swapped)
+{
+	if(swapped)
+	    v = __builtin_bswap64(v);
+	memcpy(p, &v, sizeof(uint64_t));
+}
 
 __private_extern__ void swap_fat_header(
     struct fat_header *fat_header,
@@ -79,6 +202,11 @@ __private_extern__ void swap_fat_arch(
     unsigned long nfat_arch,
     enum byte_sex target_byte_sex);
 
+__private_extern__ void swap_fat_arch_64(
+    struct fat_arch_64 *fat_archs64,
+    unsigned long nfat_arch,
+    enum byte_sex target_byte_sex);
+
 __private_extern__ void swap_mach_header(
     struct mach_header *mh,
     enum byte_sex target_byte_sex);
@@ -109,6 +237,16 @@ __private_extern__ void swap_section_64(
     unsigned long nsects,
     enum byte_sex target_byte_sex);
 
+__private_extern__ void swap_nlist(
+    struct nlist *symbols,
+    unsigned long nsymbols,
+    enum byte_sex target_byte_sex);
+
+__private_extern__ void swap_nlist_64(
+    struct nlist_64 *symbols,
+    unsigned long nsymbols,
+    enum byte_sex target_byte_sex);
+
 __private_extern__ void swap_symtab_command(
     struct symtab_command *st,
     enum byte_sex target_byte_sex);
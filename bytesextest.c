@@ -0,0 +1,127 @@
+/*
+ * bytesextest, run by make check, which checks that the array swappers of
+ * bytesex.c swap every field the same way whichever kernel swap_array() uses.
+ *
+ * bytesex.c is included so that the kernel can be chosen.  Arrays of each
+ * struct that is swapped in bulk, of every length up to MAXN structs so that
+ * small arrays, whole periods of the shuffle masks and the partial vectors at
+ * the end are all covered, are swapped a field at a time and then with each
+ * kernel the processor has.  They must come out the same, and as they were
+ * when swapped back.
+ */
+#include "bytesex.c"
+#include <stdlib.h>
+#include <stdio.h>
+
+#define MAXN 300
+#define MAXSIZE sizeof(struct section_64)
+
+static const struct {
+    const char *name;
+    unsigned long size;
+} types[] = {
+    { "fat_arch", sizeof(struct fat_arch) },
+    { "fat_arch_64", sizeof(struct fat_arch_64) },
+    { "section", sizeof(struct section) },
+    { "section_64", sizeof(struct section_64) },
+    { "nlist", sizeof(struct nlist) },
+    { "nlist_64", sizeof(struct nlist_64) },
+};
+#define NTYPES (sizeof(types) / sizeof(types[0]))
+
+/*
+ * swap_structs swaps the n structs at p of the i'th of the types.
+ */
+static
+void
+swap_structs(
+uint32_t i,
+void *p,
+unsigned long n)
+{
+	switch(i){
+	case 0: swap_fat_arch(p, n, HOST_BYTE_SEX); break;
+	case 1: swap_fat_arch_64(p, n, HOST_BYTE_SEX); break;
+	case 2: swap_section(p, n, HOST_BYTE_SEX); break;
+	case 3: swap_section_64(p, n, HOST_BYTE_SEX); break;
+	case 4: swap_nlist(p, n, HOST_BYTE_SEX); break;
+	case 5: swap_nlist_64(p, n, HOST_BYTE_SEX); break;
+	}
+}
+
+int
+main(
+int argc,
+char *argv[])
+{
+    static unsigned char in[MAXN * MAXSIZE], ref[MAXN * MAXSIZE],
+			 got[MAXN * MAXSIZE];
+    const char *kernel_names[4];
+    int kernels[4];
+    uint32_t i, j, k, nkernels, failures;
+    unsigned long n, len;
+
+	srand(1);
+	for(i = 0; i < sizeof(in); i++)
+	    in[i] = rand() >> 7;
+
+	nkernels = 0;
+#ifdef SWAP_SIMD
+	__builtin_cpu_init();
+	kernel_names[nkernels] = "scalar";
+	kernels[nkernels++] = SWAP_KERNEL_SCALAR;
+	if(__builtin_cpu_supports("ssse3")){
+	    kernel_names[nkernels] = "ssse3";
+	    kernels[nkernels++] = SWAP_KERNEL_SSSE3;
+	}
+	if(__builtin_cpu_supports("avx2")){
+	    kernel_names[nkernels] = "avx2";
+	    kernels[nkernels++] = SWAP_KERNEL_AVX2;
+	}
+#else
+	kernel_names[nkernels] = "scalar";
+	kernels[nkernels++] = 0;
+#endif
+
+	failures = 0;
+	for(i = 0; i < NTYPES; i++){
+	    for(n = 1; n <= MAXN; n++){
+		len = n * types[i].size;
+#ifdef SWAP_SIMD
+		swap_kernel = SWAP_KERNEL_SCALAR;
+#endif
+		memcpy(ref, in, len);
+		swap_structs(i, ref, n);
+		for(k = 0; k < nkernels; k++){
+#ifdef SWAP_SIMD
+		    swap_kernel = kernels[k];
+#endif
+		    memcpy(got, in, len);
+		    swap_structs(i, got, n);
+		    for(j = 0; j < len && got[j] == ref[j]; j++)
+			;
+		    if(j != len){
+			printf("FAIL: %lu %s structs swapped with %s differ "
+			       "at byte %u\n", n, types[i].name,
+			       kernel_names[k], j);
+			failures++;
+			continue;
+		    }
+		    swap_structs(i, got, n);
+		    if(memcmp(got, in, len) != 0){
+			printf("FAIL: %lu %s structs swapped twice with %s "
+			       "are not as they were\n", n, types[i].name,
+			       kernel_names[k]);
+			failures++;
+		    }
+		}
+	    }
+	}
+	if(failures != 0)
+	    return(1);
+	printf("bytesex: %u structs swapped alike with", (uint32_t)NTYPES);
+	for(k = 0; k < nkernels; k++)
+	    printf(" %s", kernel_names[k]);
+	printf("\n");
+	return(0);
+}
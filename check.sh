@@ -0,0 +1,184 @@
+#!/bin/sh
+#
+# check.sh, run by make check, edits objects written by benchgen with
+# -replace, -remove and -remove-segment and checks the results with -extract
+# and -hash.  The objects are 32 and 64-bit, in either byte sex, with three
+# segments of three sections each.  The contents of every section that is not
+# edited must come through unchanged, whether it moved in the file or not.
+# Objects with many sections and symbols check that those swapped in bulk are
+# found as in the host byte sex, and others the tar archives of -tar.
+#
+# Usage: check.sh [<segedit> [<benchgen>]]
+
+SEGEDIT=${1:-./segedit}
+BENCHGEN=${2:-./benchgen}
+
+dir=$(mktemp -d "${TMPDIR:-/tmp}/segedit-check.XXXXXX") || exit 1
+trap 'rm -rf "$dir"' EXIT
+failures=0
+
+fail()
+{
+	echo "FAIL: $*"
+	failures=$((failures + 1))
+}
+
+# manifest <file> prints the segment name, section name, size and digests of
+# each section of the file
+manifest()
+{
+	"$SEGEDIT" "$1" -hash - | grep -v '^#' | cut -f3,4,6,7,8
+}
+
+# same <orig> <edited> <segname> [<sectname>] checks that all the sections
+# of the edited file but those named have the contents they had in orig
+same()
+{
+	manifest "$1" | grep -v "^$3	${4:-}" > "$dir/expected"
+	manifest "$2" | grep -v "^$3	${4:-}" > "$dir/got"
+	cmp -s "$dir/expected" "$dir/got" ||
+	    fail "$2: sections other than those of ($3${4:+,$4}) changed"
+}
+
+# removed <edited> <segname> [<sectname>] checks that the sections named are
+# left without contents
+removed()
+{
+	manifest "$1" | grep "^$2	${3:-}" | cut -f3 | grep -qv '^0$' &&
+	    fail "$1: ($2${3:+,$3}) still has contents"
+}
+
+# replaced <edited> <segname> <sectname> <file> checks that the section now
+# has the contents of the file
+replaced()
+{
+	"$SEGEDIT" "$1" -extract "$2" "$3" "$dir/extracted" ||
+	    fail "$1: can't extract ($2,$3)"
+	cmp -s "$4" "$dir/extracted" ||
+	    fail "$1: ($2,$3) doesn't have the contents of $4"
+}
+
+head -c 500 /dev/urandom > "$dir/small"
+head -c 20000 /dev/urandom > "$dir/large"
+
+for flags in "" "-32" "-swapped" "-32 -swapped"; do
+	echo "benchgen $flags"
+	in="$dir/in"
+	out="$dir/out"
+	$BENCHGEN $flags -nsegs 3 -nsects 3 -size 1500 "$in" || exit 1
+
+	# new contents that fit are written in place
+	if "$SEGEDIT" "$in" -replace __DATA __sect1 "$dir/small" -output "$out"
+	then
+		[ $(wc -c < "$out") -eq $(wc -c < "$in") ] ||
+		    fail "$flags: -replace in place changed the file size"
+		replaced "$out" __DATA __sect1 "$dir/small"
+		same "$in" "$out" __DATA __sect1
+	else
+		fail "$flags: -replace in place"
+	fi
+
+	# the last section of a segment grows, the segments after it move
+	if "$SEGEDIT" "$in" -replace __DATA __sect2 "$dir/large" -output "$out"
+	then
+		[ $(wc -c < "$out") -gt $(wc -c < "$in") ] ||
+		    fail "$flags: -replace growing didn't grow the file"
+		replaced "$out" __DATA __sect2 "$dir/large"
+		same "$in" "$out" __DATA __sect2
+	else
+		fail "$flags: -replace growing"
+	fi
+
+	# removing a segment moves the segment after it back by whole pages
+	if "$SEGEDIT" "$in" -remove-segment __SEG1 -output "$out"; then
+		[ $(wc -c < "$out") -lt $(wc -c < "$in") ] ||
+		    fail "$flags: -remove of a segment didn't shrink the file"
+		removed "$out" __SEG1
+		same "$in" "$out" __SEG1
+	else
+		fail "$flags: -remove of a segment"
+	fi
+
+	# removing a section leaves the others of its segment in place
+	if "$SEGEDIT" "$in" -remove __DATA __sect1 -output "$out"; then
+		removed "$out" __DATA __sect1
+		same "$in" "$out" __DATA __sect1
+	else
+		fail "$flags: -remove of a section"
+	fi
+
+	# the input file can follow the options
+	if "$SEGEDIT" -remove-segment __SEG1 -remove __SEG2 __sect0 \
+		-output "$out" "$in"; then
+		removed "$out" __SEG1
+		removed "$out" __SEG2 __sect0
+		manifest "$in" | grep "^__DATA	" > "$dir/expected"
+		manifest "$out" | grep "^__DATA	" > "$dir/got"
+		cmp -s "$dir/expected" "$dir/got" ||
+		    fail "$flags: -remove with the input file last changed" \
+			 "__DATA"
+	else
+		fail "$flags: -remove with the input file last"
+	fi
+
+	# both at once, and the result edited again
+	if "$SEGEDIT" "$in" -remove-segment __SEG1 -replace __DATA __sect2 \
+		"$dir/large" -output "$out" &&
+	   "$SEGEDIT" "$out" -remove __SEG2 __sect0 -output "$out.2"; then
+		replaced "$out.2" __DATA __sect2 "$dir/large"
+		removed "$out.2" __SEG1
+		removed "$out.2" __SEG2 __sect0
+		manifest "$in" | grep "^__SEG2	__sect[12]" > "$dir/expected"
+		manifest "$out.2" | grep "^__SEG2	__sect[12]" > "$dir/got"
+		cmp -s "$dir/expected" "$dir/got" ||
+		    fail "$flags: -remove after -replace and -remove changed" \
+			 "(__SEG2,__sect1) or (__SEG2,__sect2)"
+	else
+		fail "$flags: -remove and -replace together"
+	fi
+done
+
+# benchgen -swapped swaps its section headers and symbols in bulk, and segedit
+# swaps the symbols back in bulk, more than a buffer of them at a time; the
+# sections and symbols must come out as from the host byte sex
+for flags in "" "-32"; do
+	echo "benchgen $flags -nsyms"
+	$BENCHGEN $flags -nsects 40 -size 1200 -nsyms 3000 "$dir/host" &&
+	$BENCHGEN $flags -swapped -nsects 40 -size 1200 -nsyms 3000 \
+		"$dir/swapped" || exit 1
+	manifest "$dir/host" > "$dir/expected"
+	manifest "$dir/swapped" > "$dir/got"
+	cmp -s "$dir/expected" "$dir/got" ||
+	    fail "$flags: the sections of -swapped differ"
+	for sym in _sym0 _sym1023 _sym1024 _sym2999; do
+		"$SEGEDIT" "$dir/host" -extract-symbol $sym "$dir/expected" &&
+		"$SEGEDIT" "$dir/swapped" -extract-symbol $sym "$dir/got" &&
+		cmp -s "$dir/expected" "$dir/got" ||
+		    fail "$flags: symbol $sym of -swapped differs"
+	done
+done
+
+# -tar writes the same entries whether the input is mapped or read as a
+# stream, where sections of more than 16 MiB are gathered in a temporary file,
+# and names them relative to where the archive is extracted
+mkdir "$dir/sub"
+for size in 1500 17000000; do
+	echo "-tar $size"
+	$BENCHGEN -nsects 2 -size $size "$dir/in" || exit 1
+	"$SEGEDIT" "$dir/sub/../in" -extract-all x -tar "$dir/mapped.tar" &&
+	cat "$dir/in" |
+	"$SEGEDIT" - -extract-all x -tar "$dir/streamed.tar" ||
+	    fail "-tar $size"
+	tar tf "$dir/mapped.tar" | grep -q '^/\|\(^\|/\)\.\.\(/\|$\)' &&
+	    fail "-tar $size: entry names that are not relative"
+	tar xOf "$dir/mapped.tar" > "$dir/expected"
+	tar xOf "$dir/streamed.tar" > "$dir/got"
+	cmp -s "$dir/expected" "$dir/got" ||
+	    fail "-tar $size: the entries of a stream differ"
+done
+
+if [ $failures -ne 0 ]; then
+	echo "$failures checks failed"
+	exit 1
+fi
+echo "all checks passed"
@@ -0,0 +1,593 @@
+/*
+ * Compressing output files as they are written, with gzip or zstd, and
+ * decompressing compressed section contents.
+ *
+ * gzip data that is all in memory is compressed in GZIP_BLOCKSIZE blocks
+ * that are deflated independently, each ended with a sync flush so that they
+ * can be concatenated, and with the GZIP_DICTSIZE bytes before it as
+ * dictionary so that little is lost by splitting it.  The CRC-32s of the
+ * blocks are combined into the one of the whole.  Only a few blocks per thread
+ * are compressed at once, so the memory used does not depend on the size.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef WITH_ZSTD
+#include <zstd.h>
+#endif
+#include "compress.h"
+
+#define GZIP_BLOCKSIZE	(1024 * 1024)
+#define GZIP_DICTSIZE	(32 * 1024)
+#define GZIP_LEVEL	Z_DEFAULT_COMPRESSION
+#define ZSTD_LEVEL	3
+#define STREAM_OUTSIZE	(64 * 1024)
+
+/* a block of gzip data being compressed */
+struct gzip_block {
+    const char *data;		/* the bytes to compress */
+    size_t len;
+    size_t dictlen;		/* number of bytes before them to use as
+				   dictionary */
+    int last;			/* 1 if it is the last block */
+    char *out;			/* the compressed bytes */
+    size_t outlen;
+    uint32_t crc;		/* CRC-32 of the bytes */
+    int failed;			/* set if they can't be compressed */
+};
+
+struct compress_stream {
+    enum compress_format format;
+    z_stream zs;		/* the gzip stream */
+#ifdef WITH_ZSTD
+    ZSTD_CCtx *cctx;		/* the zstd stream */
+#endif
+    char out[STREAM_OUTSIZE];	/* compressed bytes to write */
+};
+
+struct decompress_stream {
+    enum decompress_format format;
+    char header[DECOMPRESS_HEADER]; /* the first bytes, until the format is
+				   known from them */
+    size_t nheader;		/* number of them */
+    int started;		/* set once the format is known */
+    int ended;			/* set at the end of the compressed data */
+    uint64_t size;		/* the uncompressed size of DECOMPRESS_ZDEBUG */
+    z_stream zs;
+    char out[STREAM_OUTSIZE];	/* inflated bytes to write */
+};
+
+static int gzip_write(
+    struct workqueue *wq,
+    int fd,
+    const char *data,
+    uint64_t size);
+static void gzip_block(
+    void *arg);
+#ifdef WITH_ZSTD
+static int zstd_write(
+    struct workqueue *wq,
+    int fd,
+    const char *data,
+    uint64_t size);
+#endif
+static int inflate_write(
+    struct decompress_stream *ds,
+    int fd,
+    const char *buf,
+    size_t len);
+static int write_all(
+    int fd,
+    const char *buf,
+    size_t size);
+
+/* the gzip header without a file name or modification time */
+static const unsigned char gzip_header[10] = {
+    0x1f, 0x8b, Z_DEFLATED, 0, 0, 0, 0, 0, 0, 3
+};
+
+const char *
+compress_suffix(
+enum compress_format format)
+{
+	switch(format){
+	case COMPRESS_GZIP:
+	    return(".gz");
+	case COMPRESS_ZSTD:
+	    return(".zst");
+	default:
+	    return("");
+	}
+}
+
+int
+compress_write(
+enum compress_format format,
+struct workqueue *wq,
+int fd,
+const char *data,
+uint64_t size)
+{
+#ifdef WITH_ZSTD
+	if(format == COMPRESS_ZSTD)
+	    return(zstd_write(wq, fd, data, size));
+#endif
+	if(format == COMPRESS_GZIP)
+	    return(gzip_write(wq, fd, data, size));
+	errno = EINVAL;
+	return(-1);
+}
+
+/*
+ * gzip_write compresses the data with gzip in blocks, a batch of them at a
+ * time, and writes them in order.
+ */
+static
+int
+gzip_write(
+struct workqueue *wq,
+int fd,
+const char *data,
+uint64_t size)
+{
+    struct gzip_block *blocks, *b;
+    struct work_group group;
+    uint32_t i, nbatch, n;
+    uint64_t pos;
+    uint32_t crc;
+    unsigned char trailer[8];
+    int result;
+
+	if(write_all(fd, (const char *)gzip_header, sizeof(gzip_header)) == -1)
+	    return(-1);
+	nbatch = 2 * (wq->nthreads + 1);
+	if((blocks = calloc(nbatch, sizeof(struct gzip_block))) == NULL)
+	    return(-1);
+	result = 0;
+	crc = crc32(0, NULL, 0);
+	pos = 0;
+	do{
+	    workqueue_group_init(&group);
+	    for(n = 0; n < nbatch && (n == 0 || pos < size); n++){
+		b = blocks + n;
+		memset(b, '\0', sizeof(struct gzip_block));
+		b->data = data + pos;
+		b->len = size - pos > GZIP_BLOCKSIZE ? GZIP_BLOCKSIZE :
+						       size - pos;
+		b->dictlen = pos > GZIP_DICTSIZE ? GZIP_DICTSIZE : pos;
+		pos += b->len;
+		b->last = pos == size;
+		workqueue_add(wq, &group, gzip_block, b);
+	    }
+	    workqueue_wait(wq, &group);
+	    for(i = 0; i < n; i++){
+		b = blocks + i;
+		if(result == 0 && b->failed){
+		    errno = ENOMEM;
+		    result = -1;
+		}
+		if(result == 0 && write_all(fd, b->out, b->outlen) == -1)
+		    result = -1;
+		crc = crc32_combine(crc, b->crc, b->len);
+		free(b->out);
+	    }
+	}while(result == 0 && pos < size);
+	free(blocks);
+	if(result == -1)
+	    return(-1);
+
+	for(i = 0; i < 4; i++){
+	    trailer[i] = crc >> (8 * i);
+	    trailer[4 + i] = size >> (8 * i);
+	}
+	return(write_all(fd, (const char *)trailer, sizeof(trailer)));
+}
+
+/*
+ * gzip_block is the work item that deflates a block and computes its CRC-32.
+ */
+static
+void
+gzip_block(
+void *arg)
+{
+    struct gzip_block *b;
+    z_stream zs;
+    size_t bound;
+
+	b = arg;
+	b->crc = crc32(0, (const Bytef *)b->data, b->len);
+	memset(&zs, '\0', sizeof(z_stream));
+	if(deflateInit2(&zs, GZIP_LEVEL, Z_DEFLATED, -MAX_WBITS, 8,
+			Z_DEFAULT_STRATEGY) != Z_OK){
+	    b->failed = 1;
+	    return;
+	}
+	/* the sync flush adds an empty stored block of at most 10 bytes */
+	bound = deflateBound(&zs, b->len) + 16;
+	if((b->out = malloc(bound)) == NULL ||
+	   (b->dictlen != 0 &&
+	    deflateSetDictionary(&zs, (const Bytef *)b->data - b->dictlen,
+				 b->dictlen) != Z_OK)){
+	    deflateEnd(&zs);
+	    b->failed = 1;
+	    return;
+	}
+	zs.next_in = (Bytef *)b->data;
+	zs.avail_in = b->len;
+	zs.next_out = (Bytef *)b->out;
+	zs.avail_out = bound;
+	if(deflate(&zs, b->last ? Z_FINISH : Z_SYNC_FLUSH) ==
+	   (b->last ? Z_STREAM_END : Z_OK) && zs.avail_in == 0)
+	    b->outlen = bound - zs.avail_out;
+	else
+	    b->failed = 1;
+	deflateEnd(&zs);
+}
+
+#ifdef WITH_ZSTD
+/*
+ * zstd_write compresses the data with zstd, which splits it into jobs for
+ * its own worker threads, as many as the workqueue has threads.
+ */
+static
+int
+zstd_write(
+struct workqueue *wq,
+int fd,
+const char *data,
+uint64_t size)
+{
+    ZSTD_CCtx *cctx;
+    ZSTD_inBuffer in;
+    ZSTD_outBuffer out;
+    char *buf;
+    size_t remaining;
+    int result;
+
+	if((cctx = ZSTD_createCCtx()) == NULL){
+	    errno = ENOMEM;
+	    return(-1);
+	}
+	if((buf = malloc(ZSTD_CStreamOutSize())) == NULL){
+	    ZSTD_freeCCtx(cctx);
+	    return(-1);
+	}
+	ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, ZSTD_LEVEL);
+	/* this fails if the library is built without threads, which is fine */
+	if(wq->nthreads != 0)
+	    ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers, wq->nthreads + 1);
+	ZSTD_CCtx_setPledgedSrcSize(cctx, size);
+	in.src = data;
+	in.size = size;
+	in.pos = 0;
+	result = 0;
+	do{
+	    out.dst = buf;
+	    out.size = ZSTD_CStreamOutSize();
+	    out.pos = 0;
+	    remaining = ZSTD_compressStream2(cctx, &out, &in, ZSTD_e_end);
+	    if(ZSTD_isError(remaining)){
+		errno = EIO;
+		result = -1;
+		break;
+	    }
+	    if(write_all(fd, buf, out.pos) == -1){
+		result = -1;
+		break;
+	    }
+	}while(remaining != 0);
+	free(buf);
+	ZSTD_freeCCtx(cctx);
+	return(result);
+}
+#endif /* WITH_ZSTD */
+
+struct compress_stream *
+compress_stream_open(
+enum compress_format format)
+{
+    struct compress_stream *cs;
+
+	if((cs = calloc(1, sizeof(struct compress_stream))) == NULL)
+	    return(NULL);
+	cs->format = format;
+#ifdef WITH_ZSTD
+	if(format == COMPRESS_ZSTD){
+	    if((cs->cctx = ZSTD_createCCtx()) == NULL){
+		free(cs);
+		errno = ENOMEM;
+		return(NULL);
+	    }
+	    ZSTD_CCtx_setParameter(cs->cctx, ZSTD_c_compressionLevel,
+				   ZSTD_LEVEL);
+	    return(cs);
+	}
+#endif
+	/* a window of 16 more bits asks for a gzip header and trailer */
+	if(format != COMPRESS_GZIP ||
+	   deflateInit2(&cs->zs, GZIP_LEVEL, Z_DEFLATED, MAX_WBITS + 16, 8,
+			Z_DEFAULT_STRATEGY) != Z_OK){
+	    free(cs);
+	    errno = format != COMPRESS_GZIP ? EINVAL : ENOMEM;
+	    return(NULL);
+	}
+	return(cs);
+}
+
+int
+compress_stream_write(
+struct compress_stream *cs,
+int fd,
+const char *buf,
+size_t len)
+{
+#ifdef WITH_ZSTD
+    ZSTD_inBuffer in;
+    ZSTD_outBuffer out;
+    size_t ret;
+
+	if(cs->format == COMPRESS_ZSTD){
+	    in.src = buf;
+	    in.size = len;
+	    in.pos = 0;
+	    while(in.pos < in.size){
+		out.dst = cs->out;
+		out.size = sizeof(cs->out);
+		out.pos = 0;
+		ret = ZSTD_compressStream2(cs->cctx, &out, &in,
+					   ZSTD_e_continue);
+		if(ZSTD_isError(ret)){
+		    errno = EIO;
+		    return(-1);
+		}
+		if(write_all(fd, cs->out, out.pos) == -1)
+		    return(-1);
+	    }
+	    return(0);
+	}
+#endif
+	cs->zs.next_in = (Bytef *)buf;
+	cs->zs.avail_in = len;
+	while(cs->zs.avail_in != 0){
+	    cs->zs.next_out = (Bytef *)cs->out;
+	    cs->zs.avail_out = sizeof(cs->out);
+	    if(deflate(&cs->zs, Z_NO_FLUSH) != Z_OK){
+		errno = EIO;
+		return(-1);
+	    }
+	    if(write_all(fd, cs->out,
+			 sizeof(cs->out) - cs->zs.avail_out) == -1)
+		return(-1);
+	}
+	return(0);
+}
+
+int
+compress_stream_close(
+struct compress_stream *cs,
+int fd)
+{
+    int ret, result;
+#ifdef WITH_ZSTD
+    ZSTD_inBuffer in;
+    ZSTD_outBuffer out;
+    size_t remaining;
+
+	if(cs->format == COMPRESS_ZSTD){
+	    result = 0;
+	    in.src = NULL;
+	    in.size = 0;
+	    in.pos = 0;
+	    do{
+		if(fd == -1)
+		    break;
+		out.dst = cs->out;
+		out.size = sizeof(cs->out);
+		out.pos = 0;
+		remaining = ZSTD_compressStream2(cs->cctx, &out, &in,
+						 ZSTD_e_end);
+		if(ZSTD_isError(remaining)){
+		    errno = EIO;
+		    result = -1;
+		    break;
+		}
+		if(write_all(fd, cs->out, out.pos) == -1){
+		    result = -1;
+		    break;
+		}
+	    }while(remaining != 0);
+	    ZSTD_freeCCtx(cs->cctx);
+	    free(cs);
+	    return(result);
+	}
+#endif
+	result = 0;
+	cs->zs.next_in = NULL;
+	cs->zs.avail_in = 0;
+	do{
+	    if(fd == -1)
+		break;
+	    cs->zs.next_out = (Bytef *)cs->out;
+	    cs->zs.avail_out = sizeof(cs->out);
+	    ret = deflate(&cs->zs, Z_FINISH);
+	    if(ret != Z_OK && ret != Z_STREAM_END){
+		errno = EIO;
+		result = -1;
+		break;
+	    }
+	    if(write_all(fd, cs->out,
+			 sizeof(cs->out) - cs->zs.avail_out) == -1){
+		result = -1;
+		break;
+	    }
+	}while(ret != Z_STREAM_END);
+	deflateEnd(&cs->zs);
+	free(cs);
+	return(result);
+}
+
+enum decompress_format
+decompress_format(
+const char *data,
+size_t len)
+{
+    const unsigned char *p;
+
+	p = (const unsigned char *)data;
+	if(len < DECOMPRESS_HEADER)
+	    return(DECOMPRESS_RAW);
+	if(memcmp(p, "ZLIB", 4) == 0)
+	    return(DECOMPRESS_ZDEBUG);
+	if(p[0] == 0x1f && p[1] == 0x8b && p[2] == Z_DEFLATED)
+	    return(DECOMPRESS_GZIP);
+	/* deflate with a 32 KiB window, a header check and no dictionary */
+	if(p[0] == 0x78 && (p[0] << 8 | p[1]) % 31 == 0 && (p[1] & 0x20) == 0)
+	    return(DECOMPRESS_ZLIB);
+	return(DECOMPRESS_RAW);
+}
+
+struct decompress_stream *
+decompress_stream_open(void)
+{
+	return(calloc(1, sizeof(struct decompress_stream)));
+}
+
+int
+decompress_stream_write(
+struct decompress_stream *ds,
+int fd,
+const char *buf,
+size_t len)
+{
+    size_t n;
+    uint32_t i;
+
+	/* the format is known once the first bytes are there */
+	if(ds->started == 0){
+	    n = DECOMPRESS_HEADER - ds->nheader < len ?
+		DECOMPRESS_HEADER - ds->nheader : len;
+	    memcpy(ds->header + ds->nheader, buf, n);
+	    ds->nheader += n;
+	    buf += n;
+	    len -= n;
+	    if(ds->nheader < DECOMPRESS_HEADER)
+		return(0);
+	    ds->started = 1;
+	    ds->format = decompress_format(ds->header, ds->nheader);
+	    if(ds->format == DECOMPRESS_RAW){
+		if(write_all(fd, ds->header, ds->nheader) == -1)
+		    return(-1);
+	    }
+	    else{
+		if(inflateInit2(&ds->zs, ds->format == DECOMPRESS_GZIP ?
+				MAX_WBITS + 16 : MAX_WBITS) != Z_OK){
+		    errno = ENOMEM;
+		    return(-1);
+		}
+		if(ds->format == DECOMPRESS_ZDEBUG){
+		    for(i = 4; i < 12; i++)
+			ds->size = ds->size << 8 |
+				   (unsigned char)ds->header[i];
+		}
+		else if(inflate_write(ds, fd, ds->header, ds->nheader) == -1)
+		    return(-1);
+	    }
+	}
+	if(ds->format == DECOMPRESS_RAW)
+	    return(write_all(fd, buf, len));
+	return(inflate_write(ds, fd, buf, len));
+}
+
+int
+decompress_stream_close(
+struct decompress_stream *ds,
+int fd,
+enum decompress_format *format)
+{
+    int result;
+
+	result = 0;
+	if(ds->started == 0){
+	    ds->format = DECOMPRESS_RAW;
+	    if(fd != -1)
+		result = write_all(fd, ds->header, ds->nheader);
+	}
+	else if(ds->format != DECOMPRESS_RAW){
+	    if(fd != -1 &&
+	       (ds->ended == 0 ||
+		(ds->format == DECOMPRESS_ZDEBUG &&
+		 ds->zs.total_out != ds->size))){
+		errno = EILSEQ;
+		result = -1;
+	    }
+	    inflateEnd(&ds->zs);
+	}
+	if(format != NULL)
+	    *format = ds->format;
+	free(ds);
+	return(result);
+}
+
+/*
+ * inflate_write inflates the len bytes at buf and writes what comes out to fd.
+ * Anything after the end of the compressed data, like padding, is ignored.
+ */
+static
+int
+inflate_write(
+struct decompress_stream *ds,
+int fd,
+const char *buf,
+size_t len)
+{
+    int ret;
+
+	ds->zs.next_in = (Bytef *)buf;
+	ds->zs.avail_in = len;
+	while(ds->zs.avail_in != 0 && ds->ended == 0){
+	    ds->zs.next_out = (Bytef *)ds->out;
+	    ds->zs.avail_out = sizeof(ds->out);
+	    ret = inflate(&ds->zs, Z_NO_FLUSH);
+	    if(ret == Z_STREAM_END)
+		ds->ended = 1;
+	    else if(ret != Z_OK){
+		errno = ret == Z_MEM_ERROR ? ENOMEM : EILSEQ;
+		return(-1);
+	    }
+	    if(write_all(fd, ds->out,
+			 sizeof(ds->out) - ds->zs.avail_out) == -1)
+		return(-1);
+	}
+	return(0);
+}
+
+/*
+ * write_all writes size bytes at buf to fd.  It returns -1 with errno set if
+ * they can't be written.
+ */
+static
+int
+write_all(
+int fd,
+const char *buf,
+size_t size)
+{
+    ssize_t n;
+
+	while(size != 0){
+	    n = write(fd, buf, size);
+	    if(n == -1 && errno == EINTR)
+		continue;
+	    if(n <= 0){
+		if(n == 0)
+		    errno = ENOSPC;
+		return(-1);
+	    }
+	    buf += n;
+	    size -= n;
+	}
+	return(0);
+}
@@ -0,0 +1,131 @@
+/*
+ * Compressing output files as they are written, with gzip or zstd, and
+ * decompressing compressed section contents.
+ */
+#ifndef _COMPRESS_H_
+#define _COMPRESS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "workqueue.h"
+
+enum compress_format {
+    COMPRESS_NONE,
+    COMPRESS_GZIP,		/* gzip, with zlib */
+    COMPRESS_ZSTD		/* zstd, when built with WITH_ZSTD */
+};
+
+/*
+ * compress_suffix() returns the file name suffix of the format, like ".gz".
+ */
+extern const char *compress_suffix(
+    enum compress_format format);
+
+/*
+ * compress_write() writes the size bytes at data compressed to fd.  Large data
+ * is compressed in blocks by the threads of the workqueue: gzip blocks are
+ * deflated independently with the 32 KiB before them as dictionary, like
+ * pigz does, and zstd uses its own worker threads.  The caller waits for the
+ * blocks, running some of them itself, so it may be a work item of the
+ * workqueue.  It returns -1 with errno set if the data can't be written.
+ */
+extern int compress_write(
+    enum compress_format format,
+    struct workqueue *wq,
+    int fd,
+    const char *data,
+    uint64_t size);
+
+/*
+ * A compress_stream compresses data that is written to it piece by piece, for
+ * data that is not all in memory at once.
+ */
+struct compress_stream;
+
+/*
+ * compress_stream_open() returns a new compress_stream, or NULL with errno
+ * set if it can't be allocated.
+ */
+extern struct compress_stream *compress_stream_open(
+    enum compress_format format);
+
+/*
+ * compress_stream_write() compresses the len bytes at buf and writes what
+ * comes out to fd.  It returns -1 with errno set if that can't be written.
+ */
+extern int compress_stream_write(
+    struct compress_stream *cs,
+    int fd,
+    const char *buf,
+    size_t len);
+
+/*
+ * compress_stream_close() writes the end of the compressed data to fd, unless
+ * fd is -1, and frees the compress_stream.  It returns -1 with errno set if
+ * that can't be written.
+ */
+extern int compress_stream_close(
+    struct compress_stream *cs,
+    int fd);
+
+/*
+ * The formats of compressed section contents that are recognized by their
+ * header for -decompress.
+ */
+enum decompress_format {
+    DECOMPRESS_RAW,		/* not compressed */
+    DECOMPRESS_ZDEBUG,		/* "ZLIB", the uncompressed size as a 64-bit
+				   big endian number and zlib data, as in
+				   __zdebug_* sections */
+    DECOMPRESS_ZLIB,		/* zlib data with a 32 KiB window */
+    DECOMPRESS_GZIP		/* gzip data */
+};
+
+/*
+ * decompress_format() returns the format of data that starts with the len
+ * bytes at data.  Data shorter than DECOMPRESS_HEADER bytes is not
+ * recognized as compressed.
+ */
+#define DECOMPRESS_HEADER 12
+extern enum decompress_format decompress_format(
+    const char *data,
+    size_t len);
+
+/*
+ * A decompress_stream inflates data that is written to it piece by piece, in
+ * whichever format its first bytes are, and writes it out a small buffer at a
+ * time, so that the memory used does not depend on the size.  Data in no
+ * recognized format is written as it is.
+ */
+struct decompress_stream;
+
+/*
+ * decompress_stream_open() returns a new decompress_stream, or NULL with errno
+ * set if it can't be allocated.
+ */
+extern struct decompress_stream *decompress_stream_open(
+    void);
+
+/*
+ * decompress_stream_write() inflates the len bytes at buf and writes what
+ * comes out to fd.  It returns -1 with errno set if that can't be written,
+ * and with errno set to EILSEQ if the data is corrupt.
+ */
+extern int decompress_stream_write(
+    struct decompress_stream *ds,
+    int fd,
+    const char *buf,
+    size_t len);
+
+/*
+ * decompress_stream_close() writes the rest of the data to fd, unless fd is
+ * -1, checks that it was complete and frees the decompress_stream.  It
+ * returns -1 with errno set like decompress_stream_write().  If format is not
+ * NULL the format of the data is left there.
+ */
+extern int decompress_stream_close(
+    struct decompress_stream *ds,
+    int fd,
+    enum decompress_format *format);
+
+#endif /* _COMPRESS_H_ */
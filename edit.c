@@ -0,0 +1,1409 @@
+/*
+ * Writing an edited copy of an input file for -replace, -remove and
+ * -remove-segment.
+ */
+#define _GNU_SOURCE	/* for fallocate() */
+#define _FILE_OFFSET_BITS 64
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <limits.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "ofile.h"
+#include "bytesex.h"
+#include "edit.h"
+
+struct replace *replaces;	/* first replace structure, NULL if none */
+struct remove *removes;		/* first remove structure, NULL if none */
+char *output_name;		/* -output, where the copy is written */
+
+/* written where holes can't be punched */
+static const char zeros[4096];
+
+/*
+ * The layout of an object in the output file of -replace and -remove.  The
+ * object is made of byte ranges of the input object, which are copied (or
+ * cloned) to their offsets in the output, and the writes of new contents over
+ * them, which include the fixed up headers.  Bytes that are in neither are
+ * zero.  Offsets are relative to the start of the object.
+ */
+struct layout_range {
+    uint64_t offset;		/* offset of the bytes in the input object */
+    uint64_t size;		/* number of bytes */
+    uint64_t new_offset;	/* their offset in the output object */
+};
+struct layout_write {
+    uint64_t offset;		/* offset in the input object, and in the output
+				   object once the ranges are all moved */
+    uint64_t size;		/* number of bytes */
+    const char *data;		/* the bytes, NULL for zeros */
+};
+struct layout {
+    uint64_t offset;		/* offset of the object in the input file */
+    uint64_t size;		/* size of the object in the input file */
+    uint64_t new_offset;	/* and in the output file */
+    uint64_t new_size;
+    char *headers;		/* copy of the mach header and load commands,
+				   NULL if they are not changed */
+    uint32_t headers_size;	/* size of the mach header and load commands */
+    struct layout_range *ranges;/* the ranges in the order of their offsets */
+    uint32_t nranges;
+    struct layout_write *writes;/* the writes over them */
+    uint32_t nwrites;
+};
+
+/* the offset of a field in a segment or section header of either width */
+#define SEG_OFFSET(is64, field) ((is64) ? \
+	offsetof(struct segment_command_64, field) : \
+	offsetof(struct segment_command, field))
+#define SECT_OFFSET(is64, field) ((is64) ? \
+	offsetof(struct section_64, field) : offsetof(struct section, field))
+
+static int plan_object(
+    struct ofile *ofile,
+    struct layout *lp);
+static int plan_replace(
+    struct ofile *ofile,
+    struct layout *lp);
+static int replace_section(
+    struct ofile *ofile,
+    struct layout *lp,
+    char *sgp,
+    char *sp,
+    struct replace *rp);
+static int plan_remove(
+    struct ofile *ofile,
+    struct layout *lp);
+static int remove_segment(
+    struct ofile *ofile,
+    struct layout *lp,
+    char *sgp);
+static void remove_section(
+    struct ofile *ofile,
+    struct layout *lp,
+    char *sp);
+static void trim_segment(
+    struct ofile *ofile,
+    struct layout *lp,
+    char *sgp);
+static uint32_t layout_align(
+    struct ofile *ofile);
+static const char *find_segment(
+    struct ofile *ofile,
+    struct layout *lp,
+    uint64_t start,
+    uint64_t end);
+static int fix_offsets(
+    struct ofile *ofile,
+    struct layout *lp);
+static int fix_offset_pair(
+    struct ofile *ofile,
+    struct layout *lp,
+    char *lcp,
+    uint32_t off,
+    uint32_t count,
+    uint32_t entsize);
+static int fix_offset(
+    struct ofile *ofile,
+    struct layout *lp,
+    char *p,
+    int wide,
+    uint64_t size);
+static int layout_offset(
+    struct layout *lp,
+    uint64_t offset,
+    uint64_t *new_offset);
+static void layout_grow(
+    struct layout *lp,
+    uint64_t offset,
+    uint64_t size);
+static void layout_remove(
+    struct layout *lp,
+    uint64_t offset,
+    uint64_t size);
+static void add_write(
+    struct layout *lp,
+    uint64_t offset,
+    uint64_t size,
+    const char *data);
+static int write_output(
+    struct ofile *ofile,
+    struct layout *layouts,
+    uint32_t narchs);
+static int zero_ranges(
+    int fd,
+    struct layout *lp,
+    uint64_t offset,
+    uint64_t size);
+static int pwrite_all(
+    int fd,
+    const char *buf,
+    uint64_t size,
+    uint64_t offset);
+static int pwrite_zeros(
+    int fd,
+    uint64_t size,
+    uint64_t offset);
+static uint64_t get_word(
+    const char *p,
+    int is64,
+    int swapped);
+static void put_word(
+    char *p,
+    uint64_t v,
+    int is64,
+    int swapped);
+
+void
+map_replacement(
+struct replace *rp)
+{
+    int fd;
+    struct stat stat_buf;
+
+	if((fd = open(rp->filename, O_RDONLY)) == -1)
+	    fatal("can't open: %s (%s)", rp->filename, strerror(errno));
+	if(fstat(fd, &stat_buf) == -1)
+	    fatal("can't stat: %s (%s)", rp->filename, strerror(errno));
+	rp->size = stat_buf.st_size;
+	rp->contents = NULL;
+	if(rp->size != 0 &&
+	   (rp->contents = mmap(NULL, rp->size, PROT_READ, MAP_PRIVATE, fd,
+				0)) == MAP_FAILED)
+	    fatal("can't map: %s (%s)", rp->filename, strerror(errno));
+	close(fd);
+}
+
+int
+edit_input(
+struct ofile *ofile)
+{
+    uint32_t i, narchs;
+    int result, nselected;
+    char *selected;
+    struct layout *layouts, *lp;
+    struct stat stat_buf;
+
+	if(ofile->streaming){
+	    error("can't edit: %s (not a regular file)",
+		  ofile->sf.file_name);
+	    return(-1);
+	}
+	if(stat(output_name, &stat_buf) == 0 &&
+	   stat_buf.st_dev == ofile->sf.file_dev &&
+	   stat_buf.st_ino == ofile->sf.file_ino){
+	    error("output file: %s is the input file", output_name);
+	    return(-1);
+	}
+
+	narchs = segedit_narchs(&ofile->sf);
+	selected = allocate(narchs);
+	if(ofile->sf.fat_archs == NULL){
+	    selected[0] = 1;
+	    nselected = 1;
+	}
+	else if((nselected = select_fat_archs(ofile, selected)) == -1){
+	    free(selected);
+	    return(-1);
+	}
+	layouts = allocate(narchs * sizeof(struct layout));
+	memset(layouts, '\0', narchs * sizeof(struct layout));
+	result = 0;
+	for(i = 0; i < narchs; i++){
+	    lp = layouts + i;
+	    if(ofile->sf.fat_archs == NULL){
+		lp->offset = 0;
+		lp->size = ofile->sf.file_size;
+	    }
+	    else{
+		lp->offset = ofile->sf.fat_archs[i].offset;
+		lp->size = ofile->sf.fat_archs[i].size;
+	    }
+	    lp->new_size = lp->size;
+	    lp->ranges = allocate(sizeof(struct layout_range));
+	    lp->ranges[0].offset = 0;
+	    lp->ranges[0].size = lp->size;
+	    lp->ranges[0].new_offset = 0;
+	    lp->nranges = 1;
+	    if(selected[i] == 0)
+		continue;
+
+	    if(ofile->sf.fat_archs == NULL)
+		ofile->sf.object_name = ofile->sf.file_name;
+	    else
+		set_object_name(ofile, i, nselected);
+	    if(map_arch(ofile, i) == -1 ||
+	       (ofile->sf.fat_archs == NULL && check_arch_flags(ofile) == -1) ||
+	       plan_object(ofile, lp) == -1)
+		result = -1;
+	    if(ofile->sf.fat_archs != NULL){
+		free(ofile->sf.object_name);
+		ofile->sf.object_name = NULL;
+	    }
+	}
+	if(result == 0)
+	    result = write_output(ofile, layouts, narchs);
+
+	for(i = 0; i < narchs; i++){
+	    free(layouts[i].headers);
+	    free(layouts[i].ranges);
+	    free(layouts[i].writes);
+	}
+	free(layouts);
+	free(selected);
+	return(result);
+}
+
+/*
+ * plan_object plans the layout of the object in the output file, with its
+ * sections replaced and removed in a copy of its headers.  The file offsets
+ * in the load commands are then fixed up for what moved.  It returns -1 and
+ * prints an error if the object can't be edited.
+ */
+static
+int
+plan_object(
+struct ofile *ofile,
+struct layout *lp)
+{
+	lp->headers_size = ofile->sf.mhp64 != NULL ?
+	    sizeof(struct mach_header_64) + ofile->sf.mhp64->sizeofcmds :
+	    sizeof(struct mach_header) + ofile->sf.mhp->sizeofcmds;
+	lp->headers = allocate(lp->headers_size);
+	memcpy(lp->headers, ofile->sf.object_addr, lp->headers_size);
+	if(replaces != NULL && plan_replace(ofile, lp) == -1)
+	    return(-1);
+	if(removes != NULL && plan_remove(ofile, lp) == -1)
+	    return(-1);
+	return(fix_offsets(ofile, lp));
+}
+
+/*
+ * plan_replace replaces the sections of the -replace options in the layout of
+ * the object.  It returns -1 and prints an error if one of them is not in the
+ * object or can't be replaced.
+ */
+static
+int
+plan_replace(
+struct ofile *ofile,
+struct layout *lp)
+{
+    uint32_t i, j, cmd, cmdsize, nsects, segcmd, sectsize;
+    int is64, swapped, result;
+    char *lcp, *sp;
+    struct replace *rp;
+
+	is64 = ofile->sf.mhp64 != NULL;
+	swapped = ofile->sf.swapped;
+	segcmd = is64 ? LC_SEGMENT_64 : LC_SEGMENT;
+	sectsize = is64 ? sizeof(struct section_64) : sizeof(struct section);
+
+	for(rp = replaces; rp != NULL; rp = rp->next)
+	    rp->found = 0;
+	result = 0;
+	lcp = lp->headers + (is64 ? sizeof(struct mach_header_64) :
+				    sizeof(struct mach_header));
+	for(i = 0; i < ofile->sf.mh_ncmds; i++, lcp += cmdsize){
+	    cmd = get_uint32(lcp, swapped);
+	    cmdsize = get_uint32(lcp + offsetof(struct load_command, cmdsize),
+				 swapped);
+	    if(cmd != segcmd)
+		continue;
+	    nsects = get_uint32(lcp + SEG_OFFSET(is64, nsects), swapped);
+	    sp = lcp + (is64 ? sizeof(struct segment_command_64) :
+			       sizeof(struct segment_command));
+	    for(j = 0; j < nsects; j++, sp += sectsize){
+		for(rp = replaces; rp != NULL; rp = rp->next){
+		    if(rp->found == 0 &&
+		       strncmp(rp->segname, sp + SECT_OFFSET(is64, segname),
+			       16) == 0 &&
+		       strncmp(rp->sectname, sp + SECT_OFFSET(is64, sectname),
+			       16) == 0)
+			break;
+		}
+		if(rp == NULL)
+		    continue;
+		rp->found = 1;
+		if(replace_section(ofile, lp, lcp, sp, rp) == -1)
+		    result = -1;
+	    }
+	}
+	for(rp = replaces; rp != NULL; rp = rp->next){
+	    if(rp->found == 0){
+		error("section (%s,%s) not found in: %s", rp->segname,
+		      rp->sectname, ofile->sf.object_name);
+		result = -1;
+	    }
+	}
+	return(result);
+}
+
+/*
+ * replace_section replaces the contents of the section with the header at sp,
+ * in the segment command at sgp, with the contents of the replace structure.
+ * New contents that fit in the file extent of the section, which goes up to the
+ * next section or the end of the segment, are written over the old ones and the
+ * rest of the old contents is zeroed, so the object is otherwise copied as it
+ * is.  Only the last section of a segment can grow past that, and then
+ * everything after the segment in the file is moved by a multiple of
+ * layout_align().  The addresses in the object are never changed, so the
+ * section can only grow into addresses no other section or segment uses.  It
+ * returns -1 and prints an error if the section can't be replaced.
+ */
+static
+int
+replace_section(
+struct ofile *ofile,
+struct layout *lp,
+char *sgp,
+char *sp,
+struct replace *rp)
+{
+    uint32_t i, nsects, sectsize, align;
+    int is64, swapped;
+    uint64_t offset, size, addr, fileoff, filesize, vmaddr, vmsize;
+    uint64_t file_end, vm_end, new_vmsize, grow, t;
+    char *tp;
+    const char *segname;
+
+	is64 = ofile->sf.mhp64 != NULL;
+	swapped = ofile->sf.swapped;
+	sectsize = is64 ? sizeof(struct section_64) : sizeof(struct section);
+	if(is_zerofill(get_uint32(sp + SECT_OFFSET(is64, flags), swapped))){
+	    error("can't replace zero fill section (%s,%s) in: %s",
+		  rp->segname, rp->sectname, ofile->sf.object_name);
+	    return(-1);
+	}
+	offset = get_uint32(sp + SECT_OFFSET(is64, offset), swapped);
+	size = get_word(sp + SECT_OFFSET(is64, size), is64, swapped);
+	addr = get_word(sp + SECT_OFFSET(is64, addr), is64, swapped);
+	fileoff = get_word(sgp + SEG_OFFSET(is64, fileoff), is64, swapped);
+	filesize = get_word(sgp + SEG_OFFSET(is64, filesize), is64, swapped);
+	vmaddr = get_word(sgp + SEG_OFFSET(is64, vmaddr), is64, swapped);
+	vmsize = get_word(sgp + SEG_OFFSET(is64, vmsize), is64, swapped);
+	if(offset > lp->size || size > lp->size - offset ||
+	   offset < fileoff || offset + size > fileoff + filesize){
+	    error("truncated or malformed object (section contents of "
+		  "(%s,%s) extends past the end of its segment) in: %s",
+		  rp->segname, rp->sectname, ofile->sf.object_name);
+	    return(-1);
+	}
+	if(is64 == 0 && rp->size > UINT32_MAX){
+	    error("contents of: %s too large for section (%s,%s) in: %s",
+		  rp->filename, rp->segname, rp->sectname,
+		  ofile->sf.object_name);
+	    return(-1);
+	}
+
+	/* the section has room up to the section after it, if any */
+	file_end = fileoff + filesize;
+	vm_end = vmaddr + vmsize;
+	nsects = get_uint32(sgp + SEG_OFFSET(is64, nsects), swapped);
+	tp = sgp + (is64 ? sizeof(struct segment_command_64) :
+			   sizeof(struct segment_command));
+	for(i = 0; i < nsects; i++, tp += sectsize){
+	    if(tp == sp)
+		continue;
+	    if(is_zerofill(get_uint32(tp + SECT_OFFSET(is64, flags),
+				      swapped)) == 0 &&
+	       get_word(tp + SECT_OFFSET(is64, size), is64, swapped) != 0){
+		t = get_uint32(tp + SECT_OFFSET(is64, offset), swapped);
+		if(t > offset && t < file_end)
+		    file_end = t;
+	    }
+	    t = get_word(tp + SECT_OFFSET(is64, addr), is64, swapped);
+	    if(t > addr && t < vm_end)
+		vm_end = t;
+	}
+	if((offset + rp->size > file_end && file_end != fileoff + filesize) ||
+	   (addr + rp->size > vm_end && vm_end != vmaddr + vmsize)){
+	    error("section (%s,%s) can't grow past the section after it in: "
+		  "%s", rp->segname, rp->sectname, ofile->sf.object_name);
+	    return(-1);
+	}
+
+	/*
+	 * A section that grows past the end of its segment moves what follows
+	 * the segment in the file, keeping the file offsets aligned.  The
+	 * segment grows in memory as well, if it can without running into
+	 * another segment.
+	 */
+	grow = 0;
+	if(offset + rp->size > file_end){
+	    align = layout_align(ofile);
+	    grow = (offset + rp->size - file_end + align - 1) &
+		   ~(uint64_t)(align - 1);
+	    new_vmsize = filesize + grow;
+	}
+	else
+	    new_vmsize = filesize;
+	if(addr + rp->size - vmaddr > new_vmsize)
+	    new_vmsize = addr + rp->size - vmaddr;
+	if(new_vmsize < vmsize)
+	    new_vmsize = vmsize;
+	if(new_vmsize != vmsize){
+	    if((segname = find_segment(ofile, lp, vmaddr + vmsize,
+				       vmaddr + new_vmsize)) != NULL){
+		error("section (%s,%s) can't grow past the addresses of "
+		      "segment %.16s in: %s", rp->segname, rp->sectname,
+		      segname, ofile->sf.object_name);
+		return(-1);
+	    }
+	    if(is64 == 0 && vmaddr + new_vmsize > UINT32_MAX){
+		error("section (%s,%s) can't grow past the end of the address "
+		      "space in: %s", rp->segname, rp->sectname,
+		      ofile->sf.object_name);
+		return(-1);
+	    }
+	    put_word(sgp + SEG_OFFSET(is64, vmsize), new_vmsize, is64,
+		     swapped);
+	}
+	if(grow != 0){
+	    layout_grow(lp, fileoff + filesize, grow);
+	    put_word(sgp + SEG_OFFSET(is64, filesize), filesize + grow, is64,
+		     swapped);
+	}
+
+	add_write(lp, offset, rp->size, rp->contents);
+	if(rp->size < size)
+	    add_write(lp, offset + rp->size, size - rp->size, NULL);
+	put_word(sp + SECT_OFFSET(is64, size), rp->size, is64, swapped);
+	return(0);
+}
+
+/*
+ * plan_remove removes the segments and sections of the -remove options in the
+ * layout of the object.  Their headers are kept, since symbols, relocation
+ * entries and the dyld information refer to sections and segments by their
+ * number, but they are left without contents.  It returns -1 and prints an
+ * error if one of them is not in the object or can't be removed.
+ */
+static
+int
+plan_remove(
+struct ofile *ofile,
+struct layout *lp)
+{
+    uint32_t i, j, cmd, cmdsize, nsects, segcmd, sectsize;
+    int is64, swapped, result, matched, removed;
+    char *lcp, *sp;
+    struct remove *rm;
+
+	is64 = ofile->sf.mhp64 != NULL;
+	swapped = ofile->sf.swapped;
+	segcmd = is64 ? LC_SEGMENT_64 : LC_SEGMENT;
+	sectsize = is64 ? sizeof(struct section_64) : sizeof(struct section);
+
+	for(rm = removes; rm != NULL; rm = rm->next)
+	    rm->found = 0;
+	result = 0;
+	lcp = lp->headers + (is64 ? sizeof(struct mach_header_64) :
+				    sizeof(struct mach_header));
+	for(i = 0; i < ofile->sf.mh_ncmds; i++, lcp += cmdsize){
+	    cmd = get_uint32(lcp, swapped);
+	    cmdsize = get_uint32(lcp + offsetof(struct load_command, cmdsize),
+				 swapped);
+	    if(cmd != segcmd)
+		continue;
+	    matched = 0;
+	    for(rm = removes; rm != NULL; rm = rm->next){
+		if(rm->sectname == NULL &&
+		   strncmp(rm->segname, lcp + SEG_OFFSET(is64, segname),
+			   16) == 0){
+		    rm->found = 1;
+		    matched = 1;
+		}
+	    }
+	    if(matched){
+		if(remove_segment(ofile, lp, lcp) == -1)
+		    result = -1;
+		continue;
+	    }
+	    removed = 0;
+	    nsects = get_uint32(lcp + SEG_OFFSET(is64, nsects), swapped);
+	    sp = lcp + (is64 ? sizeof(struct segment_command_64) :
+			       sizeof(struct segment_command));
+	    for(j = 0; j < nsects; j++, sp += sectsize){
+		matched = 0;
+		for(rm = removes; rm != NULL; rm = rm->next){
+		    if(rm->sectname != NULL &&
+		       strncmp(rm->segname, sp + SECT_OFFSET(is64, segname),
+			       16) == 0 &&
+		       strncmp(rm->sectname, sp + SECT_OFFSET(is64, sectname),
+			       16) == 0){
+			rm->found = 1;
+			matched = 1;
+		    }
+		}
+		if(matched){
+		    remove_section(ofile, lp, sp);
+		    removed = 1;
+		}
+	    }
+	    if(removed)
+		trim_segment(ofile, lp, lcp);
+	}
+	for(rm = removes; rm != NULL; rm = rm->next){
+	    if(rm->found != 0)
+		continue;
+	    if(rm->sectname == NULL){
+		error("segment %s not found in: %s", rm->segname,
+		      ofile->sf.object_name);
+	    }
+	    else{
+		error("section (%s,%s) not found in: %s", rm->segname,
+		      rm->sectname, ofile->sf.object_name);
+	    }
+	    result = -1;
+	}
+	return(result);
+}
+
+/*
+ * remove_segment removes the file contents of the segment with the command at
+ * sgp and leaves it, and its sections, without any.  What follows the segment
+ * in the file moves back by a multiple of layout_align(), so the end of a
+ * segment whose size is not such a multiple stays in the file, zeroed.  It
+ * returns -1 and prints an error if the segment contains the headers.
+ */
+static
+int
+remove_segment(
+struct ofile *ofile,
+struct layout *lp,
+char *sgp)
+{
+    uint32_t i, nsects, sectsize, align;
+    int is64, swapped;
+    uint64_t fileoff, filesize, size;
+    char *sp;
+
+	is64 = ofile->sf.mhp64 != NULL;
+	swapped = ofile->sf.swapped;
+	fileoff = get_word(sgp + SEG_OFFSET(is64, fileoff), is64, swapped);
+	filesize = get_word(sgp + SEG_OFFSET(is64, filesize), is64, swapped);
+	if(filesize != 0){
+	    if(fileoff < lp->headers_size){
+		error("can't remove segment %.16s, which contains the headers, "
+		      "from: %s", sgp + SEG_OFFSET(is64, segname),
+		      ofile->sf.object_name);
+		return(-1);
+	    }
+	    if(fileoff > lp->size || filesize > lp->size - fileoff){
+		error("truncated or malformed object (segment %.16s extends "
+		      "past the end of the file) in: %s",
+		      sgp + SEG_OFFSET(is64, segname), ofile->sf.object_name);
+		return(-1);
+	    }
+	    align = layout_align(ofile);
+	    size = filesize;
+	    if(fileoff + filesize != lp->size)
+		size &= ~(uint64_t)(align - 1);
+	    if(size != filesize)
+		add_write(lp, fileoff + size, filesize - size, NULL);
+	    layout_remove(lp, fileoff, size);
+	}
+
+	sectsize = is64 ? sizeof(struct section_64) : sizeof(struct section);
+	nsects = get_uint32(sgp + SEG_OFFSET(is64, nsects), swapped);
+	sp = sgp + (is64 ? sizeof(struct segment_command_64) :
+			   sizeof(struct segment_command));
+	for(i = 0; i < nsects; i++, sp += sectsize)
+	    remove_section(ofile, lp, sp);
+	put_word(sgp + SEG_OFFSET(is64, fileoff), 0, is64, swapped);
+	put_word(sgp + SEG_OFFSET(is64, filesize), 0, is64, swapped);
+	put_word(sgp + SEG_OFFSET(is64, vmsize), 0, is64, swapped);
+	return(0);
+}
+
+/*
+ * remove_section zeros the contents of the section with the header at sp, and
+ * leaves it without contents and relocation entries.
+ */
+static
+void
+remove_section(
+struct ofile *ofile,
+struct layout *lp,
+char *sp)
+{
+    int is64, swapped;
+    uint64_t offset, size;
+
+	is64 = ofile->sf.mhp64 != NULL;
+	swapped = ofile->sf.swapped;
+	if(is_zerofill(get_uint32(sp + SECT_OFFSET(is64, flags),
+				  swapped)) == 0){
+	    offset = get_uint32(sp + SECT_OFFSET(is64, offset), swapped);
+	    size = get_word(sp + SECT_OFFSET(is64, size), is64, swapped);
+	    if(size != 0)
+		add_write(lp, offset, size, NULL);
+	    put_uint32(sp + SECT_OFFSET(is64, offset), 0, swapped);
+	}
+	put_word(sp + SECT_OFFSET(is64, size), 0, is64, swapped);
+	put_uint32(sp + SECT_OFFSET(is64, reloff), 0, swapped);
+	put_uint32(sp + SECT_OFFSET(is64, nreloc), 0, swapped);
+}
+
+/*
+ * trim_segment removes the end of the file contents of the segment with the
+ * command at sgp that is past the contents of the sections left in it, after
+ * some were removed.  It is removed in a multiple of layout_align() unless it
+ * goes up to the end of the object, and becomes zero fill memory.
+ */
+static
+void
+trim_segment(
+struct ofile *ofile,
+struct layout *lp,
+char *sgp)
+{
+    uint32_t i, nsects, sectsize, align;
+    int is64, swapped;
+    uint64_t fileoff, filesize, offset, size, end;
+    char *sp;
+
+	is64 = ofile->sf.mhp64 != NULL;
+	swapped = ofile->sf.swapped;
+	fileoff = get_word(sgp + SEG_OFFSET(is64, fileoff), is64, swapped);
+	filesize = get_word(sgp + SEG_OFFSET(is64, filesize), is64, swapped);
+	if(filesize == 0 || fileoff > lp->size ||
+	   filesize > lp->size - fileoff)
+	    return;
+
+	/* the segment keeps the headers, and the contents of its sections */
+	end = fileoff < lp->headers_size ? lp->headers_size : fileoff;
+	sectsize = is64 ? sizeof(struct section_64) : sizeof(struct section);
+	nsects = get_uint32(sgp + SEG_OFFSET(is64, nsects), swapped);
+	sp = sgp + (is64 ? sizeof(struct segment_command_64) :
+			   sizeof(struct segment_command));
+	for(i = 0; i < nsects; i++, sp += sectsize){
+	    if(is_zerofill(get_uint32(sp + SECT_OFFSET(is64, flags), swapped)))
+		continue;
+	    offset = get_uint32(sp + SECT_OFFSET(is64, offset), swapped);
+	    size = get_word(sp + SECT_OFFSET(is64, size), is64, swapped);
+	    if(size != 0 && offset + size > end)
+		end = offset + size;
+	}
+	align = layout_align(ofile);
+	end = fileoff + ((end - fileoff + align - 1) & ~(uint64_t)(align - 1));
+	if(end >= fileoff + filesize)
+	    return;
+	size = fileoff + filesize - end;
+	if(fileoff + filesize != lp->size)
+	    size &= ~(uint64_t)(align - 1);
+	if(size == 0)
+	    return;
+	layout_remove(lp, end, size);
+	put_word(sgp + SEG_OFFSET(is64, filesize), filesize - size, is64,
+		 swapped);
+}
+
+/*
+ * layout_align returns the alignment the file offsets of what moves in the
+ * object are kept at: the page size, so that the segments can still be
+ * mapped, except in relocatable objects, which are not mapped.
+ */
+static
+uint32_t
+layout_align(
+struct ofile *ofile)
+{
+    uint32_t filetype;
+    cpu_type_t cputype;
+
+	if(ofile->sf.mhp64 != NULL){
+	    filetype = ofile->sf.mhp64->filetype;
+	    cputype = ofile->sf.mhp64->cputype;
+	}
+	else{
+	    filetype = ofile->sf.mhp->filetype;
+	    cputype = ofile->sf.mhp->cputype;
+	}
+	if(filetype == MH_OBJECT)
+	    return(8);
+	return(cputype == CPU_TYPE_ARM64 ? 0x4000 : 0x1000);
+}
+
+/*
+ * find_segment returns the name of a segment of the object, other than those
+ * without addresses, that has addresses from start up to end.  It returns NULL
+ * if there is none.
+ */
+static
+const char *
+find_segment(
+struct ofile *ofile,
+struct layout *lp,
+uint64_t start,
+uint64_t end)
+{
+    uint32_t i, cmd, cmdsize;
+    int is64, swapped;
+    uint64_t vmaddr, vmsize;
+    char *lcp;
+
+	is64 = ofile->sf.mhp64 != NULL;
+	swapped = ofile->sf.swapped;
+	lcp = lp->headers + (is64 ? sizeof(struct mach_header_64) :
+				    sizeof(struct mach_header));
+	for(i = 0; i < ofile->sf.mh_ncmds; i++, lcp += cmdsize){
+	    cmd = get_uint32(lcp, swapped);
+	    cmdsize = get_uint32(lcp + offsetof(struct load_command, cmdsize),
+				 swapped);
+	    if(cmd != (is64 ? LC_SEGMENT_64 : LC_SEGMENT))
+		continue;
+	    vmaddr = get_word(lcp + SEG_OFFSET(is64, vmaddr), is64, swapped);
+	    vmsize = get_word(lcp + SEG_OFFSET(is64, vmsize), is64, swapped);
+	    if(vmsize != 0 && vmaddr < end && vmaddr + vmsize > start)
+		return(lcp + SEG_OFFSET(is64, segname));
+	}
+	return(NULL);
+}
+
+/*
+ * fix_offsets changes the file offsets in the load commands of the object to
+ * where the bytes they point to are in the layout.  It returns -1 and prints
+ * an error if those bytes are not in the output, or their offsets can't be
+ * changed.
+ */
+static
+int
+fix_offsets(
+struct ofile *ofile,
+struct layout *lp)
+{
+    uint32_t i, j, cmd, cmdsize, nsects, sectsize, nlistsize;
+    int is64, swapped, result, moved;
+    char *lcp, *sp;
+
+	is64 = ofile->sf.mhp64 != NULL;
+	swapped = ofile->sf.swapped;
+	sectsize = is64 ? sizeof(struct section_64) : sizeof(struct section);
+	nlistsize = is64 ? 16 : 12;
+	moved = lp->new_size != lp->size;
+	for(i = 0; i < lp->nranges; i++)
+	    if(lp->ranges[i].new_offset != lp->ranges[i].offset)
+		moved = 1;
+
+	result = 0;
+	lcp = lp->headers + (is64 ? sizeof(struct mach_header_64) :
+				    sizeof(struct mach_header));
+	for(i = 0; i < ofile->sf.mh_ncmds && result == 0; i++, lcp += cmdsize){
+	    cmd = get_uint32(lcp, swapped);
+	    cmdsize = get_uint32(lcp + offsetof(struct load_command, cmdsize),
+				 swapped);
+	    switch(cmd){
+	    case LC_SEGMENT:
+	    case LC_SEGMENT_64:
+		if(cmd != (is64 ? LC_SEGMENT_64 : LC_SEGMENT))
+		    break;
+		result |= fix_offset(ofile, lp,
+		    lcp + SEG_OFFSET(is64, fileoff), is64,
+		    get_word(lcp + SEG_OFFSET(is64, filesize), is64, swapped));
+		nsects = get_uint32(lcp + SEG_OFFSET(is64, nsects), swapped);
+		sp = lcp + (is64 ? sizeof(struct segment_command_64) :
+				   sizeof(struct segment_command));
+		for(j = 0; j < nsects; j++, sp += sectsize){
+		    if(is_zerofill(get_uint32(sp + SECT_OFFSET(is64, flags),
+					      swapped)) == 0)
+			result |= fix_offset(ofile, lp,
+			    sp + SECT_OFFSET(is64, offset), 0,
+			    get_word(sp + SECT_OFFSET(is64, size), is64,
+				     swapped));
+		    result |= fix_offset(ofile, lp,
+			sp + SECT_OFFSET(is64, reloff), 0,
+			get_uint32(sp + SECT_OFFSET(is64, nreloc), swapped) *
+			(uint64_t)8);
+		}
+		break;
+	    case LC_SYMTAB:
+		if(cmdsize < sizeof(struct symtab_command))
+		    break;
+		result |= fix_offset(ofile, lp,
+		    lcp + offsetof(struct symtab_command, symoff), 0,
+		    get_uint32(lcp + offsetof(struct symtab_command, nsyms),
+			       swapped) * (uint64_t)nlistsize);
+		result |= fix_offset(ofile, lp,
+		    lcp + offsetof(struct symtab_command, stroff), 0,
+		    get_uint32(lcp + offsetof(struct symtab_command, strsize),
+			       swapped));
+		break;
+	    case LC_DYSYMTAB:
+		if(cmdsize < sizeof(struct dysymtab_command))
+		    break;
+		result |= fix_offset_pair(ofile, lp, lcp,
+		    offsetof(struct dysymtab_command, tocoff),
+		    offsetof(struct dysymtab_command, ntoc), 8);
+		result |= fix_offset_pair(ofile, lp, lcp,
+		    offsetof(struct dysymtab_command, modtaboff),
+		    offsetof(struct dysymtab_command, nmodtab),
+		    is64 ? 56 : 52);
+		result |= fix_offset_pair(ofile, lp, lcp,
+		    offsetof(struct dysymtab_command, extrefsymoff),
+		    offsetof(struct dysymtab_command, nextrefsyms), 4);
+		result |= fix_offset_pair(ofile, lp, lcp,
+		    offsetof(struct dysymtab_command, indirectsymoff),
+		    offsetof(struct dysymtab_command, nindirectsyms), 4);
+		result |= fix_offset_pair(ofile, lp, lcp,
+		    offsetof(struct dysymtab_command, extreloff),
+		    offsetof(struct dysymtab_command, nextrel), 8);
+		result |= fix_offset_pair(ofile, lp, lcp,
+		    offsetof(struct dysymtab_command, locreloff),
+		    offsetof(struct dysymtab_command, nlocrel), 8);
+		break;
+	    case LC_TWOLEVEL_HINTS:
+		if(cmdsize < sizeof(struct twolevel_hints_command))
+		    break;
+		result |= fix_offset_pair(ofile, lp, lcp,
+		    offsetof(struct twolevel_hints_command, offset),
+		    offsetof(struct twolevel_hints_command, nhints), 4);
+		break;
+	    case LC_SYMSEG:
+		if(cmdsize < sizeof(struct symseg_command))
+		    break;
+		result |= fix_offset_pair(ofile, lp, lcp,
+		    offsetof(struct symseg_command, offset),
+		    offsetof(struct symseg_command, size), 1);
+		break;
+	    case LC_CODE_SIGNATURE:
+		error("code signature of: %s is no longer valid",
+		      ofile->sf.object_name);
+		/* fall through */
+	    case LC_SEGMENT_SPLIT_INFO:
+	    case LC_FUNCTION_STARTS:
+	    case LC_DATA_IN_CODE:
+	    case LC_DYLIB_CODE_SIGN_DRS:
+	    case LC_LINKER_OPTIMIZATION_HINT:
+	    case LC_DYLD_EXPORTS_TRIE:
+	    case LC_DYLD_CHAINED_FIXUPS:
+		if(cmdsize < sizeof(struct linkedit_data_command))
+		    break;
+		result |= fix_offset_pair(ofile, lp, lcp,
+		    offsetof(struct linkedit_data_command, dataoff),
+		    offsetof(struct linkedit_data_command, datasize), 1);
+		break;
+	    case LC_DYLD_INFO:
+	    case LC_DYLD_INFO_ONLY:
+		if(cmdsize < sizeof(struct dyld_info_command))
+		    break;
+		result |= fix_offset_pair(ofile, lp, lcp,
+		    offsetof(struct dyld_info_command, rebase_off),
+		    offsetof(struct dyld_info_command, rebase_size), 1);
+		result |= fix_offset_pair(ofile, lp, lcp,
+		    offsetof(struct dyld_info_command, bind_off),
+		    offsetof(struct dyld_info_command, bind_size), 1);
+		result |= fix_offset_pair(ofile, lp, lcp,
+		    offsetof(struct dyld_info_command, weak_bind_off),
+		    offsetof(struct dyld_info_command, weak_bind_size), 1);
+		result |= fix_offset_pair(ofile, lp, lcp,
+		    offsetof(struct dyld_info_command, lazy_bind_off),
+		    offsetof(struct dyld_info_command, lazy_bind_size), 1);
+		result |= fix_offset_pair(ofile, lp, lcp,
+		    offsetof(struct dyld_info_command, export_off),
+		    offsetof(struct dyld_info_command, export_size), 1);
+		break;
+	    case LC_ENCRYPTION_INFO:
+	    case LC_ENCRYPTION_INFO_64:
+		if(cmdsize < sizeof(struct encryption_info_command))
+		    break;
+		result |= fix_offset_pair(ofile, lp, lcp,
+		    offsetof(struct encryption_info_command, cryptoff),
+		    offsetof(struct encryption_info_command, cryptsize), 1);
+		break;
+	    case LC_NOTE:
+		if(cmdsize < sizeof(struct note_command))
+		    break;
+		result |= fix_offset(ofile, lp,
+		    lcp + offsetof(struct note_command, offset), 1,
+		    get_uint64(lcp + offsetof(struct note_command, size),
+			       swapped));
+		break;
+	    case LC_FILESET_ENTRY:
+		/* the load commands of the entries have offsets of their own */
+		result = moved ? -1 : 0;
+		break;
+	    }
+	    if(result != 0)
+		error("can't move the contents of load command %u in: %s", i,
+		      ofile->sf.object_name);
+	}
+	return(result);
+}
+
+/*
+ * fix_offset_pair fixes the 32-bit file offset at off in the load command at
+ * lcp, of the table whose number of entries of entsize bytes is at count.
+ */
+static
+int
+fix_offset_pair(
+struct ofile *ofile,
+struct layout *lp,
+char *lcp,
+uint32_t off,
+uint32_t count,
+uint32_t entsize)
+{
+	return(fix_offset(ofile, lp, lcp + off, 0,
+			  get_uint32(lcp + count, ofile->sf.swapped) *
+			  (uint64_t)entsize));
+}
+
+/*
+ * fix_offset changes the file offset at p in a load command, which is 64 bits
+ * wide if wide is set and 32 bits otherwise, to where the size bytes at that
+ * offset are in the layout.  Offsets of nothing are left alone when they point
+ * nowhere in the layout.  It returns -1 if the bytes are not in the output or
+ * the new offset doesn't fit.
+ */
+static
+int
+fix_offset(
+struct ofile *ofile,
+struct layout *lp,
+char *p,
+int wide,
+uint64_t size)
+{
+    uint64_t offset, new_offset;
+
+	offset = wide ? get_uint64(p, ofile->sf.swapped) :
+			get_uint32(p, ofile->sf.swapped);
+	if(layout_offset(lp, offset, &new_offset) == -1)
+	    return(size == 0 ? 0 : -1);
+	if(wide)
+	    put_uint64(p, new_offset, ofile->sf.swapped);
+	else if(new_offset > UINT32_MAX)
+	    return(-1);
+	else
+	    put_uint32(p, new_offset, ofile->sf.swapped);
+	return(0);
+}
+
+/*
+ * layout_offset sets new_offset to where the byte at offset in the input
+ * object is in the output object, where the end of the object is just past its
+ * last byte.  It returns -1 if the byte is not in the output object.
+ */
+static
+int
+layout_offset(
+struct layout *lp,
+uint64_t offset,
+uint64_t *new_offset)
+{
+    uint32_t i;
+    struct layout_range *r;
+
+	for(i = 0; i < lp->nranges; i++){
+	    r = lp->ranges + i;
+	    if(offset < r->offset)
+		return(-1);
+	    if(offset - r->offset < r->size){
+		*new_offset = r->new_offset + (offset - r->offset);
+		return(0);
+	    }
+	}
+	if(offset != lp->size)
+	    return(-1);
+	*new_offset = lp->new_size;
+	return(0);
+}
+
+/*
+ * layout_grow inserts size bytes, which are zero unless they are written,
+ * before the byte at offset in the input object, which moves everything from
+ * there on.
+ */
+static
+void
+layout_grow(
+struct layout *lp,
+uint64_t offset,
+uint64_t size)
+{
+    uint32_t i;
+    struct layout_range *r;
+
+	for(i = 0; i < lp->nranges; i++){
+	    r = lp->ranges + i;
+	    if(offset > r->offset && offset - r->offset < r->size){
+		lp->ranges = reallocate(lp->ranges,
+		    (lp->nranges + 1) * sizeof(struct layout_range));
+		r = lp->ranges + i;
+		memmove(r + 1, r, (lp->nranges - i) *
+			sizeof(struct layout_range));
+		lp->nranges++;
+		r->size = offset - r->offset;
+		r[1].offset = offset;
+		r[1].size -= r->size;
+		r[1].new_offset += r->size;
+	    }
+	    else if(r->offset >= offset)
+		r->new_offset += size;
+	}
+	lp->new_size += size;
+}
+
+/*
+ * layout_remove takes the size bytes at offset in the input object out of the
+ * layout, which moves everything after them back.
+ */
+static
+void
+layout_remove(
+struct layout *lp,
+uint64_t offset,
+uint64_t size)
+{
+    uint32_t i;
+    uint64_t end, cut, removed;
+    struct layout_range *r;
+
+	end = offset + size;
+	removed = 0;
+	for(i = 0; i < lp->nranges; i++){
+	    r = lp->ranges + i;
+	    if(r->offset + r->size <= offset)
+		continue;
+	    if(r->offset >= end){
+		r->new_offset -= removed;
+		continue;
+	    }
+	    /* the part of the range before offset stays */
+	    if(r->offset < offset){
+		lp->ranges = reallocate(lp->ranges,
+		    (lp->nranges + 1) * sizeof(struct layout_range));
+		r = lp->ranges + i;
+		memmove(r + 1, r, (lp->nranges - i) *
+			sizeof(struct layout_range));
+		lp->nranges++;
+		r->size = offset - r->offset;
+		r[1].offset = offset;
+		r[1].size -= r->size;
+		r[1].new_offset += r->size;
+		continue;
+	    }
+	    cut = end - r->offset < r->size ? end - r->offset : r->size;
+	    removed += cut;
+	    if(cut == r->size){
+		memmove(r, r + 1, (lp->nranges - i - 1) *
+			sizeof(struct layout_range));
+		lp->nranges--;
+		i--;
+	    }
+	    else{
+		r->offset += cut;
+		r->size -= cut;
+		r->new_offset += cut - removed;
+	    }
+	}
+	lp->new_size -= removed;
+}
+
+/*
+ * add_write adds the write of the size bytes of data over the byte at offset in
+ * the input object to the layout.  If data is NULL the bytes are zeroed
+ * instead, but only those that are still in the layout.
+ */
+static
+void
+add_write(
+struct layout *lp,
+uint64_t offset,
+uint64_t size,
+const char *data)
+{
+    struct layout_write *w;
+
+	lp->writes = reallocate(lp->writes,
+	    (lp->nwrites + 1) * sizeof(struct layout_write));
+	w = lp->writes + lp->nwrites++;
+	w->offset = offset;
+	w->size = size;
+	w->data = data;
+}
+
+/*
+ * write_output writes the objects of the input file in their layouts to the
+ * -output file, which gets the mode of the input file.  The objects of a fat
+ * file keep their order, and the space and alignment between them.  When no
+ * byte moves the whole input file is copied at once, so on a file system with
+ * reflinks the output file shares all its blocks, and only the blocks written
+ * over are its own.  Otherwise each range of the layouts is copied on its own.
+ * It returns -1 and prints an error if the output file can't be written.
+ */
+static
+int
+write_output(
+struct ofile *ofile,
+struct layout *layouts,
+uint32_t narchs)
+{
+    int fd, result, moved, fat_swapped;
+    uint32_t i, j, k, *order, fat_headers_size;
+    uint64_t start, copy_start, close_start, size, end, old_end, align;
+    uint64_t offset;
+    char *fat_headers, *p;
+    struct layout *lp;
+    struct layout_range *r;
+    struct layout_write *w;
+
+	moved = 0;
+	fat_headers = NULL;
+	fat_headers_size = 0;
+	fat_swapped = 0;
+	if(ofile->sf.fat_archs == NULL){
+	    layouts[0].new_offset = 0;
+	    size = layouts[0].new_size;
+	}
+	else{
+	    fat_headers_size = sizeof(struct fat_header) + narchs *
+		(ofile->sf.fat_header.magic == FAT_MAGIC_64 ?
+		 sizeof(struct fat_arch_64) : sizeof(struct fat_arch));
+	    fat_headers = allocate(fat_headers_size);
+	    memcpy(fat_headers, ofile->sf.file_addr, fat_headers_size);
+	    fat_swapped = get_uint32(fat_headers, 0) !=
+			  ofile->sf.fat_header.magic;
+
+	    /* the objects are placed in the order of their offsets */
+	    order = allocate(narchs * sizeof(uint32_t));
+	    for(i = 0; i < narchs; i++){
+		for(j = i; j > 0 && layouts[order[j - 1]].offset >
+				    layouts[i].offset; j--)
+		    order[j] = order[j - 1];
+		order[j] = i;
+	    }
+	    end = fat_headers_size;
+	    old_end = fat_headers_size;
+	    for(k = 0; k < narchs; k++){
+		i = order[k];
+		lp = layouts + i;
+		align = (uint64_t)1 << (ofile->sf.fat_archs[i].align < 32 ?
+					ofile->sf.fat_archs[i].align : 0);
+		lp->new_offset = end + (lp->offset > old_end ?
+					lp->offset - old_end : 0);
+		lp->new_offset = (lp->new_offset + align - 1) & ~(align - 1);
+		old_end = lp->offset + lp->size;
+		end = lp->new_offset + lp->new_size;
+		if(ofile->sf.fat_header.magic == FAT_MAGIC_64){
+		    p = fat_headers + sizeof(struct fat_header) +
+			i * sizeof(struct fat_arch_64);
+		    put_uint64(p + offsetof(struct fat_arch_64, offset),
+			       lp->new_offset, fat_swapped);
+		    put_uint64(p + offsetof(struct fat_arch_64, size),
+			       lp->new_size, fat_swapped);
+		}
+		else if(end > UINT32_MAX){
+		    error("output file: %s too large for a 32-bit fat file",
+			  output_name);
+		    free(order);
+		    free(fat_headers);
+		    return(-1);
+		}
+		else{
+		    p = fat_headers + sizeof(struct fat_header) +
+			i * sizeof(struct fat_arch);
+		    put_uint32(p + offsetof(struct fat_arch, offset),
+			       lp->new_offset, fat_swapped);
+		    put_uint32(p + offsetof(struct fat_arch, size),
+			       lp->new_size, fat_swapped);
+		}
+	    }
+	    free(order);
+	    size = end;
+	}
+	for(i = 0; i < narchs; i++){
+	    lp = layouts + i;
+	    if(lp->new_offset != lp->offset || lp->new_size != lp->size ||
+	       lp->nranges != 1 || lp->ranges[0].new_offset != 0)
+		moved = 1;
+	}
+	if(moved == 0)
+	    size = ofile->sf.file_size;
+
+	start = phase_begin();
+	if((fd = create_output(output_name)) == -1){
+	    phase_end(ofile, PHASE_CREATE, start, 0);
+	    error("can't create: %s", output_name);
+	    free(fat_headers);
+	    return(-1);
+	}
+	result = fchmod(fd, ofile->sf.file_mode & 07777);
+	phase_end(ofile, PHASE_CREATE, start, 0);
+
+	copy_start = phase_begin();
+	if(result == 0 && moved == 0)
+	    result = copy_input(ofile, fd, 0, ofile->sf.file_size);
+	else if(result == 0){
+	    if(fat_headers != NULL)
+		result = pwrite_all(fd, fat_headers, fat_headers_size, 0);
+	    for(i = 0; i < narchs && result == 0; i++){
+		lp = layouts + i;
+		for(j = 0; j < lp->nranges && result == 0; j++){
+		    r = lp->ranges + j;
+		    if(lseek(fd, lp->new_offset + r->new_offset, SEEK_SET) ==
+		       -1 ||
+		       copy_input(ofile, fd, lp->offset + r->offset, r->size) ==
+		       -1)
+			result = -1;
+		}
+	    }
+	}
+	for(i = 0; i < narchs && result == 0; i++){
+	    lp = layouts + i;
+	    if(lp->headers != NULL)
+		result = pwrite_all(fd, lp->headers, lp->headers_size,
+				    lp->new_offset);
+	    for(j = 0; j < lp->nwrites && result == 0; j++){
+		w = lp->writes + j;
+		if(w->data == NULL)
+		    result = zero_ranges(fd, lp, w->offset, w->size);
+		else if(layout_offset(lp, w->offset, &offset) == 0)
+		    result = pwrite_all(fd, w->data, w->size,
+					lp->new_offset + offset);
+	    }
+	}
+	/* the end of the output file may not be written */
+	if(result == 0 && moved)
+	    result = ftruncate(fd, size);
+	phase_end(ofile, PHASE_COPY, copy_start, size);
+	if(result == -1)
+	    error("can't write: %s (%s)", output_name, strerror(errno));
+
+	close_start = phase_begin();
+	if(close(fd) == -1 && result == 0){
+	    error("can't close: %s", output_name);
+	    result = -1;
+	}
+	ofile->stats[PHASE_CREATE].time += phase_begin() - close_start;
+	if(result == -1)
+	    unlink(output_name);
+	free(fat_headers);
+	return(result);
+}
+
+/*
+ * zero_ranges zeros the size bytes at offset in the input object in the output
+ * file, where they are in the ranges of the layout, with pwrite_zeros().
+ */
+static
+int
+zero_ranges(
+int fd,
+struct layout *lp,
+uint64_t offset,
+uint64_t size)
+{
+    uint32_t i;
+    uint64_t start, end;
+    struct layout_range *r;
+
+	for(i = 0; i < lp->nranges; i++){
+	    r = lp->ranges + i;
+	    start = offset > r->offset ? offset : r->offset;
+	    end = offset + size < r->offset + r->size ? offset + size :
+		  r->offset + r->size;
+	    if(start < end &&
+	       pwrite_zeros(fd, end - start, lp->new_offset + r->new_offset +
+			    (start - r->offset)) == -1)
+		return(-1);
+	}
+	return(0);
+}
+
+/*
+ * pwrite_all writes the size bytes at buf to fd at offset.  It returns -1 with
+ * errno set if they can't be written.
+ */
+static
+int
+pwrite_all(
+int fd,
+const char *buf,
+uint64_t size,
+uint64_t offset)
+{
+    ssize_t n;
+
+	while(size != 0){
+	    n = pwrite(fd, buf, size > SSIZE_MAX ? SSIZE_MAX : size, offset);
+	    if(n == -1 && errno == EINTR)
+		continue;
+	    if(n <= 0){
+		if(n == 0)
+		    errno = EIO;
+		return(-1);
+	    }
+	    buf += n;
+	    size -= n;
+	    offset += n;
+	}
+	return(0);
+}
+
+/*
+ * pwrite_zeros zeros the size bytes at offset in fd.  Where the file system
+ * can, the blocks are punched out of the file instead of written, which also
+ * keeps the blocks around them shared with the input file.  It returns -1 with
+ * errno set if they can't be zeroed.
+ */
+static
+int
+pwrite_zeros(
+int fd,
+uint64_t size,
+uint64_t offset)
+{
+    uint64_t n;
+
+	if(size == 0 ||
+	   fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset,
+		     size) == 0)
+	    return(0);
+	while(size != 0){
+	    n = size > sizeof(zeros) ? sizeof(zeros) : size;
+	    if(pwrite_all(fd, zeros, n, offset) == -1)
+		return(-1);
+	    size -= n;
+	    offset += n;
+	}
+	return(0);
+}
+
+/*
+ * get_word and put_word load and store a field of a segment or section header
+ * that is 64 bits wide in 64-bit objects and 32 bits wide otherwise.
+ */
+static
+uint64_t
+get_word(
+const char *p,
+int is64,
+int swapped)
+{
+	return(is64 ? get_uint64(p, swapped) : get_uint32(p, swapped));
+}
+
+static
+void
+put_word(
+char *p,
+uint64_t v,
+int is64,
+int swapped)
+{
+	if(is64)
+	    put_uint64(p, v, swapped);
+	else
+	    put_uint32(p, v, swapped);
+}
@@ -0,0 +1,57 @@
+/*
+ * Writing an edited copy of an input file for -replace, -remove and
+ * -remove-segment.
+ */
+#ifndef _EDIT_H_
+#define _EDIT_H_
+
+#include <stdint.h>
+#include "ofile.h"
+
+/*
+ * structure for holding -replace's arguments.  The file with the new contents
+ * is mapped once the arguments are read.
+ */
+struct replace {
+    char *segname;		/* segment name */
+    char *sectname;		/* section name */
+    char *filename;		/* file with the new section contents */
+    char *contents;		/* its mapped contents, NULL if empty */
+    uint64_t size;		/* its size */
+    int found;			/* set once the section is found in an object */
+    struct replace *next;	/* next replace structure, NULL if last */
+};
+extern struct replace *replaces; /* first replace structure, NULL if none */
+
+/*
+ * structure for holding the arguments of -remove and -remove-segment.
+ */
+struct remove {
+    char *segname;		/* segment name */
+    char *sectname;		/* section name, NULL to remove the segment */
+    int found;			/* set once it is found in an object */
+    struct remove *next;	/* next remove structure, NULL if last */
+};
+extern struct remove *removes; /* first remove structure, NULL if none */
+
+extern char *output_name;	/* -output, where the copy is written */
+
+/*
+ * map_replacement() maps the file with the new contents of the section of the
+ * -replace option.
+ */
+extern void map_replacement(
+    struct replace *rp);
+
+/*
+ * edit_input() writes the input file with the sections of the -replace options
+ * replaced and those of the -remove options removed to the -output file.  Each
+ * object selected by the -arch flags, or every object if there were no -arch
+ * flags, is edited, and the other objects of a fat file are copied as they
+ * are.  It returns -1 if an object could not be edited or the output file
+ * can't be written.
+ */
+extern int edit_input(
+    struct ofile *ofile);
+
+#endif /* _EDIT_H_ */
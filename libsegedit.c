@@ -0,0 +1,1175 @@
+/*
+ * Copyright (c) 1999 Apple Computer, Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ * 
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ * 
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ * 
+ * @APPLE_LICENSE_HEADER_END@
+ */
+/*
+ * libsegedit, the library segedit(1) reads the sections of Mach-O files with,
+ * see segedit.h.  The routines were moved here from segedit.c.
+ *
+ * Adapted from Apple sources for easier compilation on Linux.
+ * (c)2015 wvengen <dev-generic@willem.engen.nl>
+ */
+#define _FILE_OFFSET_BITS 64
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "segedit.h"
+#include "bytesex.h"
+#include "arch.h"
+
+/*
+ * The symbols of an object in the other byte sex are swapped this many at a
+ * time into a buffer, with swap_nlist() or swap_nlist_64(), and walked there.
+ */
+#define SYMBOLS_SWAPPED	1024
+
+/*
+ * The format of the files in the cache directory of segedit_use_cache(), one
+ * for each input file, which are mapped and used as they are.  A cache_header
+ * is followed by a cache_object for each object in the input file and then by
+ * the cache_sections of all of them, all in the host byte sex.
+ */
+#define CACHE_MAGIC	"segedit"	/* with the null, 8 bytes */
+#define CACHE_VERSION	2		/* reads differently in the other byte
+					   sex, so caches are not shared by
+					   hosts with different ones */
+struct cache_header {
+    char magic[8];		/* CACHE_MAGIC */
+    uint32_t version;		/* CACHE_VERSION */
+    uint32_t nobjects;		/* number of cache_objects */
+    uint32_t nsects;		/* number of cache_sections */
+    uint32_t reserved;
+    uint64_t file_size;		/* the input file's size and modification */
+    int64_t file_mtime;		/*  time when it was cached */
+    int64_t file_mtime_nsec;
+};
+
+struct cache_object {
+    uint64_t offset;		/* offset of the object in the input file */
+    uint64_t size;		/* size of the object */
+    uint64_t uuid_offset;	/* offset of the uuid of its LC_UUID command in
+				   the input file, 0 if it has none */
+    uint8_t uuid[16];		/* the uuid */
+    struct mach_header_64 mh;	/* the mach header in the host byte sex, the
+				   fields of a mach_header are the same */
+    uint32_t is_64;		/* 1 if the object is 64-bit */
+    uint32_t swapped;		/* 1 if its headers are swapped */
+    uint32_t first_sect;	/* index of its first cache_section */
+    uint32_t nsects;		/* number of its cache_sections */
+};
+
+struct cache_section {
+    char sectname[16];		/* as in the section header */
+    char segname[16];
+    uint32_t flags;
+    uint32_t reserved;
+    uint64_t addr;
+    uint64_t offset;		/* offset of the contents in the object */
+    uint64_t size;
+};
+
+/* the section tables as they are built by build_cache() */
+struct cache_build {
+    struct cache_section *sects;
+    uint32_t nsects;
+    uint32_t maxsects;
+};
+
+static enum segedit_error set_error(
+    struct segedit_file *sf,
+    enum segedit_error error,
+    const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+static const char *object_name(
+    struct segedit_file *sf);
+static enum segedit_error check_load_commands(
+    struct segedit_file *sf,
+    uint32_t mh_sizeofcmds,
+    const int swapped);
+static int walk_sections(
+    struct segedit_file *sf,
+    segedit_section_func func,
+    void *arg,
+    const int swapped);
+static enum segedit_error walk_symbols(
+    struct segedit_file *sf,
+    segedit_symbol_func func,
+    void *arg,
+    const char *symbols,
+    uint32_t first,
+    uint32_t nsyms,
+    const char *strings,
+    uint32_t strsize,
+    int *stopped);
+static char *cache_filename(
+    struct segedit_file *sf,
+    const char *dir);
+static int load_cache(
+    struct segedit_file *sf,
+    const char *filename);
+static int check_cache(
+    struct segedit_file *sf,
+    const char *cache,
+    uint64_t size);
+static int build_cache(
+    struct segedit_file *sf);
+static int add_cache_section(
+    void *arg,
+    const struct segedit_section *section);
+static uint64_t find_uuid(
+    struct segedit_file *sf);
+static enum segedit_error write_cache(
+    struct segedit_file *sf,
+    const char *filename);
+static enum segedit_error map_cached_object(
+    struct segedit_file *sf,
+    uint32_t i);
+static int walk_cached_sections(
+    struct segedit_file *sf,
+    segedit_section_func func,
+    void *arg);
+static inline const char *section_contents(
+    struct segedit_file *sf,
+    const struct segedit_section *s);
+
+void
+segedit_init(
+struct segedit_file *sf,
+char *file_name)
+{
+	memset(sf, '\0', sizeof(struct segedit_file));
+	sf->file_name = file_name;
+	sf->file_fd = -1;
+}
+
+enum segedit_error
+segedit_open(
+struct segedit_file *sf)
+{
+    int fd;
+
+	if((fd = open(sf->file_name, O_RDONLY)) == -1){
+	    sf->sys_errno = errno;
+	    return(set_error(sf, SEGEDIT_ESYS, "can't open input file: %s",
+			     sf->file_name));
+	}
+	return(segedit_map_fd(sf, fd));
+}
+
+enum segedit_error
+segedit_map_fd(
+struct segedit_file *sf,
+int fd)
+{
+    uint32_t i, magic, nfat_arch;
+    uint64_t size;
+    struct stat stat_buf;
+    void *addr;
+    enum segedit_error error;
+
+	sf->file_fd = fd;
+	if(fstat(fd, &stat_buf) == -1){
+	    sf->sys_errno = errno;
+	    return(set_error(sf, SEGEDIT_ESYS, "Can't stat input file: %s",
+			     sf->file_name));
+	}
+	sf->file_mode = stat_buf.st_mode;
+	sf->file_blksize = stat_buf.st_blksize;
+	sf->file_mtime = stat_buf.st_mtim.tv_sec;
+	sf->file_mtime_nsec = stat_buf.st_mtim.tv_nsec;
+	sf->file_dev = stat_buf.st_dev;
+	sf->file_ino = stat_buf.st_ino;
+	if(!S_ISREG(stat_buf.st_mode))
+	    return(set_error(sf, SEGEDIT_ENOTREG, "input file: %s is not a "
+			     "regular file", sf->file_name));
+	sf->file_size = stat_buf.st_size;
+	if(sizeof(uint32_t) > sf->file_size)
+	    return(set_error(sf, SEGEDIT_EMALFORMED, "truncated or malformed "
+			     "object (mach header would extend past the end of "
+			     "the file) in: %s", sf->file_name));
+	if(sf->file_size > SIZE_MAX)
+	    return(set_error(sf, SEGEDIT_ENOMEM, "input file: %s too large to "
+			     "be mapped", sf->file_name));
+	addr = mmap(0, sf->file_size, PROT_READ, MAP_FILE|MAP_PRIVATE, fd, 0);
+	if(addr == MAP_FAILED){
+	    sf->sys_errno = errno;
+	    return(set_error(sf, SEGEDIT_ESYS, "Can't map input file: %s",
+			     sf->file_name));
+	}
+	sf->file_addr = addr;
+
+	memcpy(&magic, sf->file_addr, sizeof(uint32_t));
+	sf->fat_archs = NULL;
+	if(magic != FAT_MAGIC && magic != FAT_CIGAM &&
+	   magic != FAT_MAGIC_64 && magic != FAT_CIGAM_64)
+	    return(SEGEDIT_OK);
+
+	/* The fat headers are always big-endian, copy and swap them */
+	if(sizeof(struct fat_header) > sf->file_size)
+	    return(set_error(sf, SEGEDIT_EMALFORMED, "truncated or malformed "
+			     "fat file (fat header would extend past the end "
+			     "of the file) in: %s", sf->file_name));
+	memcpy(&sf->fat_header, sf->file_addr, sizeof(struct fat_header));
+	if(HOST_BYTE_SEX != BIG_ENDIAN_BYTE_SEX)
+	    swap_fat_header(&sf->fat_header, HOST_BYTE_SEX);
+	nfat_arch = sf->fat_header.nfat_arch;
+	if(nfat_arch == 0)
+	    return(set_error(sf, SEGEDIT_EMALFORMED, "fat file contains no "
+			     "architectures in: %s", sf->file_name));
+	size = sf->fat_header.magic == FAT_MAGIC_64 ?
+	       sizeof(struct fat_arch_64) : sizeof(struct fat_arch);
+	if(sizeof(struct fat_header) + nfat_arch * size > sf->file_size)
+	    return(set_error(sf, SEGEDIT_EMALFORMED, "truncated or malformed "
+			     "fat file (fat_arch structs would extend past the "
+			     "end of the file) in: %s", sf->file_name));
+	error = segedit_set_fat_archs(sf, sf->file_addr +
+					  sizeof(struct fat_header));
+	if(error != SEGEDIT_OK)
+	    return(error);
+	for(i = 0; i < nfat_arch; i++){
+	    if(sf->fat_archs[i].offset > sf->file_size ||
+	       sf->fat_archs[i].size >
+	       sf->file_size - sf->fat_archs[i].offset)
+		return(set_error(sf, SEGEDIT_EMALFORMED, "truncated or "
+			"malformed fat file (offset plus size of cputype (%d) "
+			"cpusubtype (%d) extends past the end of the file) in: "
+			"%s", sf->fat_archs[i].cputype,
+			sf->fat_archs[i].cpusubtype & ~CPU_SUBTYPE_MASK,
+			sf->file_name));
+	}
+	return(SEGEDIT_OK);
+}
+
+enum segedit_error
+segedit_set_fat_archs(
+struct segedit_file *sf,
+const char *addr)
+{
+    uint32_t i, nfat_arch;
+    struct fat_arch fat_arch;
+
+	nfat_arch = sf->fat_header.nfat_arch;
+	free(sf->fat_archs);
+	sf->fat_archs = malloc(nfat_arch * sizeof(struct fat_arch_64));
+	if(sf->fat_archs == NULL)
+	    return(set_error(sf, SEGEDIT_ENOMEM, "virtual memory exhausted "
+			     "(malloc failed)"));
+	if(sf->fat_header.magic == FAT_MAGIC_64){
+	    memcpy(sf->fat_archs, addr, nfat_arch * sizeof(struct fat_arch_64));
+	    if(HOST_BYTE_SEX != BIG_ENDIAN_BYTE_SEX)
+		swap_fat_arch_64(sf->fat_archs, nfat_arch, HOST_BYTE_SEX);
+	    return(SEGEDIT_OK);
+	}
+	for(i = 0; i < nfat_arch; i++){
+	    memcpy(&fat_arch, addr + i * sizeof(struct fat_arch),
+		   sizeof(struct fat_arch));
+	    if(HOST_BYTE_SEX != BIG_ENDIAN_BYTE_SEX)
+		swap_fat_arch(&fat_arch, 1, HOST_BYTE_SEX);
+	    sf->fat_archs[i].cputype = fat_arch.cputype;
+	    sf->fat_archs[i].cpusubtype = fat_arch.cpusubtype;
+	    sf->fat_archs[i].offset = fat_arch.offset;
+	    sf->fat_archs[i].size = fat_arch.size;
+	    sf->fat_archs[i].align = fat_arch.align;
+	    sf->fat_archs[i].reserved = 0;
+	}
+	return(SEGEDIT_OK);
+}
+
+/*
+ * The mach header is copied into mh or mh64 and swapped if needed, but the
+ * load commands are left in place in the object's byte sex.
+ */
+enum segedit_error
+segedit_map_object(
+struct segedit_file *sf,
+char *addr,
+uint64_t size)
+{
+    uint32_t magic, mh_sizeofcmds;
+
+	sf->object_addr = addr;
+	sf->object_size = size;
+	sf->mhp = NULL;
+	sf->mhp64 = NULL;
+	sf->mh_ncmds = 0;
+	sf->warning[0] = '\0';
+	sf->cache_object = NULL;
+
+	if(sizeof(uint32_t) > sf->object_size)
+	    return(set_error(sf, SEGEDIT_EMALFORMED, "truncated or malformed "
+			     "object (mach header would extend past the end of "
+			     "the file) in: %s", object_name(sf)));
+	memcpy(&magic, sf->object_addr, sizeof(uint32_t));
+
+	if(magic == SWAP_INT(MH_MAGIC) || magic == MH_MAGIC){
+	    if(sizeof(struct mach_header) > sf->object_size)
+		return(set_error(sf, SEGEDIT_EMALFORMED, "truncated or "
+				 "malformed object (mach header would extend "
+				 "past the end of the file) in: %s",
+				 object_name(sf)));
+	    memcpy(&sf->mh, sf->object_addr, sizeof(struct mach_header));
+	    sf->mhp = &sf->mh;
+	    sf->swapped = magic == SWAP_INT(MH_MAGIC);
+	    if(sf->swapped)
+		swap_mach_header(sf->mhp, HOST_BYTE_SEX);
+	    if(sf->mhp->sizeofcmds >
+	       sf->object_size - sizeof(struct mach_header))
+		return(set_error(sf, SEGEDIT_EMALFORMED, "truncated or "
+				 "malformed object (load commands would extend "
+				 "past the end of the file) in: %s",
+				 object_name(sf)));
+	    sf->load_commands = (struct load_command *)
+		(sf->object_addr + sizeof(struct mach_header));
+	    sf->mh_ncmds = sf->mhp->ncmds;
+	    sf->arch_name = format_arch_name(sf->mhp->cputype,
+		sf->mhp->cpusubtype, sf->arch_name_buf,
+		sizeof(sf->arch_name_buf));
+	    mh_sizeofcmds = sf->mhp->sizeofcmds;
+	}
+	else if(magic == SWAP_INT(MH_MAGIC_64) || magic == MH_MAGIC_64){
+	    if(sizeof(struct mach_header_64) > sf->object_size)
+		return(set_error(sf, SEGEDIT_EMALFORMED, "truncated or "
+				 "malformed object (mach header would extend "
+				 "past the end of the file) in: %s",
+				 object_name(sf)));
+	    memcpy(&sf->mh64, sf->object_addr, sizeof(struct mach_header_64));
+	    sf->mhp64 = &sf->mh64;
+	    sf->swapped = magic == SWAP_INT(MH_MAGIC_64);
+	    if(sf->swapped)
+		swap_mach_header_64(sf->mhp64, HOST_BYTE_SEX);
+	    if(sf->mhp64->sizeofcmds >
+	       sf->object_size - sizeof(struct mach_header_64))
+		return(set_error(sf, SEGEDIT_EMALFORMED, "truncated or "
+				 "malformed object (load commands would extend "
+				 "past the end of the file) in: %s",
+				 object_name(sf)));
+	    sf->load_commands = (struct load_command *)
+		(sf->object_addr + sizeof(struct mach_header_64));
+	    sf->mh_ncmds = sf->mhp64->ncmds;
+	    sf->arch_name = format_arch_name(sf->mhp64->cputype,
+		sf->mhp64->cpusubtype, sf->arch_name_buf,
+		sizeof(sf->arch_name_buf));
+	    mh_sizeofcmds = sf->mhp64->sizeofcmds;
+	}
+	else
+	    return(set_error(sf, SEGEDIT_EMAGIC, "bad magic number (file is "
+			     "not a Mach-O file) in: %s", object_name(sf)));
+
+	/* the swapped and not swapped checks are each compiled on their own */
+	if(sf->swapped)
+	    return(check_load_commands(sf, mh_sizeofcmds, 1));
+	return(check_load_commands(sf, mh_sizeofcmds, 0));
+}
+
+/*
+ * check_load_commands checks that the load commands of the object stay within
+ * sizeofcmds, and that the sections of the segment commands stay within
+ * theirs.  Only the fields needed to check them are swapped, the sections are
+ * swapped when they are used.  It is inlined into segedit_map_object() for
+ * each value of swapped, so objects in the host byte sex are checked with
+ * plain loads.
+ */
+static inline __attribute__((always_inline))
+enum segedit_error
+check_load_commands(
+struct segedit_file *sf,
+uint32_t mh_sizeofcmds,
+const int swapped)
+{
+    uint32_t i, cmd, cmdsize, nsects;
+    char *lcp, *end;
+
+	lcp = (char *)sf->load_commands;
+	end = lcp + mh_sizeofcmds;
+	for(i = 0; i < sf->mh_ncmds; i++){
+	    if(lcp + sizeof(struct load_command) > end)
+		return(set_error(sf, SEGEDIT_EMALFORMED, "load command %u "
+				 "extends past end of all load commands in: %s",
+				 i, object_name(sf)));
+	    cmd = get_uint32(lcp + offsetof(struct load_command, cmd), swapped);
+	    cmdsize = get_uint32(lcp + offsetof(struct load_command, cmdsize),
+				 swapped);
+	    if(cmdsize % sizeof(uint32_t) != 0)
+		snprintf(sf->warning, sizeof(sf->warning), "load command %u "
+			 "size not a multiple of sizeof(uint32_t) in: %s", i,
+			 object_name(sf));
+	    if(cmdsize <= 0)
+		return(set_error(sf, SEGEDIT_EMALFORMED, "load command %u size "
+				 "is less than or equal to zero in: %s", i,
+				 object_name(sf)));
+	    if(cmdsize > (uint64_t)(end - lcp))
+		return(set_error(sf, SEGEDIT_EMALFORMED, "load command %u "
+				 "extends past end of all load commands in: %s",
+				 i, object_name(sf)));
+	    switch(cmd){
+	    case LC_SEGMENT:
+		if(cmdsize < sizeof(struct segment_command))
+		    return(set_error(sf, SEGEDIT_EMALFORMED, "cmdsize too "
+				     "small for LC_SEGMENT command %u in: %s",
+				     i, object_name(sf)));
+		nsects = get_uint32(lcp + offsetof(struct segment_command,
+						   nsects), swapped);
+		if(sizeof(struct segment_command) +
+		   (uint64_t)nsects * sizeof(struct section) > cmdsize)
+		    return(set_error(sf, SEGEDIT_EMALFORMED, "inconsistent "
+				     "cmdsize in LC_SEGMENT command %u for the "
+				     "number of sections in: %s", i,
+				     object_name(sf)));
+		break;
+	    case LC_SEGMENT_64:
+		if(cmdsize < sizeof(struct segment_command_64))
+		    return(set_error(sf, SEGEDIT_EMALFORMED, "cmdsize too "
+				     "small for LC_SEGMENT_64 command %u in: "
+				     "%s", i, object_name(sf)));
+		nsects = get_uint32(lcp + offsetof(struct segment_command_64,
+						   nsects), swapped);
+		if(sizeof(struct segment_command_64) +
+		   (uint64_t)nsects * sizeof(struct section_64) > cmdsize)
+		    return(set_error(sf, SEGEDIT_EMALFORMED, "inconsistent "
+				     "cmdsize in LC_SEGMENT_64 command %u for "
+				     "the number of sections in: %s", i,
+				     object_name(sf)));
+		break;
+	    }
+	    lcp += cmdsize;
+	}
+	return(SEGEDIT_OK);
+}
+
+enum segedit_error
+segedit_map_arch(
+struct segedit_file *sf,
+uint32_t i)
+{
+	if(sf->cache != NULL)
+	    return(map_cached_object(sf, i));
+	if(sf->fat_archs == NULL)
+	    return(segedit_map_object(sf, sf->file_addr, sf->file_size));
+	return(segedit_map_object(sf, sf->file_addr + sf->fat_archs[i].offset,
+				  sf->fat_archs[i].size));
+}
+
+uint32_t
+segedit_narchs(
+struct segedit_file *sf)
+{
+	return(sf->fat_archs == NULL ? 1 : sf->fat_header.nfat_arch);
+}
+
+int
+segedit_sections(
+struct segedit_file *sf,
+segedit_section_func func,
+void *arg)
+{
+	if(sf->cache_object != NULL)
+	    return(walk_cached_sections(sf, func, arg));
+	if(sf->swapped)
+	    return(walk_sections(sf, func, arg, 1));
+	return(walk_sections(sf, func, arg, 0));
+}
+
+/*
+ * walk_sections walks the load commands of the object, which were checked by
+ * segedit_map_object(), and calls func for each section.  It is inlined into
+ * segedit_sections() for each value of swapped, so objects in the host byte
+ * sex are walked with plain loads.
+ */
+static inline __attribute__((always_inline))
+int
+walk_sections(
+struct segedit_file *sf,
+segedit_section_func func,
+void *arg,
+const int swapped)
+{
+    uint32_t i, j, cmd, nsects, offset, section_size;
+    int result;
+    char *lcp, *sp;
+    struct segedit_section s;
+
+	lcp = (char *)sf->load_commands;
+	for(i = 0; i < sf->mh_ncmds; i++){
+	    cmd = get_uint32(lcp + offsetof(struct load_command, cmd), swapped);
+	    if(cmd == LC_SEGMENT){
+		nsects = get_uint32(lcp + offsetof(struct segment_command,
+						   nsects), swapped);
+		sp = lcp + sizeof(struct segment_command);
+		section_size = sizeof(struct section);
+	    }
+	    else if(cmd == LC_SEGMENT_64){
+		nsects = get_uint32(lcp + offsetof(struct segment_command_64,
+						   nsects), swapped);
+		sp = lcp + sizeof(struct segment_command_64);
+		section_size = sizeof(struct section_64);
+	    }
+	    else
+		nsects = 0;
+	    for(j = 0; j < nsects; j++){
+		/* sectname and segname are at the start of both structs */
+		memcpy(s.sectname, sp, 16);
+		s.sectname[16] = '\0';
+		memcpy(s.segname, sp + 16, 16);
+		s.segname[16] = '\0';
+		if(cmd == LC_SEGMENT){
+		    s.flags = get_uint32(sp + offsetof(struct section, flags),
+					 swapped);
+		    s.addr = get_uint32(sp + offsetof(struct section, addr),
+					swapped);
+		    offset = get_uint32(sp + offsetof(struct section, offset),
+					swapped);
+		    s.size = get_uint32(sp + offsetof(struct section, size),
+					swapped);
+		}
+		else{
+		    s.flags = get_uint32(sp + offsetof(struct section_64,
+						       flags), swapped);
+		    s.addr = get_uint64(sp + offsetof(struct section_64, addr),
+					swapped);
+		    offset = get_uint32(sp + offsetof(struct section_64,
+						      offset), swapped);
+		    s.size = get_uint64(sp + offsetof(struct section_64, size),
+					swapped);
+		}
+		s.offset = offset;
+		s.contents = section_contents(sf, &s);
+		s.header = sp;
+		if((result = func(arg, &s)) != 0)
+		    return(result);
+		sp += section_size;
+	    }
+	    lcp += get_uint32(lcp + offsetof(struct load_command, cmdsize),
+			      swapped);
+	}
+	return(0);
+}
+
+enum segedit_error
+segedit_symbols(
+struct segedit_file *sf,
+segedit_symbol_func func,
+void *arg)
+{
+    uint32_t i, cmd, cmdsize, symoff, nsyms, stroff, strsize, nlistsize;
+    uint32_t first, n;
+    int stopped;
+    char *lcp, *buf;
+    enum segedit_error status;
+
+	lcp = (char *)sf->load_commands;
+	for(i = 0; i < sf->mh_ncmds; i++){
+	    cmd = get_uint32(lcp + offsetof(struct load_command, cmd),
+			     sf->swapped);
+	    cmdsize = get_uint32(lcp + offsetof(struct load_command, cmdsize),
+				 sf->swapped);
+	    if(cmd == LC_SYMTAB)
+		break;
+	    lcp += cmdsize;
+	}
+	if(i == sf->mh_ncmds)
+	    return(SEGEDIT_OK);
+	if(cmdsize < sizeof(struct symtab_command))
+	    return(set_error(sf, SEGEDIT_EMALFORMED, "cmdsize too small for "
+			     "LC_SYMTAB command %u in: %s", i,
+			     object_name(sf)));
+	if(sf->file_addr == NULL)
+	    return(set_error(sf, SEGEDIT_ENOTREG, "symbol table of: %s is not "
+			     "mapped", object_name(sf)));
+	symoff = get_uint32(lcp + offsetof(struct symtab_command, symoff),
+			    sf->swapped);
+	nsyms = get_uint32(lcp + offsetof(struct symtab_command, nsyms),
+			   sf->swapped);
+	stroff = get_uint32(lcp + offsetof(struct symtab_command, stroff),
+			    sf->swapped);
+	strsize = get_uint32(lcp + offsetof(struct symtab_command, strsize),
+			     sf->swapped);
+	nlistsize = sf->mhp64 != NULL ? sizeof(struct nlist_64) :
+					sizeof(struct nlist);
+	if(symoff > sf->object_size ||
+	   (uint64_t)nsyms * nlistsize > sf->object_size - symoff)
+	    return(set_error(sf, SEGEDIT_EMALFORMED, "truncated or malformed "
+			     "object (symbol table extends past the end of the "
+			     "file) in: %s", object_name(sf)));
+	if(stroff > sf->object_size || strsize > sf->object_size - stroff)
+	    return(set_error(sf, SEGEDIT_EMALFORMED, "truncated or malformed "
+			     "object (string table extends past the end of the "
+			     "file) in: %s", object_name(sf)));
+	/* a name must end before the end of the string table */
+	while(strsize != 0 && sf->object_addr[stroff + strsize - 1] != '\0')
+	    strsize--;
+	if(sf->swapped == 0)
+	    return(walk_symbols(sf, func, arg, sf->object_addr + symoff, 0,
+				nsyms, sf->object_addr + stroff, strsize,
+				&stopped));
+
+	if((buf = malloc(SYMBOLS_SWAPPED * nlistsize)) == NULL)
+	    return(set_error(sf, SEGEDIT_ENOMEM, "virtual memory exhausted "
+			     "(malloc failed)"));
+	status = SEGEDIT_OK;
+	stopped = 0;
+	for(first = 0; first < nsyms && status == SEGEDIT_OK && !stopped;
+	    first += n){
+	    n = nsyms - first < SYMBOLS_SWAPPED ? nsyms - first :
+						  SYMBOLS_SWAPPED;
+	    memcpy(buf, sf->object_addr + symoff + (uint64_t)first * nlistsize,
+		   n * nlistsize);
+	    if(sf->mhp64 != NULL)
+		swap_nlist_64((struct nlist_64 *)buf, n, HOST_BYTE_SEX);
+	    else
+		swap_nlist((struct nlist *)buf, n, HOST_BYTE_SEX);
+	    status = walk_symbols(sf, func, arg, buf, first, n,
+				  sf->object_addr + stroff, strsize, &stopped);
+	}
+	free(buf);
+	return(status);
+}
+
+/*
+ * walk_symbols calls func for each of the nsyms symbol table entries at
+ * symbols, in the host byte sex, whose names are in the strsize bytes of
+ * strings, which end with a null.  first is the index of the first of them in
+ * the symbol table, for messages.  stopped is set if func stopped the walk.
+ */
+static
+enum segedit_error
+walk_symbols(
+struct segedit_file *sf,
+segedit_symbol_func func,
+void *arg,
+const char *symbols,
+uint32_t first,
+uint32_t nsyms,
+const char *strings,
+uint32_t strsize,
+int *stopped)
+{
+    uint32_t i, strx;
+    const char *np;
+    struct segedit_symbol symbol;
+
+	*stopped = 0;
+	np = symbols;
+	for(i = 0; i < nsyms; i++){
+	    /* the fields of an nlist_64 are where they are in an nlist but for
+	       n_value, which is 64-bit */
+	    strx = get_uint32(np + offsetof(struct nlist, n_un.n_strx), 0);
+	    if(strx >= strsize && (strx != 0 || strsize != 0))
+		return(set_error(sf, SEGEDIT_EMALFORMED, "bad string table "
+				 "index (%u) for symbol %u in: %s", strx,
+				 first + i, object_name(sf)));
+	    symbol.name = strsize != 0 ? strings + strx : "";
+	    symbol.type = *(const uint8_t *)(np + offsetof(struct nlist,
+							  n_type));
+	    symbol.sect = *(const uint8_t *)(np + offsetof(struct nlist,
+							  n_sect));
+	    symbol.desc = get_uint16(np + offsetof(struct nlist, n_desc), 0);
+	    if(sf->mhp64 != NULL){
+		symbol.value = get_uint64(np + offsetof(struct nlist_64,
+							n_value), 0);
+		np += sizeof(struct nlist_64);
+	    }
+	    else{
+		symbol.value = get_uint32(np + offsetof(struct nlist, n_value),
+					  0);
+		np += sizeof(struct nlist);
+	    }
+	    if(func(arg, &symbol) != 0){
+		*stopped = 1;
+		break;
+	    }
+	}
+	return(SEGEDIT_OK);
+}
+
+enum segedit_error
+segedit_use_cache(
+struct segedit_file *sf,
+const char *dir)
+{
+    char *filename;
+    enum segedit_error status;
+
+	if(sf->file_addr == NULL)
+	    return(set_error(sf, SEGEDIT_ENOTREG, "input file: %s is not "
+			     "mapped (can't be cached)", sf->file_name));
+	if((filename = cache_filename(sf, dir)) == NULL)
+	    return(set_error(sf, SEGEDIT_ENOMEM, "virtual memory exhausted "
+			     "(malloc failed)"));
+	status = SEGEDIT_OK;
+	if(load_cache(sf, filename) == -1 && build_cache(sf) == 0)
+	    status = write_cache(sf, filename);
+	free(filename);
+	return(status);
+}
+
+/*
+ * cache_filename returns the allocated name of the input file's cache file in
+ * the cache directory, which is made of its device and inode number.
+ */
+static
+char *
+cache_filename(
+struct segedit_file *sf,
+const char *dir)
+{
+    char *filename;
+
+	if((filename = malloc(strlen(dir) + 2 * 16 + 3)) == NULL)
+	    return(NULL);
+	sprintf(filename, "%s/%llx-%llx", dir,
+		(unsigned long long)sf->file_dev,
+		(unsigned long long)sf->file_ino);
+	return(filename);
+}
+
+/*
+ * load_cache maps the cache file and uses it if it is the one of the input
+ * file as it is now.  It returns -1 if it can't.
+ */
+static
+int
+load_cache(
+struct segedit_file *sf,
+const char *filename)
+{
+    int fd;
+    struct stat stat_buf;
+    void *addr;
+
+	if((fd = open(filename, O_RDONLY)) == -1)
+	    return(-1);
+	if(fstat(fd, &stat_buf) == -1 ||
+	   stat_buf.st_size < (off_t)sizeof(struct cache_header)){
+	    close(fd);
+	    return(-1);
+	}
+	addr = mmap(0, stat_buf.st_size, PROT_READ, MAP_FILE|MAP_PRIVATE, fd,
+		    0);
+	close(fd);
+	if(addr == MAP_FAILED)
+	    return(-1);
+	if(check_cache(sf, addr, stat_buf.st_size) == -1){
+	    munmap(addr, stat_buf.st_size);
+	    return(-1);
+	}
+	sf->cache = addr;
+	sf->cache_size = stat_buf.st_size;
+	sf->cache_mapped = 1;
+	return(0);
+}
+
+/*
+ * check_cache checks that the size bytes of the cache at cache are the
+ * section tables of the input file as it is now: it has the same size,
+ * modification time and objects, which have the same uuids, as when they were
+ * cached.  It returns -1 if not.
+ */
+static
+int
+check_cache(
+struct segedit_file *sf,
+const char *cache,
+uint64_t size)
+{
+    uint32_t i;
+    const struct cache_header *header;
+    const struct cache_object *objects, *co;
+
+	header = (const struct cache_header *)cache;
+	if(memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) != 0 ||
+	   header->version != CACHE_VERSION ||
+	   header->file_size != sf->file_size ||
+	   header->file_mtime != sf->file_mtime ||
+	   header->file_mtime_nsec != sf->file_mtime_nsec ||
+	   header->nobjects != segedit_narchs(sf) ||
+	   sizeof(struct cache_header) +
+	   (uint64_t)header->nobjects * sizeof(struct cache_object) +
+	   (uint64_t)header->nsects * sizeof(struct cache_section) != size)
+	    return(-1);
+	objects = (const struct cache_object *)(header + 1);
+	for(i = 0; i < header->nobjects; i++){
+	    co = objects + i;
+	    if(sf->fat_archs != NULL ?
+	       (co->offset != sf->fat_archs[i].offset ||
+		co->size != sf->fat_archs[i].size) :
+	       (co->offset != 0 || co->size != sf->file_size))
+		return(-1);
+	    if(co->first_sect > header->nsects ||
+	       co->nsects > header->nsects - co->first_sect)
+		return(-1);
+	    if(co->uuid_offset != 0 &&
+	       (co->uuid_offset > sf->file_size - sizeof(co->uuid) ||
+		memcmp(sf->file_addr + co->uuid_offset, co->uuid,
+		       sizeof(co->uuid)) != 0))
+		return(-1);
+	}
+	return(0);
+}
+
+/*
+ * build_cache parses each object of the input file and builds its section
+ * tables, which are then used.  It returns -1 if any of the objects is
+ * malformed or memory can't be allocated.
+ */
+static
+int
+build_cache(
+struct segedit_file *sf)
+{
+    uint32_t i, nobjects;
+    uint64_t size;
+    char *cache;
+    struct cache_header *header;
+    struct cache_object *objects, *co;
+    struct cache_build cb;
+
+	nobjects = segedit_narchs(sf);
+	if((objects = calloc(nobjects, sizeof(struct cache_object))) == NULL)
+	    return(-1);
+	memset(&cb, '\0', sizeof(struct cache_build));
+	for(i = 0; i < nobjects; i++){
+	    if(segedit_map_arch(sf, i) != SEGEDIT_OK)
+		goto fail;
+	    co = objects + i;
+	    co->offset = sf->object_addr - sf->file_addr;
+	    co->size = sf->object_size;
+	    co->uuid_offset = find_uuid(sf);
+	    if(co->uuid_offset != 0)
+		memcpy(co->uuid, sf->file_addr + co->uuid_offset,
+		       sizeof(co->uuid));
+	    if(sf->mhp64 != NULL){
+		memcpy(&co->mh, sf->mhp64, sizeof(struct mach_header_64));
+		co->is_64 = 1;
+	    }
+	    else
+		memcpy(&co->mh, sf->mhp, sizeof(struct mach_header));
+	    co->swapped = sf->swapped;
+	    co->first_sect = cb.nsects;
+	    if(segedit_sections(sf, add_cache_section, &cb) != 0)
+		goto fail;
+	    co->nsects = cb.nsects - co->first_sect;
+	}
+
+	size = sizeof(struct cache_header) +
+	       nobjects * sizeof(struct cache_object) +
+	       (uint64_t)cb.nsects * sizeof(struct cache_section);
+	if((cache = calloc(1, size)) == NULL)
+	    goto fail;
+	header = (struct cache_header *)cache;
+	memcpy(header->magic, CACHE_MAGIC, sizeof(header->magic));
+	header->version = CACHE_VERSION;
+	header->nobjects = nobjects;
+	header->nsects = cb.nsects;
+	header->file_size = sf->file_size;
+	header->file_mtime = sf->file_mtime;
+	header->file_mtime_nsec = sf->file_mtime_nsec;
+	memcpy(header + 1, objects, nobjects * sizeof(struct cache_object));
+	memcpy(cache + sizeof(struct cache_header) +
+	       nobjects * sizeof(struct cache_object), cb.sects,
+	       cb.nsects * sizeof(struct cache_section));
+	free(objects);
+	free(cb.sects);
+	sf->cache = cache;
+	sf->cache_size = size;
+	sf->cache_mapped = 0;
+	return(0);
+
+fail:
+	free(objects);
+	free(cb.sects);
+	return(-1);
+}
+
+/*
+ * add_cache_section is called by segedit_sections() for each section of the
+ * object to add it to the section tables being built.  It returns 1 to stop
+ * the walk if memory can't be allocated.
+ */
+static
+int
+add_cache_section(
+void *arg,
+const struct segedit_section *section)
+{
+    struct cache_build *cb;
+    struct cache_section *cs;
+
+	cb = arg;
+	if(cb->nsects == cb->maxsects){
+	    cb->maxsects = cb->maxsects == 0 ? 64 : cb->maxsects * 2;
+	    cs = realloc(cb->sects,
+			 cb->maxsects * sizeof(struct cache_section));
+	    if(cs == NULL)
+		return(1);
+	    cb->sects = cs;
+	}
+	cs = cb->sects + cb->nsects++;
+	memset(cs, '\0', sizeof(struct cache_section));
+	strncpy(cs->sectname, section->sectname, sizeof(cs->sectname));
+	strncpy(cs->segname, section->segname, sizeof(cs->segname));
+	cs->flags = section->flags;
+	cs->addr = section->addr;
+	cs->offset = section->offset;
+	cs->size = section->size;
+	return(0);
+}
+
+/*
+ * find_uuid returns the offset in the input file of the uuid of the object's
+ * LC_UUID command, or 0 if it has none.
+ */
+static
+uint64_t
+find_uuid(
+struct segedit_file *sf)
+{
+    uint32_t i, cmd, cmdsize;
+    char *lcp;
+
+	lcp = (char *)sf->load_commands;
+	for(i = 0; i < sf->mh_ncmds; i++){
+	    cmd = get_uint32(lcp + offsetof(struct load_command, cmd),
+			     sf->swapped);
+	    cmdsize = get_uint32(lcp + offsetof(struct load_command, cmdsize),
+				 sf->swapped);
+	    if(cmd == LC_UUID && cmdsize >= sizeof(struct uuid_command))
+		return(lcp + offsetof(struct uuid_command, uuid) -
+		       sf->file_addr);
+	    lcp += cmdsize;
+	}
+	return(0);
+}
+
+/*
+ * write_cache writes the section tables to the cache file.  They are written
+ * to a temporary file that is then renamed, so that a cache file is always
+ * complete, even when several processes write it at once.
+ */
+static
+enum segedit_error
+write_cache(
+struct segedit_file *sf,
+const char *filename)
+{
+    int fd;
+    char *tmp, *p;
+    uint64_t size;
+    ssize_t n;
+
+	if((tmp = malloc(strlen(filename) + sizeof(".XXXXXX"))) == NULL)
+	    return(set_error(sf, SEGEDIT_ENOMEM, "virtual memory exhausted "
+			     "(malloc failed)"));
+	sprintf(tmp, "%s.XXXXXX", filename);
+	if((fd = mkstemp(tmp)) == -1){
+	    sf->sys_errno = errno;
+	    set_error(sf, SEGEDIT_ESYS, "can't create cache file: %s", tmp);
+	    free(tmp);
+	    return(SEGEDIT_ESYS);
+	}
+	p = sf->cache;
+	size = sf->cache_size;
+	while(size != 0){
+	    n = write(fd, p, size > SSIZE_MAX ? SSIZE_MAX : size);
+	    if(n == -1 && errno == EINTR)
+		continue;
+	    if(n <= 0)
+		break;
+	    p += n;
+	    size -= n;
+	}
+	if(size != 0 || fchmod(fd, 0644) == -1 || close(fd) == -1 ||
+	   rename(tmp, filename) == -1){
+	    sf->sys_errno = size != 0 && n == 0 ? ENOSPC : errno;
+	    set_error(sf, SEGEDIT_ESYS, "can't write cache file: %s", tmp);
+	    if(size != 0)
+		close(fd);
+	    unlink(tmp);
+	    free(tmp);
+	    return(SEGEDIT_ESYS);
+	}
+	free(tmp);
+	return(SEGEDIT_OK);
+}
+
+/*
+ * map_cached_object sets the object fields for the i'th object from the
+ * section tables, the way segedit_map_object() would after parsing it.
+ */
+static
+enum segedit_error
+map_cached_object(
+struct segedit_file *sf,
+uint32_t i)
+{
+    const struct cache_header *header;
+    const struct cache_object *co;
+
+	header = (const struct cache_header *)sf->cache;
+	co = (const struct cache_object *)(header + 1) + i;
+	sf->object_addr = sf->file_addr + co->offset;
+	sf->object_size = co->size;
+	sf->warning[0] = '\0';
+	sf->swapped = co->swapped;
+	if(co->is_64){
+	    memcpy(&sf->mh64, &co->mh, sizeof(struct mach_header_64));
+	    sf->mhp64 = &sf->mh64;
+	    sf->mhp = NULL;
+	    sf->load_commands = (struct load_command *)
+		(sf->object_addr + sizeof(struct mach_header_64));
+	    sf->mh_ncmds = sf->mh64.ncmds;
+	    sf->arch_name = format_arch_name(sf->mh64.cputype,
+		sf->mh64.cpusubtype, sf->arch_name_buf,
+		sizeof(sf->arch_name_buf));
+	}
+	else{
+	    memcpy(&sf->mh, &co->mh, sizeof(struct mach_header));
+	    sf->mhp = &sf->mh;
+	    sf->mhp64 = NULL;
+	    sf->load_commands = (struct load_command *)
+		(sf->object_addr + sizeof(struct mach_header));
+	    sf->mh_ncmds = sf->mh.ncmds;
+	    sf->arch_name = format_arch_name(sf->mh.cputype,
+		sf->mh.cpusubtype, sf->arch_name_buf,
+		sizeof(sf->arch_name_buf));
+	}
+	sf->cache_object = co;
+	return(SEGEDIT_OK);
+}
+
+/*
+ * walk_cached_sections calls func for each section of the cached object, like
+ * walk_sections() does for a parsed one.
+ */
+static
+int
+walk_cached_sections(
+struct segedit_file *sf,
+segedit_section_func func,
+void *arg)
+{
+    uint32_t j;
+    int result;
+    const struct cache_header *header;
+    const struct cache_object *co;
+    const struct cache_section *cs;
+    struct segedit_section s;
+
+	header = (const struct cache_header *)sf->cache;
+	co = sf->cache_object;
+	cs = (const struct cache_section *)((const struct cache_object *)
+		(header + 1) + header->nobjects) + co->first_sect;
+	for(j = 0; j < co->nsects; j++, cs++){
+	    memcpy(s.sectname, cs->sectname, 16);
+	    s.sectname[16] = '\0';
+	    memcpy(s.segname, cs->segname, 16);
+	    s.segname[16] = '\0';
+	    s.flags = cs->flags;
+	    s.addr = cs->addr;
+	    s.offset = cs->offset;
+	    s.size = cs->size;
+	    s.contents = section_contents(sf, &s);
+	    s.header = NULL;
+	    if((result = func(arg, &s)) != 0)
+		return(result);
+	}
+	return(0);
+}
+
+void
+segedit_close(
+struct segedit_file *sf)
+{
+	if(sf->file_addr != NULL)
+	    munmap(sf->file_addr, sf->file_size);
+	if(sf->file_fd != -1)
+	    close(sf->file_fd);
+	free(sf->fat_archs);
+	if(sf->cache != NULL && sf->cache_mapped)
+	    munmap(sf->cache, sf->cache_size);
+	else
+	    free(sf->cache);
+	sf->file_addr = NULL;
+	sf->file_fd = -1;
+	sf->fat_archs = NULL;
+	sf->cache = NULL;
+	sf->cache_object = NULL;
+}
+
+/*
+ * section_contents returns the address of the section's contents in the mapped
+ * input file, or NULL if it has none there.
+ */
+static inline
+const char *
+section_contents(
+struct segedit_file *sf,
+const struct segedit_section *s)
+{
+	if(sf->file_addr == NULL ||
+	   (s->flags & SECTION_TYPE) == S_ZEROFILL ||
+	   (s->flags & SECTION_TYPE) == S_GB_ZEROFILL ||
+	   (s->flags & SECTION_TYPE) == S_THREAD_LOCAL_ZEROFILL ||
+	   s->offset > sf->object_size ||
+	   s->size > sf->object_size - s->offset)
+	    return(NULL);
+	return(sf->object_addr + s->offset);
+}
+
+/*
+ * set_error sets the error and its message, and returns the error.
+ */
+static
+enum segedit_error
+set_error(
+struct segedit_file *sf,
+enum segedit_error error,
+const char *format, ...)
+{
+    va_list ap;
+
+	va_start(ap, format);
+	vsnprintf(sf->message, sizeof(sf->message), format, ap);
+	va_end(ap);
+	sf->error = error;
+	return(error);
+}
+
+/*
+ * object_name returns the name of the object for messages.
+ */
+static
+const char *
+object_name(
+struct segedit_file *sf)
+{
+	return(sf->object_name != NULL ? sf->object_name : sf->file_name);
+}
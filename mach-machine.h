@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2000-2007 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ * 
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ * 
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ * 
+ * @APPLE_LICENSE_HEADER_END@
+ */
+/*
+ * Adapted from Apple sources for segedit compilation on Linux.
+ * Only the cpu type and subtype constants are kept.
+ */
+#ifndef _MACH_MACHINE_H_
+#define _MACH_MACHINE_H_
+
+typedef int	cpu_type_t;
+typedef int	cpu_subtype_t;
+
+/*
+ * Capability bits used in the definition of cpu_type.
+ */
+#define	CPU_ARCH_MASK		0xff000000	/* mask for architecture bits */
+#define CPU_ARCH_ABI64		0x01000000	/* 64 bit ABI */
+#define CPU_ARCH_ABI64_32	0x02000000	/* ABI for 64-bit hardware with
+						   32-bit types; LP32 */
+
+/*
+ *	Machine types known by all.
+ */
+#define CPU_TYPE_ANY		((cpu_type_t) -1)
+
+#define CPU_TYPE_VAX		((cpu_type_t) 1)
+#define	CPU_TYPE_MC680x0	((cpu_type_t) 6)
+#define CPU_TYPE_X86		((cpu_type_t) 7)
+#define CPU_TYPE_I386		CPU_TYPE_X86		/* compatibility */
+#define	CPU_TYPE_X86_64		(CPU_TYPE_X86 | CPU_ARCH_ABI64)
+#define CPU_TYPE_MC98000	((cpu_type_t) 10)
+#define CPU_TYPE_HPPA		((cpu_type_t) 11)
+#define CPU_TYPE_ARM		((cpu_type_t) 12)
+#define CPU_TYPE_ARM64		(CPU_TYPE_ARM | CPU_ARCH_ABI64)
+#define CPU_TYPE_ARM64_32	(CPU_TYPE_ARM | CPU_ARCH_ABI64_32)
+#define CPU_TYPE_MC88000	((cpu_type_t) 13)
+#define CPU_TYPE_SPARC		((cpu_type_t) 14)
+#define CPU_TYPE_I860		((cpu_type_t) 15)
+#define CPU_TYPE_POWERPC	((cpu_type_t) 18)
+#define CPU_TYPE_POWERPC64	(CPU_TYPE_POWERPC | CPU_ARCH_ABI64)
+
+/*
+ * Capability bits used in the definition of cpu_subtype.
+ */
+#define CPU_SUBTYPE_MASK	0xff000000	/* mask for feature flags */
+#define CPU_SUBTYPE_LIB64	0x80000000	/* 64 bit libraries */
+
+/*
+ *	Machine subtypes (these are defined here, instead of in a machine
+ *	dependent directory, so that any program can get all definitions
+ *	regardless of where is it compiled).
+ */
+#define CPU_SUBTYPE_MULTIPLE		((cpu_subtype_t) -1)
+#define CPU_SUBTYPE_LITTLE_ENDIAN	((cpu_subtype_t) 0)
+#define CPU_SUBTYPE_BIG_ENDIAN		((cpu_subtype_t) 1)
+
+#define	CPU_SUBTYPE_MC680x0_ALL		((cpu_subtype_t) 1)
+#define CPU_SUBTYPE_MC68030		((cpu_subtype_t) 1)
+#define CPU_SUBTYPE_MC68040		((cpu_subtype_t) 2)
+#define	CPU_SUBTYPE_MC68030_ONLY	((cpu_subtype_t) 3)
+
+#define	CPU_SUBTYPE_I386_ALL		((cpu_subtype_t) 3)
+#define CPU_SUBTYPE_486			((cpu_subtype_t) 4)
+#define CPU_SUBTYPE_486SX		((cpu_subtype_t) 132)
+#define CPU_SUBTYPE_PENT		((cpu_subtype_t) 5)
+#define CPU_SUBTYPE_PENTPRO		((cpu_subtype_t) 22)
+#define CPU_SUBTYPE_PENTII_M3		((cpu_subtype_t) 54)
+#define CPU_SUBTYPE_PENTII_M5		((cpu_subtype_t) 86)
+#define CPU_SUBTYPE_PENTIUM_4		((cpu_subtype_t) 10)
+
+#define CPU_SUBTYPE_X86_ALL		((cpu_subtype_t) 3)
+#define CPU_SUBTYPE_X86_64_ALL		((cpu_subtype_t) 3)
+#define CPU_SUBTYPE_X86_64_H		((cpu_subtype_t) 8)
+
+#define	CPU_SUBTYPE_HPPA_ALL		((cpu_subtype_t) 0)
+#define CPU_SUBTYPE_HPPA_7100LC		((cpu_subtype_t) 1)
+
+#define	CPU_SUBTYPE_MC88000_ALL		((cpu_subtype_t) 0)
+#define	CPU_SUBTYPE_SPARC_ALL		((cpu_subtype_t) 0)
+#define CPU_SUBTYPE_I860_ALL		((cpu_subtype_t) 0)
+
+#define CPU_SUBTYPE_POWERPC_ALL		((cpu_subtype_t) 0)
+#define CPU_SUBTYPE_POWERPC_601		((cpu_subtype_t) 1)
+#define CPU_SUBTYPE_POWERPC_602		((cpu_subtype_t) 2)
+#define CPU_SUBTYPE_POWERPC_603		((cpu_subtype_t) 3)
+#define CPU_SUBTYPE_POWERPC_603e	((cpu_subtype_t) 4)
+#define CPU_SUBTYPE_POWERPC_603ev	((cpu_subtype_t) 5)
+#define CPU_SUBTYPE_POWERPC_604		((cpu_subtype_t) 6)
+#define CPU_SUBTYPE_POWERPC_604e	((cpu_subtype_t) 7)
+#define CPU_SUBTYPE_POWERPC_620		((cpu_subtype_t) 8)
+#define CPU_SUBTYPE_POWERPC_750		((cpu_subtype_t) 9)
+#define CPU_SUBTYPE_POWERPC_7400	((cpu_subtype_t) 10)
+#define CPU_SUBTYPE_POWERPC_7450	((cpu_subtype_t) 11)
+#define CPU_SUBTYPE_POWERPC_970		((cpu_subtype_t) 100)
+
+#define CPU_SUBTYPE_ARM_ALL		((cpu_subtype_t) 0)
+#define CPU_SUBTYPE_ARM_V4T		((cpu_subtype_t) 5)
+#define CPU_SUBTYPE_ARM_V6		((cpu_subtype_t) 6)
+#define CPU_SUBTYPE_ARM_V5TEJ		((cpu_subtype_t) 7)
+#define CPU_SUBTYPE_ARM_XSCALE		((cpu_subtype_t) 8)
+#define CPU_SUBTYPE_ARM_V7		((cpu_subtype_t) 9)
+#define CPU_SUBTYPE_ARM_V7F		((cpu_subtype_t) 10)
+#define CPU_SUBTYPE_ARM_V7S		((cpu_subtype_t) 11)
+#define CPU_SUBTYPE_ARM_V7K		((cpu_subtype_t) 12)
+#define CPU_SUBTYPE_ARM_V8		((cpu_subtype_t) 13)
+#define CPU_SUBTYPE_ARM_V6M		((cpu_subtype_t) 14)
+#define CPU_SUBTYPE_ARM_V7M		((cpu_subtype_t) 15)
+#define CPU_SUBTYPE_ARM_V7EM		((cpu_subtype_t) 16)
+
+#define CPU_SUBTYPE_ARM64_ALL		((cpu_subtype_t) 0)
+#define CPU_SUBTYPE_ARM64_V8		((cpu_subtype_t) 1)
+#define CPU_SUBTYPE_ARM64E		((cpu_subtype_t) 2)
+
+#define CPU_SUBTYPE_ARM64_32_ALL	((cpu_subtype_t) 0)
+
+#endif /* _MACH_MACHINE_H_ */
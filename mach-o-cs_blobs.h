@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2017 Apple Computer, Inc. All rights reserved.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. The rights granted to you under the License
+ * may not be used to create, or enable the creation or redistribution of,
+ * unlawful or unlicensed copies of an Apple operating system, or to
+ * circumvent, violate, or enable the circumvention or violation of, any
+ * terms of an Apple operating system software license agreement.
+ *
+ * Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_END@
+ */
+/*
+ * The structures of the code signature that LC_CODE_SIGNATURE points to,
+ * from <kern/cs_blobs.h>.  They are always big-endian, whatever the byte
+ * sex of the object.
+ *
+ * Adapted from Apple sources for segedit compilation on Linux.
+ */
+#ifndef _KERN_CODESIGN_H_
+#define _KERN_CODESIGN_H_
+
+#include <stdint.h>
+
+/*
+ * Magic numbers used by Code Signing
+ */
+enum {
+    CSMAGIC_REQUIREMENT = 0xfade0c00,		/* single Requirement blob */
+    CSMAGIC_REQUIREMENTS = 0xfade0c01,		/* Requirements vector (internal
+						   requirements) */
+    CSMAGIC_CODEDIRECTORY = 0xfade0c02,		/* CodeDirectory blob */
+    CSMAGIC_EMBEDDED_SIGNATURE = 0xfade0cc0,	/* embedded form of signature
+						   data */
+    CSMAGIC_EMBEDDED_SIGNATURE_OLD = 0xfade0b02, /* XXX */
+    CSMAGIC_EMBEDDED_ENTITLEMENTS = 0xfade7171,	/* embedded entitlements */
+    CSMAGIC_EMBEDDED_DER_ENTITLEMENTS = 0xfade7172, /* embedded DER encoded
+						   entitlements */
+    CSMAGIC_DETACHED_SIGNATURE = 0xfade0cc1,	/* multi-arch collection of
+						   embedded signatures */
+    CSMAGIC_BLOBWRAPPER = 0xfade0b01,		/* CMS Signature, among other
+						   things */
+
+    CS_SUPPORTSSCATTER = 0x20100,
+    CS_SUPPORTSTEAMID = 0x20200,
+    CS_SUPPORTSCODELIMIT64 = 0x20300,
+    CS_SUPPORTSEXECSEG = 0x20400,
+    CS_SUPPORTSRUNTIME = 0x20500,
+    CS_SUPPORTSLINKAGE = 0x20600,
+
+    CSSLOT_CODEDIRECTORY = 0,			/* slot index for
+						   CodeDirectory */
+    CSSLOT_INFOSLOT = 1,
+    CSSLOT_REQUIREMENTS = 2,
+    CSSLOT_RESOURCEDIR = 3,
+    CSSLOT_APPLICATION = 4,
+    CSSLOT_ENTITLEMENTS = 5,
+    CSSLOT_DER_ENTITLEMENTS = 7,
+
+    CSSLOT_ALTERNATE_CODEDIRECTORIES = 0x1000,	/* first alternate
+						   CodeDirectory, if any */
+    CSSLOT_ALTERNATE_CODEDIRECTORY_MAX = 5,	/* max number of alternate CD
+						   slots */
+    CSSLOT_ALTERNATE_CODEDIRECTORY_LIMIT =	/* one past the last */
+	CSSLOT_ALTERNATE_CODEDIRECTORIES + CSSLOT_ALTERNATE_CODEDIRECTORY_MAX,
+
+    CSSLOT_SIGNATURESLOT = 0x10000,		/* CMS Signature */
+
+    CS_HASHTYPE_SHA1 = 1,
+    CS_HASHTYPE_SHA256 = 2,
+    CS_HASHTYPE_SHA256_TRUNCATED = 3,
+    CS_HASHTYPE_SHA384 = 4,
+
+    CS_SHA1_LEN = 20,
+    CS_SHA256_LEN = 32,
+    CS_SHA256_TRUNCATED_LEN = 20,
+
+    CS_CDHASH_LEN = 20,				/* always - larger hashes are
+						   truncated */
+    CS_HASH_MAX_SIZE = 48,			/* max size of the hash we'll
+						   support */
+};
+
+/*
+ * Structure of an embedded-signature SuperBlob
+ */
+
+typedef struct __BlobIndex {
+    uint32_t type;		/* type of entry */
+    uint32_t offset;		/* offset of entry */
+} CS_BlobIndex;
+
+typedef struct __SC_SuperBlob {
+    uint32_t magic;		/* magic number */
+    uint32_t length;		/* total length of SuperBlob */
+    uint32_t count;		/* number of index entries following */
+    CS_BlobIndex index[];	/* (count) entries */
+    /* followed by Blobs in no particular order as indicated by offsets in
+       index */
+} CS_SuperBlob;
+
+/*
+ * C form of a CodeDirectory.
+ */
+typedef struct __CodeDirectory {
+    uint32_t magic;		/* magic number (CSMAGIC_CODEDIRECTORY) */
+    uint32_t length;		/* total length of CodeDirectory blob */
+    uint32_t version;		/* compatibility version */
+    uint32_t flags;		/* setup and mode flags */
+    uint32_t hashOffset;	/* offset of hash slot element at index zero */
+    uint32_t identOffset;	/* offset of identifier string */
+    uint32_t nSpecialSlots;	/* number of special hash slots */
+    uint32_t nCodeSlots;	/* number of ordinary (code) hash slots */
+    uint32_t codeLimit;		/* limit to main image signature range */
+    uint8_t hashSize;		/* size of each hash in bytes */
+    uint8_t hashType;		/* type of hash (cdHashType* constants) */
+    uint8_t platform;		/* platform identifier; zero if not platform
+				   binary */
+    uint8_t pageSize;		/* log2(page size in bytes); 0 => infinite */
+    uint32_t spare2;		/* unused (must be zero) */
+
+    /* Version 0x20100 */
+    uint32_t scatterOffset;	/* offset of optional scatter vector */
+
+    /* Version 0x20200 */
+    uint32_t teamOffset;	/* offset of optional team identifier */
+
+    /* Version 0x20300 */
+    uint32_t spare3;		/* unused (must be zero) */
+    uint64_t codeLimit64;	/* limit to main image signature range, 64
+				   bits */
+
+    /* Version 0x20400 */
+    uint64_t execSegBase;	/* offset of executable segment */
+    uint64_t execSegLimit;	/* limit of executable segment */
+    uint64_t execSegFlags;	/* executable segment flags */
+
+    /* followed by dynamic content as located by offset fields above */
+} __attribute__((packed)) CS_CodeDirectory;
+
+/*
+ * Sample code used to describe a generic blob
+ */
+typedef struct __SC_GenericBlob {
+    uint32_t magic;		/* magic number */
+    uint32_t length;		/* total length of blob */
+    char data[];
+} CS_GenericBlob;
+
+#endif /* _KERN_CODESIGN_H_ */
@@ -0,0 +1,194 @@
+/*
+ * The state of an input file being operated on by segedit, and the routines
+ * of segedit.c that the files of its other parts use.
+ */
+#ifndef _OFILE_H_
+#define _OFILE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "segedit.h"
+#include "arch.h"
+#include "workqueue.h"
+
+#define error(...) { \
+  flockfile(stderr); \
+  fprintf(stderr, __VA_ARGS__); \
+  fprintf(stderr, "\n"); \
+  funlockfile(stderr); \
+}
+#define fatal(...) { \
+  error(__VA_ARGS__); \
+  exit(1); \
+}
+
+/*
+ * The phases of operating on an input file that are timed for -stats.  The
+ * byte swapping is done as the headers are read, so it is part of the parse
+ * and walk phases.
+ */
+enum phase {
+    PHASE_MAP,			/* opening and mapping the input file */
+    PHASE_PARSE,		/* checking the headers and load commands */
+    PHASE_WALK,			/* walking and matching the sections */
+    PHASE_READ,			/* reading an input file read as a stream */
+    PHASE_CREATE,		/* creating and closing output files, and
+				   writing tar entry headers */
+    PHASE_COPY,			/* copying section contents to them */
+    PHASE_HASH,			/* hashing section contents for -store and
+				   -hash, and pages for -verify-signature */
+    PHASE_UNMAP,		/* unmapping and closing the input file */
+    NPHASES
+};
+
+/* the time spent in a phase, and the number of calls and bytes */
+struct phase_stats {
+    uint64_t time;		/* in nanoseconds */
+    uint64_t calls;
+    uint64_t bytes;
+};
+
+/*
+ * The state of one input file being operated on.  Each input file has its own
+ * so that several can be operated on at the same time by different threads.
+ */
+struct ofile {
+    struct segedit_file sf;	/* the mapped input file and the object in it
+				   operated on, see segedit.h */
+    const char *arch_suffix;	/* suffix for output file names, NULL if only
+				   one object is operated on */
+    char arch_suffix_buf[ARCH_NAME_SIZE + 12]; /* the arch_suffix of a slice
+				   whose architecture another slice has too */
+
+    /* These fields are set in the routine extract_sections() */
+    char *found;		/* found flags indexed by the extract's index */
+    uint32_t nfound;		/* number of found flags set */
+    int extract_result;		/* -1 if a section could not be extracted */
+
+    /* These fields are used when the input file is read as a stream */
+    char streaming;		/* 1 if the input file can't be mapped */
+    char stream_eof;		/* 1 once the end of the input file is read */
+    char stream_splice;		/* 0 once splice(2) turns out not to work */
+    uint64_t stream_pos;	/* position in the input file */
+    char *stream_buf;		/* buffer of STREAM_BUFSIZE bytes */
+    struct stream_range *ranges;/* the section contents to copy, recorded */
+    uint32_t nranges;		/*  by extract_section() */
+    uint32_t maxranges;		/* number of ranges allocated */
+
+    /* These fields are used for -hash of a mapped input file */
+    struct section_hash *hashes;/* the sections of the object being hashed */
+    struct section_hash **hashes_tail; /* where to link the next one */
+    struct work_group hash_group;/* the work hashing them */
+
+    /* These fields are used for -decompress of a mapped input file */
+    struct inflate_job *inflates;/* the sections of the object being
+				   inflated */
+    struct inflate_job **inflates_tail; /* where to link the next one */
+    struct work_group inflate_group; /* the work inflating them */
+
+    /* These fields are used for -stats, and added to the totals at the end */
+    struct phase_stats stats[NPHASES];
+    uint32_t nobjects;		/* number of objects operated on */
+    uint32_t nswapped;		/* number of those that were swapped */
+    uint32_t ncached;		/* number of those found in the cache */
+    uint32_t nstored;		/* number of sections written to the store */
+    uint32_t nlinked;		/*  and of those already in it */
+};
+
+/* the workqueue the input files are operated on by */
+extern struct workqueue *wq;
+
+/* set when the phases are timed, for -stats and -trace */
+extern int timing;
+
+/*
+ * select_fat_archs() sets the selected flag of each object of a fat file that
+ * the -arch flags select and returns their number, set_object_name() names the
+ * i'th object, map_arch() maps it and check_arch_flags() checks the object of
+ * a thin file against the -arch flags.  They return -1 and print an error if
+ * they fail.
+ */
+extern int select_fat_archs(
+    struct ofile *ofile,
+    char *selected);
+extern void set_object_name(
+    struct ofile *ofile,
+    uint32_t i,
+    uint32_t nselected);
+extern int map_arch(
+    struct ofile *ofile,
+    uint32_t i);
+extern int check_arch_flags(
+    struct ofile *ofile);
+
+/*
+ * use_cache() looks the section tables of the mapped input file up in the
+ * -cache-dir directory, if there is one.
+ */
+extern void use_cache(
+    struct ofile *ofile);
+
+/*
+ * print_error() prints the error that a segedit_*() routine left in
+ * ofile->sf.
+ */
+extern void print_error(
+    struct ofile *ofile);
+
+/*
+ * phase_begin() returns the time a phase starts, and phase_end() adds the
+ * time since then to the statistics of the input file.
+ */
+extern uint64_t phase_begin(void);
+extern void phase_end(
+    struct ofile *ofile,
+    enum phase phase,
+    uint64_t start,
+    uint64_t bytes);
+
+/*
+ * copy_section() writes size bytes at offset in the object to fd at its
+ * current position, without copying them through user space when that can
+ * be avoided.  It returns -1 with errno set if they can't be written.
+ */
+extern int copy_section(
+    struct ofile *ofile,
+    int fd,
+    uint64_t offset,
+    uint64_t size);
+
+/*
+ * copy_input() is copy_section() for size bytes at offset in the input file.
+ */
+extern int copy_input(
+    struct ofile *ofile,
+    int fd,
+    uint64_t offset,
+    uint64_t size);
+
+/*
+ * create_output() creates the output file, and make_dirs() the directories
+ * a file is in, if they don't exist yet.  They return -1 with errno set if
+ * they can't.
+ */
+extern int create_output(
+    char *filename);
+extern int make_dirs(
+    char *filename);
+
+/*
+ * is_zerofill() returns 1 if the section flags are those of a section without
+ * contents in the file.
+ */
+extern int is_zerofill(
+    uint32_t flags);
+
+/* allocate() and reallocate() exit with an error if memory runs out */
+extern void *allocate(
+    size_t size);
+extern void *reallocate(
+    void *p,
+    size_t size);
+
+#endif /* _OFILE_H_ */
@@ -22,77 +22,481 @@
  */
 /*
  * The segedit(1) program. This program extracts sections from an object
- * file, and takes the following options:
+ * file, or replaces or removes them, and takes the following options:
  *   -extract <segname> <sectname> <filename>
+ *   -extract-regex <segname> <sectname> <filename>
+ *   -extract-all <filename>
+ *   -extract-symbol <name> <filename>
+ *   -symbolicate
+ *   -verify-signature
+ *   -arch <arch_type>
+ *   -files-from <file>
+ *   -files0-from <file>
+ *   -j <jobs>
+ *   -tar <file>
+ *   -bundle-dir <dir>
+ *   -cache-dir <dir>
+ *   -store <dir>
+ *   -hash <file>
+ *   -compress <gz|zst>
+ *   -decompress
+ *   -replace <segname> <sectname> <filename>
+ *   -remove <segname> <sectname>
+ *   -remove-segment <segname>
+ *   -output <filename>
+ *   -stats
+ *   -trace <file>
+ * An input file named "-" is the standard input, which like any input file
+ * that is not a regular file is read as a stream.
  *
  * Adapted from Apple sources for easier compilation on Linux.
  * (c)2015 wvengen <dev-generic@willem.engen.nl>
  */
+#define _GNU_SOURCE	/* for copy_file_range() */
+#define _FILE_OFFSET_BITS 64
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <limits.h>
 #include <unistd.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <regex.h>
 #include <sys/file.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
-#include <asm/byteorder.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <fcntl.h>
+#include <linux/fs.h>
 
-#include "mach-o-loader.h"
-#include "mach-o-fat.h"
+#include "ofile.h"
 #include "bytesex.h"
-
-#define error(...) { \
-  fprintf(stderr, __VA_ARGS__); \
-  fprintf(stderr, "\n"); \
-}
-#define fatal(...) { \
-  error(__VA_ARGS__); \
-  exit(1); \
-}
+#include "arch.h"
+#include "workqueue.h"
+#include "tar.h"
+#include "trace.h"
+#include "sha256.h"
+#include "xxhash.h"
+#include "compress.h"
+#include "store.h"
+#include "edit.h"
+#include "symbols.h"
+#include "verify.h"
 
 /* These variables are set from the command line arguments */
 char *progname = NULL;	/* name of the program for error messages (argv[0]) */
 
-static char *input;	/* object file to extract/replace sections from */
+static char **inputs;	/* object files to extract/replace sections from */
+static uint32_t ninputs;
+
+/* the -arch flags, if none are specified all architectures are operated on */
+static struct arch_flag *arch_flags;
+static uint32_t narch_flags;
+
+/* the -bundle-dir directories, searched for kext bundles to operate on */
+static char **bundle_dirs;
+static uint32_t nbundle_dirs;
+
+static uint32_t njobs;	/* number of input files operated on at once */
+
+/*
+ * With -tar all sections are written to one tar archive instead of to their
+ * own files.  The lock is held while an entry is written.
+ */
+static char *tar_name;	/* name of the tar archive, "-" for the standard
+			   output, NULL if none */
+static int tar_fd = -1;	/* the open tar archive */
+static pthread_mutex_t tar_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * With -cache-dir the section tables of the input files are kept in this
+ * directory with segedit_use_cache(), so that they are not parsed again.  It
+ * is created if it doesn't exist.
+ */
+static char *cache_dir;
+
+/*
+ * With -hash no sections are written, but their SHA-256 and XXH64 digests are
+ * written to a manifest, a line for each section.  The lock is held while a
+ * line is written.  Sections of at least HASH_SPLIT bytes have the two
+ * digests computed at the same time by different threads.
+ */
+static char *hash_name;	/* name of the manifest, "-" for the standard
+			   output, NULL if none */
+static FILE *hash_file;	/* the open manifest */
+static pthread_mutex_t hash_lock = PTHREAD_MUTEX_INITIALIZER;
+#define HASH_SPLIT (1024 * 1024)
+
+/*
+ * With -compress the output files are compressed as they are written, and
+ * the format's suffix is appended to their names.
+ */
+static enum compress_format compress_format = COMPRESS_NONE;
+
+/*
+ * With -decompress sections with compressed contents, recognized by their
+ * header, are inflated to their output files.  The sections of a mapped
+ * object are inflated by work items, so that several are inflated at once.
+ */
+static int decompress;
+
+/*
+ * Set with -tar and -hash, where a section makes one entry however many
+ * extract structures it is for.
+ */
+static int single_entry;
 
-/* structure for holding -extract's arguments */
+/*
+ * With more than one input file the output file names contain "%i", the base
+ * name of the input file, so input files with the same base name in different
+ * directories would write the same output files.  Each input file claims its
+ * base name in the input_names hash table before it is operated on, and those
+ * whose base name is already claimed are not operated on.
+ */
+static int claim_names;
+struct input_name {
+    char *name;			/* the input file that claimed it */
+    const char *base;		/* its base name, in name */
+    struct input_name *next;	/* next in the hash chain */
+};
+static struct input_name **input_names;
+static uint32_t input_names_mask;	/* number of hash chains - 1 */
+static uint32_t ninput_names;
+static pthread_mutex_t input_names_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * The 16 byte section name followed by the 16 byte segment name, as they are
+ * in a section header but with everything after a terminating null zeroed, so
+ * that names can be compared as four 64-bit words.
+ */
+struct section_key {
+    uint64_t words[4];
+};
+
+/*
+ * structure for holding -extract's arguments.  The names are either exact or
+ * patterns, which are compiled once when the arguments are read.  For
+ * -extract-symbol the names are NULL, and the symbol is looked up instead.
+ */
 struct extract {
     char *segname;		/* segment name */
     char *sectname;		/* section name */
-    char *filename;		/* file to put the section contents in */
-    int32_t found;		/* set when the section is found */
+    char *symbol;		/* symbol name, NULL to extract a section */
+    char *filename;		/* file to put the section contents in, a
+				   template for the names of the sections */
+    uint32_t index;		/* index of the found flag in the ofile */
+    int match;			/* how the names are matched, see below */
+    regex_t segname_regex;	/* the compiled names for MATCH_REGEX */
+    regex_t sectname_regex;
+    struct section_key key;	/* the section and segment name */
+    struct extract *same;	/* next extract structure with the same key */
     struct extract *next;	/* next extract structure, NULL if last */
 } *extracts;			/* first extract structure, NULL if none */
+static uint32_t nextracts;	/* number of extract structures */
+static uint32_t nsymbols;	/* number of those for -extract-symbol */
+
+#define MATCH_EXACT	0	/* the names are the section's names */
+#define MATCH_GLOB	1	/* the names are shell patterns, fnmatch(3) */
+#define MATCH_REGEX	2	/* the names are extended regular expressions */
+
+static int editing;		/* set with -replace and -remove, which write
+				   an edited copy of the input file */
+
+/*
+ * The extract structures whose names are patterns.  Every section is matched
+ * against each of them, so the load commands are walked to the end.
+ */
+static struct extract **patterns;
+static uint32_t npatterns;
+
+/*
+ * The hash table of the extract structures keyed on their section and segment
+ * names.  It is built by hash_extracts() and only read after that.  Extract
+ * structures with the same names are chained off the first one with "same".
+ */
+static struct extract **extract_hash;
+static uint32_t extract_hash_mask;
+
+static int symbolicating;	/* set with -symbolicate */
+
+static int verify_signature;	/* set with -verify-signature */
+
+/* the most of a bundle's Info.plist that is searched for its executable */
+#define INFO_PLIST_MAXSIZE (1024 * 1024)
+
+/* size of the buffer input files that can't be mapped are read through */
+#define STREAM_BUFSIZE (1024 * 1024)
+
+/*
+ * The tar archive entries of sections read from a stream are gathered before
+ * they are written, so that tar_lock is only held while the archive is
+ * written and not while the input is read.  Entries of up to TAR_BUFFER_MAX
+ * bytes are gathered in memory, larger ones in a temporary file.
+ */
+#define TAR_BUFFER_MAX (16 * 1024 * 1024)
+
+/*
+ * The range of a section to be copied to an output file when the input file is
+ * read as a stream.  The offset is relative to the start of the object.
+ */
+struct stream_range {
+    uint64_t offset;		/* offset of the section contents */
+    uint64_t size;		/* size of the section contents */
+    struct extract *ep;		/* the extract structure of the output file */
+    char segname[17];		/* the section's segment name */
+    char sectname[17];		/* the section's name */
+    char *filename;		/* name of the output file, once it is open */
+    int fd;			/* the open output file, -1 if not open */
+    int failed;			/* set when the output file can't be written */
+    uint64_t start;		/* when the output file was opened, for
+				   -trace */
+    struct section_hash *hash;	/* the digests being computed for -hash */
+    struct compress_stream *cs;	/* the compressor of the output file for
+				   -compress */
+    struct decompress_stream *ds; /* the decompressor of the output file for
+				   -decompress */
+    int tar;			/* set if the section is a tar archive entry,
+				   gathered in tar_buf or else in the temporary
+				   file fd */
+    char *tar_buf;
+};
+
+/*
+ * A compressed section of a mapped object being inflated to its output file
+ * for -decompress.
+ */
+struct inflate_job {
+    struct ofile *ofile;	/* the input file */
+    char segname[17];		/* the section's segment name */
+    char sectname[17];		/* the section's name */
+    const char *data;		/* the mapped contents */
+    uint64_t size;		/* size of the contents */
+    int fd;			/* the open output file */
+    char *filename;		/* its name */
+    uint64_t start;		/* when it was created, for -trace */
+    uint64_t time;		/* time spent inflating, for -stats */
+    int result;			/* -1 if it could not be written */
+    struct inflate_job *next;	/* next section of the object */
+};
+
+/*
+ * The digests of a section being computed for -hash.
+ */
+struct section_hash {
+    char segname[17];		/* the section's segment name */
+    char sectname[17];		/* the section's name */
+    uint64_t offset;		/* offset of the contents in the input file */
+    uint64_t size;		/* size of the contents */
+    const char *contents;	/* the mapped contents, NULL if streamed */
+    struct sha256_ctx sha256;	/* the digests */
+    struct xxh64_ctx xxh64;
+    uint64_t time[2];		/* time spent computing each, for -stats */
+    struct section_hash *next;	/* next section of the object */
+};
+
+/* the names of the phases in the -stats output */
+static const char *phase_names[NPHASES] = {
+    "map", "parse", "walk", "read", "create", "copy", "hash", "unmap"
+};
+
+/*
+ * errors is set when an input file could not be operated on.  The worker
+ * threads set it with __atomic_store_n(), and main() reads it once they are
+ * done.
+ */
+static uint32_t errors;
+
+/*
+ * The workqueue the input files are operated on by, and the work group of the
+ * input files and of the directories searched for bundles.
+ */
+struct workqueue *wq;
+static struct work_group group;
+
+/* cleared when the kernel turns out not to have copy_file_range(2) */
+static int have_copy_file_range = 1;
 
-/* These variables are set in the routine map_input() */
-static void *input_addr;	/* address of where the input file is mapped */
-static uint32_t input_size;	/* size of the input file */
-static uint32_t input_mode;	/* mode of the input file */
-static struct mach_header *mhp;	/* pointer to the input file's mach header */
-static struct mach_header_64
-			*mhp64;	/* pointer to the input file's mach header for
-				   64-bit files */
-static uint32_t mh_ncmds;	/* number of load commands */
-static struct load_command
-		*load_commands;	/* pointer to the input file's load commands */
-static char swapped;	/* 1 if the input is to be swapped */
-static enum byte_sex host_byte_sex = UNKNOWN_BYTE_SEX;
-static enum byte_sex target_byte_sex = UNKNOWN_BYTE_SEX;
+/* the end of a tar archive, and padding for its entries */
+static const char zero_blocks[2 * TAR_BLOCKSIZE];
+
+/*
+ * Set by -stats and -trace.  The phases are only timed when either is given.
+ * The statistics of all the input files are added up in total_stats.
+ */
+static int stats;
+static char *trace_name;
+int timing;
+static struct phase_stats total_stats[NPHASES];
+static uint32_t total_files;
+static uint32_t total_objects;
+static uint32_t total_swapped;
+static uint32_t total_cached;
+static uint32_t total_stored;
+static uint32_t total_linked;
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
 
 /* Internal routines */
-static void map_input(
+static void make_section_key(
+    struct section_key *key,
+    const char *sectname,
+    const char *segname);
+static uint32_t hash_section_key(
+    const struct section_key *key);
+static int compile_regex(
+    regex_t *regex,
+    const char *pattern);
+static void hash_extracts(
     void);
-static void extract_sections(
+static struct extract *lookup_extract(
+    const struct section_key *key);
+static int match_extract(
+    struct extract *ep,
+    const char *segname,
+    const char *sectname);
+static void add_input(
+    char *name);
+static void read_file_list(
+    char *list,
+    char separator);
+static void scan_dir(
+    void *arg);
+static void scan_bundle(
+    char *path);
+static char *bundle_executable(
+    char *path,
+    char *info_plist);
+static void process_found_file(
+    void *arg);
+static char *make_path(
+    const char *dir,
+    const char *name);
+static void process_file(
+    void *arg);
+static int map_input(
+    struct ofile *ofile);
+static void unmap_input(
+    struct ofile *ofile);
+static int process_input(
+    struct ofile *ofile);
+static int process_object(
+    struct ofile *ofile);
+static int stream_input(
+    struct ofile *ofile);
+static int stream_object(
+    struct ofile *ofile,
+    uint32_t *magic,
+    uint64_t size);
+static int stream_sections(
+    struct ofile *ofile,
+    char *header,
+    uint64_t header_size);
+static void write_stream_entry(
+    struct ofile *ofile,
+    struct stream_range *rp);
+static int compare_stream_ranges(
+    const void *p1,
+    const void *p2);
+static int stream_read(
+    struct ofile *ofile,
+    char *buf,
+    uint64_t size);
+static int stream_skip(
+    struct ofile *ofile,
+    uint64_t size);
+static int map_object(
+    struct ofile *ofile,
+    char *addr,
+    uint64_t size);
+static int mapped_object(
+    struct ofile *ofile,
+    uint64_t start,
+    enum segedit_error status);
+static int extract_sections(
+    struct ofile *ofile);
+static int extract_matching(
+    void *arg,
+    const struct segedit_section *section);
+static int extract_section(
+    struct ofile *ofile,
+    struct extract *ep,
+    const struct segedit_section *section);
+static void extract_symbols(
+    struct ofile *ofile);
+static int write_all(
+    int fd,
+    const char *buf,
+    uint64_t size);
+static void tar_begin_entry(
+    struct ofile *ofile,
+    const char *segname,
+    const char *sectname,
+    uint64_t size);
+static void tar_end_entry(
+    uint64_t size);
+static void trace_section(
+    struct ofile *ofile,
+    const char *segname,
+    const char *sectname,
+    const char *filename,
+    uint64_t start,
+    uint64_t size);
+static void add_stats(
+    struct ofile *ofile);
+static void print_stats(
+    uint64_t elapsed);
+static int claim_input_name(
+    const char *file_name);
+static int template_has(
+    const char *template,
+    char c);
+static char *output_filename(
+    struct ofile *ofile,
+    struct extract *ep,
+    const char *segname,
+    const char *sectname);
+static void safe_name(
+    char *name,
+    const char *section_name);
+static int create_temporary(
     void);
-static void extract_section(
-    char *segname,
-    char *sectname,
-    uint32_t flags,
-    uint32_t offset,
-    uint32_t size);
-static void *allocate(
-    size_t size);
+static void add_hash(
+    struct ofile *ofile,
+    const struct segedit_section *section,
+    uint64_t offset,
+    uint64_t size);
+static struct section_hash *new_hash(
+    const char *segname,
+    const char *sectname,
+    uint64_t offset,
+    uint64_t size);
+static void hash_sha256(
+    void *arg);
+static void hash_xxh64(
+    void *arg);
+static void hash_contents(
+    void *arg);
+static void finish_hashes(
+    struct ofile *ofile);
+static void print_hash(
+    struct ofile *ofile,
+    struct section_hash *h);
+static void add_inflate(
+    struct ofile *ofile,
+    const struct segedit_section *section,
+    uint64_t offset,
+    uint64_t size,
+    int fd,
+    char *filename,
+    uint64_t start);
+static void inflate_section(
+    void *arg);
+static void finish_inflates(
+    struct ofile *ofile);
 static void usage(
     void);
 
@@ -103,319 +507,3020 @@ char *argv[],
 char *envp[])
 {
     int i;
+    uint32_t j;
+    char *endp, *p;
     struct extract *ep;
+    struct replace *rp;
+    struct remove *rm;
+    uint64_t start;
 
 	progname = argv[0];
-	host_byte_sex = get_host_byte_sex();
 
 	for (i = 1; i < argc; i++) {
-	    if(argv[i][0] == '-'){
+	    if(argv[i][0] == '-' && argv[i][1] != '\0'){
 		switch(argv[i][1]){
 		case 'e':
-		    if(i + 4 > argc){
-			error("missing arguments to %s option", argv[i]);
+		    if(strcmp(argv[i], "-extract-all") == 0){
+			if(i + 2 > argc){
+			    error("missing argument to %s option", argv[i]);
+			    usage();
+			}
+			ep = allocate(sizeof(struct extract));
+			ep->segname = "*";
+			ep->sectname = "*";
+			ep->symbol = NULL;
+			ep->filename = argv[i + 1];
+			ep->match = MATCH_GLOB;
+			i += 1;
+		    }
+		    else if(strcmp(argv[i], "-extract-symbol") == 0){
+			if(i + 3 > argc){
+			    error("missing arguments to %s option", argv[i]);
+			    usage();
+			}
+			ep = allocate(sizeof(struct extract));
+			ep->segname = NULL;
+			ep->sectname = NULL;
+			ep->symbol = argv[i + 1];
+			ep->filename = argv[i + 2];
+			ep->match = MATCH_EXACT;
+			nsymbols++;
+			i += 2;
+		    }
+		    else if(strcmp(argv[i], "-extract") == 0 ||
+			    strcmp(argv[i], "-extract-regex") == 0){
+			if(i + 4 > argc){
+			    error("missing arguments to %s option", argv[i]);
+			    usage();
+			}
+			ep = allocate(sizeof(struct extract));
+			ep->segname =  argv[i + 1];
+			ep->sectname = argv[i + 2];
+			ep->symbol = NULL;
+			ep->filename = argv[i + 3];
+			if(argv[i][8] == '-')
+			    ep->match = MATCH_REGEX;
+			else if(strpbrk(ep->segname, "*?[") != NULL ||
+				strpbrk(ep->sectname, "*?[") != NULL)
+			    ep->match = MATCH_GLOB;
+			else
+			    ep->match = MATCH_EXACT;
+			i += 3;
+		    }
+		    else{
+			error("unrecognized option: %s", argv[i]);
 			usage();
 		    }
-		    ep = allocate(sizeof(struct extract));
-		    ep->segname =  argv[i + 1];
-		    ep->sectname = argv[i + 2];
-		    ep->filename = argv[i + 3];
-		    ep->found = 0;
+		    if(ep->match == MATCH_REGEX &&
+		       (compile_regex(&ep->segname_regex, ep->segname) == -1 ||
+			compile_regex(&ep->sectname_regex, ep->sectname) == -1))
+			usage();
+		    ep->index = nextracts++;
 		    ep->next = extracts;
 		    extracts = ep;
+		    break;
+		case 'a':
+		    if(strcmp(argv[i], "-arch") != 0){
+			error("unrecognized option: %s", argv[i]);
+			usage();
+		    }
+		    if(i + 2 > argc){
+			error("missing argument to %s option", argv[i]);
+			usage();
+		    }
+		    arch_flags = reallocate(arch_flags,
+			(narch_flags + 1) * sizeof(struct arch_flag));
+		    if(get_arch_from_flag(argv[i + 1],
+					  arch_flags + narch_flags) == 0){
+			error("unknown architecture specification flag: "
+			      "%s %s", argv[i], argv[i + 1]);
+			usage();
+		    }
+		    narch_flags++;
+		    i += 1;
+		    break;
+		case 'f':
+		    if(strcmp(argv[i], "-files-from") != 0 &&
+		       strcmp(argv[i], "-files0-from") != 0){
+			error("unrecognized option: %s", argv[i]);
+			usage();
+		    }
+		    if(i + 2 > argc){
+			error("missing argument to %s option", argv[i]);
+			usage();
+		    }
+		    read_file_list(argv[i + 1],
+				   argv[i][6] == '0' ? '\0' : '\n');
+		    i += 1;
+		    break;
+		case 't':
+		    if(strcmp(argv[i], "-tar") != 0 &&
+		       strcmp(argv[i], "-trace") != 0){
+			error("unrecognized option: %s", argv[i]);
+			usage();
+		    }
+		    if(i + 2 > argc){
+			error("missing argument to %s option", argv[i]);
+			usage();
+		    }
+		    if((argv[i][2] == 'a' ? tar_name : trace_name) != NULL){
+			error("more than one %s option specified", argv[i]);
+			usage();
+		    }
+		    if(argv[i][2] == 'a')
+			tar_name = argv[i + 1];
+		    else
+			trace_name = argv[i + 1];
+		    i += 1;
+		    break;
+		case 's':
+		    if(strcmp(argv[i], "-stats") == 0){
+			stats = 1;
+			break;
+		    }
+		    if(strcmp(argv[i], "-symbolicate") == 0){
+			symbolicating = 1;
+			break;
+		    }
+		    if(strcmp(argv[i], "-store") != 0){
+			error("unrecognized option: %s", argv[i]);
+			usage();
+		    }
+		    if(i + 2 > argc){
+			error("missing argument to %s option", argv[i]);
+			usage();
+		    }
+		    store_dir = argv[i + 1];
+		    i += 1;
+		    break;
+		case 'h':
+		    if(strcmp(argv[i], "-hash") != 0){
+			error("unrecognized option: %s", argv[i]);
+			usage();
+		    }
+		    if(i + 2 > argc){
+			error("missing argument to %s option", argv[i]);
+			usage();
+		    }
+		    if(hash_name != NULL){
+			error("more than one %s option specified", argv[i]);
+			usage();
+		    }
+		    hash_name = argv[i + 1];
+		    i += 1;
+		    break;
+		case 'c':
+		    if(strcmp(argv[i], "-cache-dir") != 0 &&
+		       strcmp(argv[i], "-compress") != 0){
+			error("unrecognized option: %s", argv[i]);
+			usage();
+		    }
+		    if(i + 2 > argc){
+			error("missing argument to %s option", argv[i]);
+			usage();
+		    }
+		    if(argv[i][2] == 'a')
+			cache_dir = argv[i + 1];
+		    else if(strcmp(argv[i + 1], "gz") == 0)
+			compress_format = COMPRESS_GZIP;
+#ifdef WITH_ZSTD
+		    else if(strcmp(argv[i + 1], "zst") == 0)
+			compress_format = COMPRESS_ZSTD;
+#endif
+		    else{
+			error("unknown compression format: %s %s", argv[i],
+			      argv[i + 1]);
+			usage();
+		    }
+		    i += 1;
+		    break;
+		case 'd':
+		    if(strcmp(argv[i], "-decompress") != 0){
+			error("unrecognized option: %s", argv[i]);
+			usage();
+		    }
+		    decompress = 1;
+		    break;
+		case 'v':
+		    if(strcmp(argv[i], "-verify-signature") != 0){
+			error("unrecognized option: %s", argv[i]);
+			usage();
+		    }
+		    verify_signature = 1;
+		    break;
+		case 'r':
+		    if(strcmp(argv[i], "-remove") == 0){
+			if(i + 3 > argc){
+			    error("missing arguments to %s option", argv[i]);
+			    usage();
+			}
+			rm = allocate(sizeof(struct remove));
+			rm->segname = argv[i + 1];
+			rm->sectname = argv[i + 2];
+			rm->next = removes;
+			removes = rm;
+			i += 2;
+			break;
+		    }
+		    if(strcmp(argv[i], "-remove-segment") == 0){
+			if(i + 2 > argc){
+			    error("missing argument to %s option", argv[i]);
+			    usage();
+			}
+			rm = allocate(sizeof(struct remove));
+			rm->segname = argv[i + 1];
+			rm->sectname = NULL;
+			rm->next = removes;
+			removes = rm;
+			i += 1;
+			break;
+		    }
+		    if(strcmp(argv[i], "-replace") != 0){
+			error("unrecognized option: %s", argv[i]);
+			usage();
+		    }
+		    if(i + 4 > argc){
+			error("missing arguments to %s option", argv[i]);
+			usage();
+		    }
+		    for(rp = replaces; rp != NULL; rp = rp->next){
+			if(strcmp(rp->segname, argv[i + 1]) == 0 &&
+			   strcmp(rp->sectname, argv[i + 2]) == 0){
+			    error("section (%s,%s) specified more than once "
+				  "with %s", argv[i + 1], argv[i + 2],
+				  argv[i]);
+			    usage();
+			}
+		    }
+		    rp = allocate(sizeof(struct replace));
+		    rp->segname = argv[i + 1];
+		    rp->sectname = argv[i + 2];
+		    rp->filename = argv[i + 3];
+		    rp->next = replaces;
+		    replaces = rp;
 		    i += 3;
 		    break;
+		case 'o':
+		    if(strcmp(argv[i], "-output") != 0 &&
+		       strcmp(argv[i], "-o") != 0){
+			error("unrecognized option: %s", argv[i]);
+			usage();
+		    }
+		    if(i + 2 > argc){
+			error("missing argument to %s option", argv[i]);
+			usage();
+		    }
+		    if(output_name != NULL){
+			error("more than one %s option specified", argv[i]);
+			usage();
+		    }
+		    output_name = argv[i + 1];
+		    i += 1;
+		    break;
+		case 'b':
+		    if(strcmp(argv[i], "-bundle-dir") != 0){
+			error("unrecognized option: %s", argv[i]);
+			usage();
+		    }
+		    if(i + 2 > argc){
+			error("missing argument to %s option", argv[i]);
+			usage();
+		    }
+		    bundle_dirs = reallocate(bundle_dirs,
+			(nbundle_dirs + 1) * sizeof(char *));
+		    bundle_dirs[nbundle_dirs++] = argv[i + 1];
+		    i += 1;
+		    break;
+		case 'j':
+		    if(argv[i][2] != '\0'){
+			error("unrecognized option: %s", argv[i]);
+			usage();
+		    }
+		    if(i + 2 > argc){
+			error("missing argument to %s option", argv[i]);
+			usage();
+		    }
+		    njobs = strtoul(argv[i + 1], &endp, 10);
+		    if(*endp != '\0' || njobs == 0){
+			error("argument to %s option must be a positive number",
+			      argv[i]);
+			usage();
+		    }
+		    i += 1;
+		    break;
 		default:
 		    error("unrecognized option: %s", argv[i]);
 		    usage();
 		}
 	    }
 	    else{
-		if(input != NULL){
-		    fatal("only one input file can be specified");
-		    usage();
-		}
-		input = argv[i];
+		add_input(argv[i]);
 	    }
 	}
 
-	if(input == NULL){
+	/*
+	 * -hash without any -extract options hashes every section, as if
+	 * -extract-all had been given, whose output file name is not used.
+	 */
+	if(hash_name != NULL && extracts == NULL && replaces == NULL &&
+	   removes == NULL && symbolicating == 0){
+	    ep = allocate(sizeof(struct extract));
+	    ep->segname = "*";
+	    ep->sectname = "*";
+	    ep->symbol = NULL;
+	    ep->filename = "";
+	    ep->match = MATCH_GLOB;
+	    ep->index = nextracts++;
+	    ep->next = NULL;
+	    extracts = ep;
+	}
+
+	if(ninputs == 0 && nbundle_dirs == 0){
 	    error("no input file specified");
 	    usage();
 	}
 
-	if(extracts == NULL){
-	    error("no -extract option specified");
+	/*
+	 * -replace and -remove write one edited copy of one input file, so they
+	 * go with none of the options for extracting sections.
+	 */
+	editing = replaces != NULL || removes != NULL;
+	if(editing){
+	    if(extracts != NULL || symbolicating || verify_signature){
+		error("-replace and -remove can't be used with -extract, "
+		      "-symbolicate or -verify-signature");
+		usage();
+	    }
+	    if(output_name == NULL){
+		error("no -output option specified with -replace or -remove");
+		usage();
+	    }
+	    if(ninputs != 1 || nbundle_dirs != 0){
+		error("exactly one input file must be specified with -replace "
+		      "or -remove");
+		usage();
+	    }
+	    if(tar_name != NULL || store_dir != NULL || hash_name != NULL ||
+	       cache_dir != NULL || compress_format != COMPRESS_NONE ||
+	       decompress){
+		error("-replace and -remove can't be used with -tar, -store, "
+		      "-hash, -cache-dir, -compress or -decompress");
+		usage();
+	    }
+	    for(rp = replaces; rp != NULL; rp = rp->next)
+		map_replacement(rp);
+	}
+	else if(symbolicating){
+	    if(extracts != NULL || verify_signature){
+		error("-symbolicate can't be used with -extract or "
+		      "-verify-signature");
+		usage();
+	    }
+	    if(tar_name != NULL || store_dir != NULL || hash_name != NULL ||
+	       compress_format != COMPRESS_NONE || decompress){
+		error("-symbolicate can't be used with -tar, -store, -hash, "
+		      "-compress or -decompress");
+		usage();
+	    }
+	    for(j = 0; j < ninputs; j++){
+		if(strcmp(inputs[j], "-") == 0){
+		    error("the standard input can't be an input file with "
+			  "-symbolicate, which reads addresses from it");
+		    usage();
+		}
+	    }
+	}
+	else if(extracts == NULL && verify_signature == 0){
+	    error("no -extract, -hash or -verify-signature option specified");
+	    usage();
+	}
+	if(editing == 0 && output_name != NULL){
+	    error("-output can only be used with -replace or -remove");
+	    usage();
+	}
+
+	if(store_dir != NULL && tar_name != NULL){
+	    error("-store can't be used with -tar");
 	    usage();
 	}
+	if(hash_name != NULL && (tar_name != NULL || store_dir != NULL)){
+	    error("-hash can't be used with -tar or -store");
+	    usage();
+	}
+	if(compress_format != COMPRESS_NONE &&
+	   (tar_name != NULL || store_dir != NULL || hash_name != NULL)){
+	    error("-compress can't be used with -tar, -store or -hash");
+	    usage();
+	}
+	if(decompress &&
+	   (tar_name != NULL || store_dir != NULL || hash_name != NULL ||
+	    compress_format != COMPRESS_NONE)){
+	    error("-decompress can't be used with -tar, -store, -hash or "
+		  "-compress");
+	    usage();
+	}
+	single_entry = tar_name != NULL || hash_name != NULL;
+
+	/*
+	 * Names that are patterns can match more than one section, which must
+	 * each have their own output file.
+	 */
+	if(single_entry == 0){
+	    for(ep = extracts; ep != NULL; ep = ep->next){
+		if(ep->match != MATCH_EXACT &&
+		   template_has(ep->filename, 'c') == 0 &&
+		   template_has(ep->filename, 's') == 0)
+		    fatal("output file name: %s must contain %%s or %%c when "
+			  "section names are matched with a pattern",
+			  ep->filename);
+	    }
+	}
 
-	map_input();
+	/*
+	 * With more than one input file each must have its own output files,
+	 * so the output file names must contain the input file name.  In a tar
+	 * archive or manifest the entries are named after the input files
+	 * instead.
+	 */
+	if((ninputs > 1 || nbundle_dirs != 0) && single_entry == 0 &&
+	   extracts != NULL){
+	    for(ep = extracts; ep != NULL; ep = ep->next){
+		if(template_has(ep->filename, 'i') == 0)
+		    fatal("output file name: %s must contain %%i when more "
+			  "than one input file is specified", ep->filename);
+	    }
+	    claim_names = 1;
+	}
 
-	if(extracts != NULL)
-	    extract_sections();
+	hash_extracts();
 
-	return(0);
+	if(tar_name != NULL){
+	    if(strcmp(tar_name, "-") == 0)
+		tar_fd = dup(1);
+	    else
+		tar_fd = open(tar_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	    if(tar_fd == -1)
+		fatal("can't create: %s", tar_name);
+	}
+
+	if(hash_name != NULL){
+	    if(strcmp(hash_name, "-") == 0)
+		hash_file = stdout;
+	    else if((hash_file = fopen(hash_name, "w")) == NULL)
+		fatal("can't create: %s (%s)", hash_name, strerror(errno));
+	    fprintf(hash_file, "# input\tarch\tsegname\tsectname\toffset\t"
+		    "size\tsha256\txxh64\n");
+	}
+
+	/* the cache directory is created as output directories are */
+	if(cache_dir != NULL){
+	    p = allocate(strlen(cache_dir) + 2);
+	    sprintf(p, "%s/", cache_dir);
+	    if(make_dirs(p) == -1)
+		fatal("can't create: %s (%s)", cache_dir, strerror(errno));
+	    free(p);
+	}
+
+	if(trace_name != NULL && trace_open(trace_name) == -1)
+	    fatal("can't create: %s (%s)", trace_name, strerror(errno));
+	timing = stats || trace_name != NULL;
+	start = timing ? trace_now() : 0;
+
+	/*
+	 * How many input files are in the bundle directories is not known.
+	 * With -hash the sections of one input file are hashed in parallel, as
+	 * are its pages with -verify-signature.
+	 */
+	if(njobs == 0)
+	    njobs = ninputs > 1 || nbundle_dirs != 0 || hash_name != NULL ||
+		    verify_signature ? workqueue_ncpus() : 1;
+	if(njobs > ninputs && nbundle_dirs == 0 && hash_name == NULL &&
+	   verify_signature == 0)
+	    njobs = ninputs;
+
+	wq = workqueue_create(njobs);
+	workqueue_group_init(&group);
+	for(j = 0; j < nbundle_dirs; j++)
+	    workqueue_add(wq, &group, scan_dir, make_path(bundle_dirs[j], ""));
+	for(j = 0; j < ninputs; j++)
+	    workqueue_add(wq, &group, process_file, inputs[j]);
+	workqueue_wait(wq, &group);
+	workqueue_destroy(wq);
+
+	if(symbolicating){
+	    if(symbolicate() == -1)
+		errors = 1;
+	    free_images();
+	}
+
+	if(tar_fd != -1){
+	    if(write_all(tar_fd, zero_blocks, sizeof(zero_blocks)) == -1)
+		fatal("can't write: %s (%s)", tar_name, strerror(errno));
+	    if(close(tar_fd) == -1)
+		fatal("can't close: %s", tar_name);
+	}
+	if(hash_file != NULL &&
+	   (ferror(hash_file) || fclose(hash_file) == EOF))
+	    fatal("can't write: %s", hash_name);
+	if(trace_name != NULL && trace_close() == -1)
+	    fatal("can't write: %s (%s)", trace_name, strerror(errno));
+	if(stats)
+	    print_stats(trace_now() - start);
+
+	return(errors != 0);
 }
 
 /*
- * map_input maps the input file into memory.  The address it is mapped at is
- * left in input_addr and the size is left in input_size.  The input file is
- * checked to be an object file and that the headers are checked to be correct
- * enough to loop through them.  The pointer to the mach header is left in mhp
- * and the pointer to the load commands is left in load_commands.
+ * make_section_key fills in the key for the section and segment names, which
+ * need not be null terminated if they are 16 characters long.
  */
 static
 void
-map_input(void)
+make_section_key(
+struct section_key *key,
+const char *sectname,
+const char *segname)
 {
-    int fd;
-    uint32_t i, magic, mh_sizeofcmds;
-    struct stat stat_buf;
-    struct load_command l, *lcp;
-    struct segment_command *sgp;
-    struct segment_command_64 *sgp64;
-    struct section *sp;
-    struct section_64 *sp64;
-    struct symtab_command *stp;
-    struct symseg_command *ssp;
-
-	/* Open the input file and map it in */
-	if((fd = open(input, O_RDONLY)) == -1)
-	    fatal("can't open input file: %s", input);
-	if(fstat(fd, &stat_buf) == -1)
-	    fatal("Can't stat input file: %s", input);
-	input_size = stat_buf.st_size;
-	input_mode = stat_buf.st_mode;
-	input_addr = mmap(0, input_size, PROT_READ|PROT_WRITE,
-			  MAP_FILE|MAP_PRIVATE, fd, 0);
-	if((intptr_t)input_addr == -1)
-	    error("Can't map input file: %s", input);
-	close(fd);
-
-	if(sizeof(uint32_t) > input_size)
-	    fatal("truncated or malformed object (mach header would extend "
-		  "past the end of the file) in: %s", input);
-	magic = *(uint32_t *)input_addr;
-#ifdef __BIG_ENDIAN
-	if(magic == FAT_MAGIC)
-#endif /* __BIG_ENDIAN */
-#ifdef __LITTLE_ENDIAN
-	if(magic == SWAP_INT(FAT_MAGIC))
-#endif /* __LITTLE_ENDIAN */
-	    fatal("file: %s is a fat file (%s only operates on Mach-O files, "
-		  "use lipo(1) on it to get a Mach-O file)", input, progname);
-
-	mh_ncmds = 0;
-	mh_sizeofcmds = 0;
-	host_byte_sex = get_host_byte_sex();
-	if(magic == SWAP_INT(MH_MAGIC) || magic == MH_MAGIC){
-	    if(sizeof(struct mach_header) > input_size)
-		fatal("truncated or malformed object (mach header would extend "
-		      "past the end of the file) in: %s", input);
-	    mhp = (struct mach_header *)input_addr;
-	    if(magic == SWAP_INT(MH_MAGIC)){
-		swapped = 1;
-		target_byte_sex = host_byte_sex == BIG_ENDIAN_BYTE_SEX ?
-				  LITTLE_ENDIAN_BYTE_SEX : BIG_ENDIAN_BYTE_SEX;
-		swap_mach_header(mhp, host_byte_sex);
-	    }
-	    else{
-		swapped = 0;
-		target_byte_sex = host_byte_sex;
-	    }
-	    if(mhp->sizeofcmds + sizeof(struct mach_header) > input_size)
-		fatal("truncated or malformed object (load commands would "
-		      "extend past the end of the file) in: %s", input);
-	    load_commands = (struct load_command *)((char *)input_addr +
-				sizeof(struct mach_header));
-	    mh_ncmds = mhp->ncmds;
-	    mh_sizeofcmds = mhp->sizeofcmds;
-	}
-	else if(magic == SWAP_INT(MH_MAGIC_64) || magic == MH_MAGIC_64){
-	    if(sizeof(struct mach_header_64) > input_size)
-		fatal("truncated or malformed object (mach header would extend "
-		      "past the end of the file) in: %s", input);
-	    mhp64 = (struct mach_header_64 *)input_addr;
-	    if(magic == SWAP_INT(MH_MAGIC_64)){
-		swapped = 1;
-		target_byte_sex = host_byte_sex == BIG_ENDIAN_BYTE_SEX ?
-				  LITTLE_ENDIAN_BYTE_SEX : BIG_ENDIAN_BYTE_SEX;
-		swap_mach_header_64(mhp64, host_byte_sex);
-	    }
-	    else{
-		swapped = 0;
-		target_byte_sex = host_byte_sex;
-	    }
-	    if(mhp64->sizeofcmds + sizeof(struct mach_header_64) > input_size)
-		fatal("truncated or malformed object (load commands would "
-		      "extend past the end of the file) in: %s", input);
-	    load_commands = (struct load_command *)((char *)input_addr +
-				sizeof(struct mach_header_64));
-	    mh_ncmds = mhp64->ncmds;
-	    mh_sizeofcmds = mhp64->sizeofcmds;
-	}
-	else
-	    fatal("bad magic number (file is not a Mach-O file) in: %s", input);
-
-	lcp = load_commands;
-	for(i = 0; i < mh_ncmds; i++){
-	    l = *lcp;
-	    if(swapped)
-		swap_load_command(&l, host_byte_sex);
-	    if(l.cmdsize % sizeof(uint32_t) != 0)
-		error("load command %u size not a multiple of "
-		      "sizeof(uint32_t) in: %s", i, input);
-	    if(l.cmdsize <= 0)
-		fatal("load command %u size is less than or equal to zero "
-		      "in: %s", i, input);
-	    if((char *)lcp + l.cmdsize >
-	       (char *)load_commands + mh_sizeofcmds)
-		fatal("load command %u extends past end of all load commands "
-		      "in: %s", i, input);
-	    switch(l.cmd){
-	    case LC_SEGMENT:
-		sgp = (struct segment_command *)lcp;
-		sp = (struct section *)((char *)sgp +
-					sizeof(struct segment_command));
-		if(swapped)
-		    swap_segment_command(sgp, host_byte_sex);
-		if(swapped)
-		    swap_section(sp, sgp->nsects, host_byte_sex);
-		break;
-	    case LC_SEGMENT_64:
-		sgp64 = (struct segment_command_64 *)lcp;
-		sp64 = (struct section_64 *)((char *)sgp64 +
-					sizeof(struct segment_command_64));
-		if(swapped)
-		    swap_segment_command_64(sgp64, host_byte_sex);
-		if(swapped)
-		    swap_section_64(sp64, sgp64->nsects, host_byte_sex);
-		break;
-	    case LC_SYMTAB:
-		stp = (struct symtab_command *)lcp;
-		if(swapped)
-		    swap_symtab_command(stp, host_byte_sex);
-		break;
-	    case LC_SYMSEG:
-		ssp = (struct symseg_command *)lcp;
-		if(swapped)
-		    swap_symseg_command(ssp, host_byte_sex);
-		break;
-	    default:
-		*lcp = l;
-		break;
-	    }
-	    lcp = (struct load_command *)((char *)lcp + l.cmdsize);
-	}
+	strncpy((char *)key->words, sectname, 16);
+	strncpy((char *)key->words + 16, segname, 16);
+}
+
+static
+uint32_t
+hash_section_key(
+const struct section_key *key)
+{
+    uint64_t h;
+
+	h = key->words[0] * 0x9e3779b97f4a7c15ULL;
+	h = (h ^ key->words[1]) * 0xc2b2ae3d27d4eb4fULL;
+	h = (h ^ key->words[2]) * 0x9e3779b97f4a7c15ULL;
+	h = (h ^ key->words[3]) * 0xc2b2ae3d27d4eb4fULL;
+	return((uint32_t)(h >> 32) ^ (uint32_t)h);
 }
 
 /*
- * This routine extracts the sections in the extracts list from the input file
- * and writes then to the file specified in the list.
+ * hash_extracts builds the hash table of the extract structures, so that each
+ * section in an object is looked up once instead of being compared with every
+ * extract structure.  The table is kept at most half full.  The extract
+ * structures whose names are patterns are put in the patterns array instead.
  */
 static
 void
-extract_sections(void)
-{
-    uint32_t i, j, errors;
-    struct load_command *lcp;
-    struct segment_command *sgp;
-    struct segment_command_64 *sgp64;
-    struct section *sp;
-    struct section_64 *sp64;
-    struct extract *ep;
+hash_extracts(void)
+{
+    uint32_t size, h;
+    struct extract *ep, *hp;
 
-	lcp = load_commands;
-	for(i = 0; i < mh_ncmds; i++){
-	    if(lcp->cmd == LC_SEGMENT){
-		sgp = (struct segment_command *)lcp;
-		sp = (struct section *)((char *)sgp +
-					sizeof(struct segment_command));
-		for(j = 0; j < sgp->nsects; j++){
-		    extract_section(sp->segname, sp->sectname, sp->flags,
-				    sp->offset, sp->size);
-		    sp++;
-		}
+	for(size = 2; size < nextracts * 2; size *= 2)
+	    ;
+	extract_hash = allocate(size * sizeof(struct extract *));
+	memset(extract_hash, '\0', size * sizeof(struct extract *));
+	extract_hash_mask = size - 1;
+
+	for(ep = extracts; ep != NULL; ep = ep->next){
+	    if(ep->symbol != NULL){
+		ep->same = NULL;
+		continue;
 	    }
-	    else if(lcp->cmd == LC_SEGMENT_64){
-		sgp64 = (struct segment_command_64 *)lcp;
-		sp64 = (struct section_64 *)((char *)sgp64 +
-					sizeof(struct segment_command_64));
-		for(j = 0; j < sgp64->nsects; j++){
-		    extract_section(sp64->segname, sp64->sectname, sp64->flags,
-				    sp64->offset, sp64->size);
-		    sp64++;
-		}
+	    if(ep->match != MATCH_EXACT){
+		patterns = reallocate(patterns,
+		    (npatterns + 1) * sizeof(struct extract *));
+		patterns[npatterns++] = ep;
+		ep->same = NULL;
+		continue;
 	    }
-	    lcp = (struct load_command *)((char *)lcp + lcp->cmdsize);
-	}
-
-	errors = 0;
-	ep = extracts;
-	while(ep != NULL){
-	    if(ep->found == 0){
-		error("section (%s,%s) not found in: %s", ep->segname,
-		      ep->sectname, input);
-		errors = 1;
+	    make_section_key(&ep->key, ep->sectname, ep->segname);
+	    ep->same = NULL;
+	    h = hash_section_key(&ep->key) & extract_hash_mask;
+	    while((hp = extract_hash[h]) != NULL &&
+		  memcmp(&hp->key, &ep->key, sizeof(struct section_key)) != 0)
+		h = (h + 1) & extract_hash_mask;
+	    if(hp != NULL){
+		while(hp->same != NULL)
+		    hp = hp->same;
+		hp->same = ep;
 	    }
-	    ep = ep->next;
+	    else
+		extract_hash[h] = ep;
 	}
-	if(errors != 0)
-	    exit(1);
 }
 
+/*
+ * lookup_extract returns the first extract structure for the section key, or
+ * NULL if no section with those names is to be extracted.
+ */
 static
-void
-extract_section(
-char *segname,
-char *sectname,
-uint32_t flags,
-uint32_t offset,
-uint32_t size)
+struct extract *
+lookup_extract(
+const struct section_key *key)
 {
-    struct extract *ep;
-    int fd;
+    uint32_t h;
+    struct extract *hp;
 
-	ep = extracts;
-	while(ep != NULL){
-	    if(ep->found == 0 &&
-	       strncmp(ep->segname, segname, 16) == 0 &&
-	       strncmp(ep->sectname, sectname, 16) == 0){
-		if(flags == S_ZEROFILL || flags == S_THREAD_LOCAL_ZEROFILL)
-		    fatal("meaningless to extract zero fill "
-			  "section (%s,%s) in: %s", segname,
-			  sectname, input);
-		if(offset + size > input_size)
-		    fatal("truncated or malformed object (section "
-			  "contents of (%s,%s) extends past the "
-			  "end of the file) in: %s", segname,
-			  sectname, input);
-		 if((fd = open(ep->filename, O_WRONLY | O_CREAT |
-			       O_TRUNC, 0666)) == -1)
-		    fatal("can't create: %s", ep->filename);
-		 if(write(fd, (char *)input_addr + offset,
-			 size) != (int)size)
-		    fatal("can't write: %s", ep->filename);
-		 if(close(fd) == -1)
-		    fatal("can't close: %s", ep->filename);
-		 ep->found = 1;
-	    }
-	    ep = ep->next;
+	h = hash_section_key(key) & extract_hash_mask;
+	while((hp = extract_hash[h]) != NULL){
+	    if(hp->key.words[0] == key->words[0] &&
+	       hp->key.words[1] == key->words[1] &&
+	       hp->key.words[2] == key->words[2] &&
+	       hp->key.words[3] == key->words[3])
+		return(hp);
+	    h = (h + 1) & extract_hash_mask;
 	}
+	return(NULL);
 }
 
-// misc/allocate.c
+/*
+ * match_extract returns 1 if the section's names match the names of the
+ * extract structure, which are patterns.
+ */
 static
-void *
-allocate(
-size_t size)
+int
+match_extract(
+struct extract *ep,
+const char *segname,
+const char *sectname)
 {
-    void *p;
+	if(ep->match == MATCH_REGEX)
+	    return(regexec(&ep->segname_regex, segname, 0, NULL, 0) == 0 &&
+		   regexec(&ep->sectname_regex, sectname, 0, NULL, 0) == 0);
+	return(fnmatch(ep->segname, segname, 0) == 0 &&
+	       fnmatch(ep->sectname, sectname, 0) == 0);
+}
 
-	if(size == 0)
-	    return(NULL);
-	if((p = malloc(size)) == NULL)
-	    fatal("virtual memory exhausted (malloc failed)");
+/*
+ * compile_regex compiles the extended regular expression, which must match a
+ * whole name.  It returns -1 and prints an error if it can't be compiled.
+ */
+static
+int
+compile_regex(
+regex_t *regex,
+const char *pattern)
+{
+    char *anchored, message[256];
+    int err;
+
+	anchored = allocate(strlen(pattern) + sizeof("^()$"));
+	sprintf(anchored, "^(%s)$", pattern);
+	err = regcomp(regex, anchored, REG_EXTENDED | REG_NOSUB);
+	free(anchored);
+	if(err != 0){
+	    regerror(err, regex, message, sizeof(message));
+	    error("bad regular expression: %s (%s)", pattern, message);
+	    return(-1);
+	}
+	return(0);
+}
+
+/*
+ * add_input adds the named file to the list of input files.
+ */
+static
+void
+add_input(
+char *name)
+{
+	if((ninputs & (ninputs - 1)) == 0)
+	    inputs = reallocate(inputs, (ninputs == 0 ? 1 : ninputs * 2) *
+				sizeof(char *));
+	inputs[ninputs++] = name;
+}
+
+/*
+ * read_file_list adds the input files named in the file list to the list of
+ * input files.  The names are separated by the separator character, and the
+ * list is read from the standard input if it is named "-".
+ */
+static
+void
+read_file_list(
+char *list,
+char separator)
+{
+    FILE *fp;
+    char *line;
+    size_t n;
+    ssize_t len;
+
+	if(strcmp(list, "-") == 0)
+	    fp = stdin;
+	else if((fp = fopen(list, "r")) == NULL)
+	    fatal("can't open file list: %s", list);
+	line = NULL;
+	n = 0;
+	while((len = getdelim(&line, &n, separator, fp)) != -1){
+	    if(len > 0 && line[len - 1] == separator)
+		line[--len] = '\0';
+	    if(len == 0)
+		continue;
+	    add_input(strdup(line));
+	}
+	if(ferror(fp))
+	    fatal("can't read file list: %s", list);
+	free(line);
+	if(fp != stdin)
+	    fclose(fp);
+}
+
+/*
+ * scan_dir is run from the workqueue for each directory searched for kext
+ * bundles, starting with the -bundle-dir directories.  A directory whose name
+ * ends in ".kext" is a bundle.  Each other subdirectory is searched by a work
+ * item of its own, so the tree is walked by all the threads at once while the
+ * bundle executables found are already being operated on.  Symbolic links to
+ * directories are not followed.  The path is allocated and freed here.
+ */
+static
+void
+scan_dir(
+void *arg)
+{
+    char *path, *subpath;
+    size_t len;
+    DIR *dir;
+    struct dirent *dp;
+    struct stat stat_buf;
+
+	path = arg;
+	len = strlen(path);
+	if(len > 1 && path[len - 1] == '/')
+	    path[--len] = '\0';
+	if(len >= sizeof(".kext") && strcmp(path + len - 5, ".kext") == 0){
+	    scan_bundle(path);
+	    free(path);
+	    return;
+	}
+	if((dir = opendir(path)) == NULL){
+	    error("can't open directory: %s (%s)", path, strerror(errno));
+	    __atomic_store_n(&errors, 1, __ATOMIC_RELAXED);
+	    free(path);
+	    return;
+	}
+	while((dp = readdir(dir)) != NULL){
+	    if(strcmp(dp->d_name, ".") == 0 || strcmp(dp->d_name, "..") == 0)
+		continue;
+	    if(dp->d_type != DT_DIR && dp->d_type != DT_UNKNOWN)
+		continue;
+	    subpath = make_path(path, dp->d_name);
+	    if(dp->d_type == DT_UNKNOWN &&
+	       (lstat(subpath, &stat_buf) == -1 || !S_ISDIR(stat_buf.st_mode))){
+		free(subpath);
+		continue;
+	    }
+	    workqueue_add(wq, &group, scan_dir, subpath);
+	}
+	closedir(dir);
+	free(path);
+}
+
+/*
+ * scan_bundle operates on the executable of the kext bundle and searches its
+ * plug-ins for more bundles.  Both the "Contents" layout of macOS bundles and
+ * the flat layout of iOS bundles are handled.  Bundles without an executable,
+ * like codeless kexts, are skipped.
+ */
+static
+void
+scan_bundle(
+char *path)
+{
+    char *contents, *info_plist, *exec_dir, *name, *executable, *plugins;
+    struct stat stat_buf;
+
+	contents = make_path(path, "Contents");
+	if(stat(contents, &stat_buf) == 0 && S_ISDIR(stat_buf.st_mode)){
+	    info_plist = make_path(contents, "Info.plist");
+	    exec_dir = make_path(contents, "MacOS");
+	    plugins = make_path(contents, "PlugIns");
+	}
+	else{
+	    info_plist = make_path(path, "Info.plist");
+	    exec_dir = strdup(path);
+	    plugins = make_path(path, "PlugIns");
+	}
+	free(contents);
+
+	name = bundle_executable(path, info_plist);
+	executable = make_path(exec_dir, name);
+	free(name);
+	free(exec_dir);
+	free(info_plist);
+	if(stat(executable, &stat_buf) == 0 && S_ISREG(stat_buf.st_mode))
+	    workqueue_add(wq, &group, process_found_file, executable);
+	else
+	    free(executable);
+
+	if(stat(plugins, &stat_buf) == 0 && S_ISDIR(stat_buf.st_mode))
+	    workqueue_add(wq, &group, scan_dir, plugins);
+	else
+	    free(plugins);
+}
+
+/*
+ * bundle_executable returns the allocated name of the executable of the
+ * bundle at path, from the CFBundleExecutable key of its Info.plist.  Only XML
+ * property lists are understood.  If the name can't be found there it is the
+ * name of the bundle without the ".kext", as it is for nearly all kexts.
+ */
+static
+char *
+bundle_executable(
+char *path,
+char *info_plist)
+{
+    int fd;
+    ssize_t n;
+    size_t size;
+    char *buf, *p, *q, *name;
+    const char *base;
+
+	name = NULL;
+	if((fd = open(info_plist, O_RDONLY)) != -1){
+	    buf = allocate(INFO_PLIST_MAXSIZE + 1);
+	    size = 0;
+	    while(size < INFO_PLIST_MAXSIZE){
+		n = read(fd, buf + size, INFO_PLIST_MAXSIZE - size);
+		if(n == -1 && errno == EINTR)
+		    continue;
+		if(n <= 0)
+		    break;
+		size += n;
+	    }
+	    close(fd);
+	    buf[size] = '\0';
+	    if((p = strstr(buf, "<key>CFBundleExecutable</key>")) != NULL){
+		p += sizeof("<key>CFBundleExecutable</key>") - 1;
+		while(*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+		    p++;
+		if(strncmp(p, "<string>", sizeof("<string>") - 1) == 0){
+		    p += sizeof("<string>") - 1;
+		    if((q = strstr(p, "</string>")) != NULL && q != p &&
+		       memchr(p, '/', q - p) == NULL &&
+		       memchr(p, '&', q - p) == NULL)
+			name = strndup(p, q - p);
+		}
+	    }
+	    free(buf);
+	}
+	if(name == NULL){
+	    if((base = strrchr(path, '/')) != NULL)
+		base++;
+	    else
+		base = path;
+	    name = strndup(base, strlen(base) - (sizeof(".kext") - 1));
+	}
+	return(name);
+}
+
+/*
+ * process_found_file is run from the workqueue for each bundle executable
+ * found.  Its allocated name is freed after it is operated on.
+ */
+static
+void
+process_found_file(
+void *arg)
+{
+	process_file(arg);
+	free(arg);
+}
+
+/*
+ * make_path returns the allocated path of name in the directory dir.
+ */
+static
+char *
+make_path(
+const char *dir,
+const char *name)
+{
+    char *path;
+    size_t len;
+
+	len = strlen(dir);
+	while(len > 0 && dir[len - 1] == '/')
+	    len--;
+	path = allocate(len + strlen(name) + 2);
+	memcpy(path, dir, len);
+	path[len] = '/';
+	strcpy(path + len + 1, name);
+	return(path);
+}
+
+/*
+ * process_file is run from the workqueue for each input file.  It maps the
+ * input file, extracts the sections from it (or with -replace and -remove
+ * writes an edited copy of it) and unmaps it again.  Input files that can't be
+ * mapped, like pipes, are read as a stream instead.
+ */
+static
+void
+process_file(
+void *arg)
+{
+    struct ofile ofile;
+    int result;
+    uint64_t start, size;
+
+	memset(&ofile, '\0', sizeof(struct ofile));
+	ofile.hashes_tail = &ofile.hashes;
+	ofile.inflates_tail = &ofile.inflates;
+	workqueue_group_init(&ofile.hash_group);
+	workqueue_group_init(&ofile.inflate_group);
+	segedit_init(&ofile.sf, arg);
+	start = phase_begin();
+	result = claim_names ? claim_input_name(arg) : 0;
+	if(result == 0)
+	    result = map_input(&ofile);
+	if(result == 0){
+	    if(editing)
+		result = edit_input(&ofile);
+	    else if(symbolicating)
+		result = index_input(&ofile);
+	    else if(ofile.streaming && verify_signature){
+		error("can't verify the code signature of: %s (not a regular "
+		      "file)", ofile.sf.file_name);
+		result = -1;
+	    }
+	    else if(ofile.streaming)
+		result = stream_input(&ofile);
+	    else
+		result = process_input(&ofile);
+	}
+	if(result == -1)
+	    __atomic_store_n(&errors, 1, __ATOMIC_RELAXED);
+	size = ofile.sf.file_size;
+	unmap_input(&ofile);
+	if(trace_name != NULL)
+	    trace_event("file", arg, NULL, start, trace_now(), size);
+}
+
+/*
+ * map_input opens the input file and maps it with segedit_map_fd(), which
+ * leaves the fat headers of a fat file in the host byte sex.  The input file
+ * is left open in file_fd so the sections can be copied from it by the kernel.
+ * An input file named "-" is the standard input.  If the input file is not a
+ * regular file it is not mapped and streaming is set instead.  It returns -1
+ * and prints an error if this can't be done.
+ */
+static
+int
+map_input(
+struct ofile *ofile)
+{
+    int fd;
+    uint64_t start;
+    enum segedit_error status;
+
+	start = phase_begin();
+	if(strcmp(ofile->sf.file_name, "-") == 0)
+	    fd = dup(0);
+	else
+	    fd = open(ofile->sf.file_name, O_RDONLY);
+	if(fd == -1){
+	    error("can't open input file: %s", ofile->sf.file_name);
+	    return(-1);
+	}
+	status = segedit_map_fd(&ofile->sf, fd);
+	phase_end(ofile, PHASE_MAP, start, 0);
+	switch(status){
+	case SEGEDIT_OK:
+	    return(0);
+	case SEGEDIT_ENOTREG:
+	    ofile->streaming = 1;
+	    return(0);
+	default:
+	    print_error(ofile);
+	    return(-1);
+	}
+}
+
+/*
+ * print_error prints the message of the error libsegedit returned.
+ */
+void
+print_error(
+struct ofile *ofile)
+{
+	if(ofile->sf.error == SEGEDIT_ESYS){
+	    error("%s (%s)", ofile->sf.message, strerror(ofile->sf.sys_errno));
+	    return;
+	}
+	error("%s", ofile->sf.message);
+}
+
+/*
+ * unmap_input releases what map_input and process_input allocated for the
+ * input file, after adding its statistics to the totals.
+ */
+static
+void
+unmap_input(
+struct ofile *ofile)
+{
+    uint64_t start;
+
+	start = phase_begin();
+	segedit_close(&ofile->sf);
+	phase_end(ofile, PHASE_UNMAP, start, 0);
+	if(stats)
+	    add_stats(ofile);
+	free(ofile->found);
+	free(ofile->ranges);
+	free(ofile->stream_buf);
+	memset(ofile, '\0', sizeof(struct ofile));
+}
+
+/*
+ * process_input extracts the sections from each object in the input file that
+ * is selected by the -arch flags, or from all of them if there were no -arch
+ * flags.  The objects in a fat file are used in place in the mapped input file
+ * so they are never copied.  With -cache-dir their section tables are taken
+ * from the cache instead of parsing their load commands.  When more than one
+ * object is operated on the output file names are suffixed with the
+ * architecture name.  It returns -1 if any of the objects could not be
+ * operated on.
+ */
+static
+int
+process_input(
+struct ofile *ofile)
+{
+    uint32_t i;
+    int result, nselected;
+    char *selected;
+
+	ofile->found = allocate(nextracts);
+	use_cache(ofile);
+
+	if(ofile->sf.fat_archs == NULL){
+	    ofile->sf.object_name = ofile->sf.file_name;
+	    ofile->arch_suffix = NULL;
+	    if(map_arch(ofile, 0) == -1 ||
+	       check_arch_flags(ofile) == -1)
+		return(-1);
+	    return(process_object(ofile));
+	}
+
+	selected = allocate(ofile->sf.fat_header.nfat_arch);
+	if((nselected = select_fat_archs(ofile, selected)) == -1){
+	    free(selected);
+	    return(-1);
+	}
+	result = 0;
+	for(i = 0; i < ofile->sf.fat_header.nfat_arch; i++){
+	    if(selected[i] == 0)
+		continue;
+	    set_object_name(ofile, i, nselected);
+	    if(map_arch(ofile, i) == -1 || process_object(ofile) == -1)
+		result = -1;
+	    free(ofile->sf.object_name);
+	    ofile->sf.object_name = NULL;
+	}
+	free(selected);
+	return(result);
+}
+
+/*
+ * process_object operates on the mapped object: with -verify-signature its
+ * code signature is checked first, and nothing is extracted from it if that
+ * fails.  It returns -1 if any of that fails.
+ */
+static
+int
+process_object(
+struct ofile *ofile)
+{
+	if(verify_signature && verify_object(ofile) == -1)
+	    return(-1);
+	if(extracts == NULL)
+	    return(0);
+	return(extract_sections(ofile));
+}
+
+/*
+ * check_arch_flags checks that the object of a thin input file is of the
+ * architecture of each -arch flag.  It returns -1 and prints an error if not.
+ */
+int
+check_arch_flags(
+struct ofile *ofile)
+{
+    uint32_t j;
+    cpu_type_t cputype;
+    cpu_subtype_t cpusubtype;
+
+	if(ofile->sf.mhp64 != NULL){
+	    cputype = ofile->sf.mhp64->cputype;
+	    cpusubtype = ofile->sf.mhp64->cpusubtype;
+	}
+	else{
+	    cputype = ofile->sf.mhp->cputype;
+	    cpusubtype = ofile->sf.mhp->cpusubtype;
+	}
+	for(j = 0; j < narch_flags; j++){
+	    if(arch_flag_matches(arch_flags + j, cputype, cpusubtype) == 0){
+		error("file: %s does not contain architecture: %s",
+		      ofile->sf.file_name, arch_flags[j].name);
+		return(-1);
+	    }
+	}
+	return(0);
+}
+
+/*
+ * select_fat_archs sets the selected flag of each object in the fat file that
+ * is selected by the -arch flags, or of all of them if there were no -arch
+ * flags, and returns the number of selected objects.  It returns -1 and prints
+ * an error if the fat file does not contain one of the -arch flags.
+ */
+int
+select_fat_archs(
+struct ofile *ofile,
+char *selected)
+{
+    uint32_t i, j, nselected;
+    struct fat_arch_64 *fat_archs;
+
+	fat_archs = ofile->sf.fat_archs;
+	for(j = 0; j < narch_flags; j++){
+	    for(i = 0; i < ofile->sf.fat_header.nfat_arch; i++){
+		if(arch_flag_matches(arch_flags + j, fat_archs[i].cputype,
+				     fat_archs[i].cpusubtype))
+		    break;
+	    }
+	    if(i == ofile->sf.fat_header.nfat_arch){
+		error("file: %s does not contain architecture: %s",
+		      ofile->sf.file_name, arch_flags[j].name);
+		return(-1);
+	    }
+	}
+	nselected = 0;
+	for(i = 0; i < ofile->sf.fat_header.nfat_arch; i++){
+	    selected[i] = narch_flags == 0;
+	    for(j = 0; j < narch_flags; j++){
+		if(arch_flag_matches(arch_flags + j, fat_archs[i].cputype,
+				     fat_archs[i].cpusubtype))
+		    selected[i] = 1;
+	    }
+	    if(selected[i])
+		nselected++;
+	}
+	return(nselected);
+}
+
+/*
+ * set_object_name sets the allocated object_name and the arch_suffix for the
+ * i'th object in the fat file.  The name of an unknown architecture is put in
+ * sf.arch_name_buf, where segedit_map_arch() puts it again.  If another slice
+ * has an architecture of the same name the arch_suffix is followed by the
+ * index of the slice, so that their output files don't overwrite each other.
+ */
+void
+set_object_name(
+struct ofile *ofile,
+uint32_t i,
+uint32_t nselected)
+{
+    const char *arch_name, *other_name;
+    char other_buf[ARCH_NAME_SIZE];
+    uint32_t j;
+
+	arch_name = format_arch_name(ofile->sf.fat_archs[i].cputype,
+				     ofile->sf.fat_archs[i].cpusubtype,
+				     ofile->sf.arch_name_buf,
+				     sizeof(ofile->sf.arch_name_buf));
+	ofile->sf.object_name = allocate(strlen(ofile->sf.file_name) +
+	    strlen(arch_name) + sizeof(" (for architecture )"));
+	sprintf(ofile->sf.object_name, "%s (for architecture %s)",
+		ofile->sf.file_name, arch_name);
+	ofile->arch_suffix = NULL;
+	if(nselected <= 1)
+	    return;
+	ofile->arch_suffix = arch_name;
+	for(j = 0; j < ofile->sf.fat_header.nfat_arch; j++){
+	    if(j == i)
+		continue;
+	    other_name = format_arch_name(ofile->sf.fat_archs[j].cputype,
+					  ofile->sf.fat_archs[j].cpusubtype,
+					  other_buf, sizeof(other_buf));
+	    if(strcmp(arch_name, other_name) == 0){
+		snprintf(ofile->arch_suffix_buf, sizeof(ofile->arch_suffix_buf),
+			 "%s.%u", arch_name, i);
+		ofile->arch_suffix = ofile->arch_suffix_buf;
+		break;
+	    }
+	}
+}
+
+/*
+ * stream_input extracts the sections from an input file that can't be mapped,
+ * like a pipe, in one pass.  Only the headers and load commands of each
+ * object are read into memory.  The sections to extract are found with them as
+ * usual, but extract_section() only records their ranges, which are then
+ * copied to the output files as the input goes by through a buffer of a fixed
+ * size.  Objects in a fat file are read in the order of their offsets.  It
+ * returns -1 if any of the objects could not be operated on.
+ */
+static
+int
+stream_input(
+struct ofile *ofile)
+{
+    uint32_t i, j, magic, nfat_arch;
+    int result, nselected;
+    uint64_t size;
+    char *buf, *selected, *done;
+    struct fat_arch_64 *fat_archs;
+
+	ofile->found = allocate(nextracts);
+	ofile->stream_buf = allocate(STREAM_BUFSIZE);
+	ofile->stream_pos = 0;
+	ofile->stream_splice = 1;
+
+	if(stream_read(ofile, (char *)&magic, sizeof(uint32_t)) == -1)
+	    return(-1);
+	if(magic != FAT_MAGIC && magic != FAT_CIGAM &&
+	   magic != FAT_MAGIC_64 && magic != FAT_CIGAM_64){
+	    ofile->sf.object_name = ofile->sf.file_name;
+	    ofile->arch_suffix = NULL;
+	    return(stream_object(ofile, &magic, UINT64_MAX));
+	}
+
+	/* The fat headers are always big-endian, copy and swap them */
+	ofile->sf.fat_header.magic = magic;
+	if(stream_read(ofile, (char *)&ofile->sf.fat_header.nfat_arch,
+		       sizeof(uint32_t)) == -1)
+	    return(-1);
+	if(HOST_BYTE_SEX != BIG_ENDIAN_BYTE_SEX)
+	    swap_fat_header(&ofile->sf.fat_header, HOST_BYTE_SEX);
+	nfat_arch = ofile->sf.fat_header.nfat_arch;
+	if(nfat_arch == 0){
+	    error("fat file contains no architectures in: %s",
+		  ofile->sf.file_name);
+	    return(-1);
+	}
+	size = ofile->sf.fat_header.magic == FAT_MAGIC_64 ?
+	       sizeof(struct fat_arch_64) : sizeof(struct fat_arch);
+	if(nfat_arch * size > STREAM_BUFSIZE){
+	    error("truncated or malformed fat file (too many fat_arch structs) "
+		  "in: %s", ofile->sf.file_name);
+	    return(-1);
+	}
+	buf = allocate(nfat_arch * size);
+	if(stream_read(ofile, buf, nfat_arch * size) == -1){
+	    free(buf);
+	    return(-1);
+	}
+	if(segedit_set_fat_archs(&ofile->sf, buf) != SEGEDIT_OK){
+	    print_error(ofile);
+	    free(buf);
+	    return(-1);
+	}
+	free(buf);
+
+	selected = allocate(nfat_arch);
+	if((nselected = select_fat_archs(ofile, selected)) == -1){
+	    free(selected);
+	    return(-1);
+	}
+
+	/* the objects can only be read in the order of their offsets */
+	fat_archs = ofile->sf.fat_archs;
+	done = allocate(nfat_arch);
+	memset(done, '\0', nfat_arch);
+	result = 0;
+	for(;;){
+	    j = nfat_arch;
+	    for(i = 0; i < nfat_arch; i++){
+		if(selected[i] != 0 && done[i] == 0 &&
+		   (j == nfat_arch ||
+		    fat_archs[i].offset < fat_archs[j].offset))
+		    j = i;
+	    }
+	    if(j == nfat_arch)
+		break;
+	    done[j] = 1;
+	    set_object_name(ofile, j, nselected);
+	    if(fat_archs[j].offset < ofile->stream_pos){
+		error("object overlaps the objects before it in the fat file "
+		      "(can't be read from a stream) in: %s",
+		      ofile->sf.object_name);
+		result = -1;
+	    }
+	    else if(stream_skip(ofile, fat_archs[j].offset -
+				       ofile->stream_pos) == -1 ||
+		    stream_read(ofile, (char *)&magic,
+				sizeof(uint32_t)) == -1 ||
+		    stream_object(ofile, &magic, fat_archs[j].size) == -1)
+		result = -1;
+	    free(ofile->sf.object_name);
+	    ofile->sf.object_name = NULL;
+	    if(ofile->stream_eof)
+		break;
+	}
+	free(done);
+	free(selected);
+	return(result);
+}
+
+/*
+ * stream_object extracts the sections from the object of size bytes at the
+ * current position of the input stream, of which the magic number has already
+ * been read.  The mach header and load commands are read into memory and
+ * checked by map_object() like those of a mapped object.  It returns -1 if the
+ * object could not be operated on.
+ */
+static
+int
+stream_object(
+struct ofile *ofile,
+uint32_t *magic,
+uint64_t size)
+{
+    uint32_t sizeofcmds;
+    uint64_t header_size;
+    char *header;
+    int result;
+
+	if(*magic == MH_MAGIC || *magic == SWAP_INT(MH_MAGIC))
+	    header_size = sizeof(struct mach_header);
+	else if(*magic == MH_MAGIC_64 || *magic == SWAP_INT(MH_MAGIC_64))
+	    header_size = sizeof(struct mach_header_64);
+	else{
+	    error("bad magic number (file is not a Mach-O file) in: %s",
+		  ofile->sf.object_name);
+	    return(-1);
+	}
+	if(header_size > size){
+	    error("truncated or malformed object (mach header would extend "
+		  "past the end of the file) in: %s", ofile->sf.object_name);
+	    return(-1);
+	}
+	/* sizeofcmds is at the same place in both mach headers */
+	header = allocate(header_size);
+	memcpy(header, magic, sizeof(uint32_t));
+	if(stream_read(ofile, header + sizeof(uint32_t),
+		       header_size - sizeof(uint32_t)) == -1){
+	    free(header);
+	    return(-1);
+	}
+	memcpy(&sizeofcmds, header + offsetof(struct mach_header, sizeofcmds),
+	       sizeof(uint32_t));
+	if(*magic == SWAP_INT(MH_MAGIC) || *magic == SWAP_INT(MH_MAGIC_64))
+	    sizeofcmds = SWAP_INT(sizeofcmds);
+	if(sizeofcmds > size - header_size){
+	    error("truncated or malformed object (load commands would "
+		  "extend past the end of the file) in: %s",
+		  ofile->sf.object_name);
+	    free(header);
+	    return(-1);
+	}
+	header = reallocate(header, header_size + sizeofcmds);
+	if(stream_read(ofile, header + header_size, sizeofcmds) == -1){
+	    free(header);
+	    return(-1);
+	}
+	header_size += sizeofcmds;
+
+	ofile->nranges = 0;
+	result = 0;
+	if(map_object(ofile, header, size) == -1 ||
+	   (ofile->sf.fat_archs == NULL && check_arch_flags(ofile) == -1))
+	    result = -1;
+	else{
+	    if(extract_sections(ofile) == -1)
+		result = -1;
+	    if(stream_sections(ofile, header, header_size) == -1)
+		result = -1;
+	}
+	free(header);
+	return(result);
+}
+
+/*
+ * stream_sections copies the section contents in the ranges recorded by
+ * extract_section() to their output files as the object is read from the
+ * input stream, which is positioned just after the header_size bytes of
+ * the mach header and load commands at header.  Bytes before that are taken
+ * from header.  Each chunk of the object is written to all the output files
+ * whose range it is in, so overlapping and duplicate sections are read once.
+ * When only one output file is written to the kernel moves the bytes with
+ * splice(2) if it can.  Tar archive entries are gathered and written whole
+ * once their section is read.  It returns -1 if any of the sections could
+ * not be written.
+ */
+static
+int
+stream_sections(
+struct ofile *ofile,
+char *header,
+uint64_t header_size)
+{
+    uint32_t i, next, nactive, last;
+    uint64_t pos, end, len;
+    ssize_t n;
+    char *buf;
+    int result;
+    struct stream_range *rp;
+    loff_t splice_len;
+    uint64_t start, object_offset;
+
+	/* where the object starts in the input file, for -hash */
+	object_offset = ofile->stream_pos - header_size;
+	qsort(ofile->ranges, ofile->nranges, sizeof(struct stream_range),
+	      compare_stream_ranges);
+	result = 0;
+	pos = 0;
+	next = 0;
+	nactive = 0;
+	for(;;){
+	    /* open the output files of the ranges that start here */
+	    for( ; next < ofile->nranges &&
+		   ofile->ranges[next].offset <= pos; next++){
+		rp = ofile->ranges + next;
+		rp->filename = output_filename(ofile, rp->ep, rp->segname,
+					       rp->sectname);
+		rp->start = phase_begin();
+		if(tar_fd != -1){
+		    rp->tar = 1;
+		    if(rp->size <= TAR_BUFFER_MAX)
+			rp->tar_buf = allocate(rp->size);
+		    else if((rp->fd = create_temporary()) == -1){
+			error("can't create a temporary file for section "
+			      "(%s,%s) of: %s (%s)", rp->segname, rp->sectname,
+			      ofile->sf.object_name, strerror(errno));
+			rp->failed = 1;
+			result = -1;
+		    }
+		}
+		else if(hash_file != NULL)
+		    rp->hash = new_hash(rp->segname, rp->sectname,
+					object_offset + rp->offset, rp->size);
+		else{
+		    rp->fd = create_output(rp->filename);
+		    if(rp->fd == -1){
+			error("can't create: %s", rp->filename);
+			rp->failed = 1;
+			result = -1;
+		    }
+		    else if(compress_format != COMPRESS_NONE &&
+			    (rp->cs = compress_stream_open(compress_format)) ==
+			    NULL){
+			error("can't compress: %s (%s)", rp->filename,
+			      strerror(errno));
+			rp->failed = 1;
+			result = -1;
+		    }
+		    else if(decompress &&
+			    (rp->ds = decompress_stream_open()) == NULL)
+			fatal("virtual memory exhausted (calloc failed)");
+		}
+		phase_end(ofile, PHASE_CREATE, rp->start, 0);
+		nactive++;
+	    }
+	    /* close the output files of the ranges that end here */
+	    for(i = 0; i < next; i++){
+		rp = ofile->ranges + i;
+		if(rp->filename == NULL || rp->offset + rp->size > pos)
+		    continue;
+		if(rp->cs != NULL){
+		    if(compress_stream_close(rp->cs,
+					     rp->failed ? -1 : rp->fd) == -1 &&
+		       rp->failed == 0){
+			error("can't write: %s (%s)", rp->filename,
+			      strerror(errno));
+			rp->failed = 1;
+			result = -1;
+		    }
+		    rp->cs = NULL;
+		}
+		if(rp->ds != NULL){
+		    if(decompress_stream_close(rp->ds, rp->failed ? -1 : rp->fd,
+					       NULL) == -1 && rp->failed == 0){
+			error("section (%s,%s) of: %s is corrupt (can't "
+			      "decompress it to: %s)", rp->segname,
+			      rp->sectname, ofile->sf.object_name,
+			      rp->filename);
+			rp->failed = 1;
+			result = -1;
+		    }
+		    rp->ds = NULL;
+		}
+		if(rp->hash != NULL){
+		    print_hash(ofile, rp->hash);
+		    trace_section(ofile, rp->segname, rp->sectname, hash_name,
+				  rp->start, rp->size);
+		    free(rp->hash);
+		    rp->hash = NULL;
+		}
+		else if(rp->tar){
+		    if(rp->failed == 0)
+			write_stream_entry(ofile, rp);
+		    free(rp->tar_buf);
+		    rp->tar_buf = NULL;
+		    if(rp->fd != -1)
+			close(rp->fd);
+		}
+		else if(rp->fd != -1 && close(rp->fd) == -1){
+		    error("can't close: %s", rp->filename);
+		    result = -1;
+		}
+		else if(rp->fd != -1 && rp->failed == 0 && store_dir != NULL &&
+			store_output(ofile, rp->filename) == -1)
+		    result = -1;
+		if((rp->fd != -1 || rp->tar) && rp->failed == 0)
+		    trace_section(ofile, rp->segname, rp->sectname,
+				  rp->tar ? tar_name : rp->filename,
+				  rp->start, rp->size);
+		free(rp->filename);
+		rp->filename = NULL;
+		rp->fd = -1;
+		nactive--;
+	    }
+	    if(nactive == 0 && next == ofile->nranges)
+		break;
+
+	    /* the next chunk ends where a range starts or ends */
+	    end = next < ofile->nranges ? ofile->ranges[next].offset :
+					  UINT64_MAX;
+	    last = 0;
+	    for(i = 0; i < next; i++){
+		rp = ofile->ranges + i;
+		if(rp->filename != NULL && rp->offset + rp->size < end)
+		    end = rp->offset + rp->size;
+		if(rp->filename != NULL)
+		    last = i;
+	    }
+	    if(pos < header_size && end > header_size)
+		end = header_size;
+
+	    if(nactive == 0){
+		if(pos >= header_size && stream_skip(ofile, end - pos) == -1)
+		    break;
+		pos = end;
+		continue;
+	    }
+	    if(pos < header_size){
+		buf = header + pos;
+		len = end - pos;
+	    }
+	    else{
+		len = end - pos;
+		rp = ofile->ranges + last;
+		if(nactive == 1 && ofile->stream_splice && rp->fd != -1 &&
+		   rp->cs == NULL && rp->ds == NULL && rp->failed == 0){
+		    splice_len = len > SSIZE_MAX ? SSIZE_MAX : len;
+		    start = phase_begin();
+		    n = splice(ofile->sf.file_fd, NULL, rp->fd, NULL,
+			       splice_len, SPLICE_F_MOVE);
+		    phase_end(ofile, PHASE_COPY, start, n > 0 ? n : 0);
+		    if(n > 0){
+			ofile->stream_pos += n;
+			pos += n;
+			continue;
+		    }
+		    if(n == -1 && errno == EINTR)
+			continue;
+		    /*
+		     * Anything else, like the input not being a pipe, leaves
+		     * the bytes to be read and written below.
+		     */
+		    ofile->stream_splice = 0;
+		}
+		if(len > STREAM_BUFSIZE)
+		    len = STREAM_BUFSIZE;
+		buf = ofile->stream_buf;
+		if(stream_read(ofile, buf, len) == -1)
+		    break;
+	    }
+	    for(i = 0; i < next; i++){
+		rp = ofile->ranges + i;
+		if(rp->filename != NULL && rp->hash != NULL){
+		    start = phase_begin();
+		    sha256_update(&rp->hash->sha256, buf, len);
+		    xxh64_update(&rp->hash->xxh64, buf, len);
+		    phase_end(ofile, PHASE_HASH, start, len);
+		    continue;
+		}
+		if(rp->filename != NULL && rp->tar_buf != NULL){
+		    memcpy(rp->tar_buf + (pos - rp->offset), buf, len);
+		    continue;
+		}
+		if(rp->filename == NULL || rp->fd == -1 || rp->failed)
+		    continue;
+		start = phase_begin();
+		if(rp->cs != NULL)
+		    n = compress_stream_write(rp->cs, rp->fd, buf, len);
+		else if(rp->ds != NULL)
+		    n = decompress_stream_write(rp->ds, rp->fd, buf, len);
+		else
+		    n = write_all(rp->fd, buf, len);
+		phase_end(ofile, PHASE_COPY, start, len);
+		if(n == -1){
+		    if(rp->tar){
+			error("can't write the temporary file for section "
+			      "(%s,%s) of: %s (%s)", rp->segname, rp->sectname,
+			      ofile->sf.object_name, strerror(errno));
+		    }
+		    else if(errno == EILSEQ){
+			error("section (%s,%s) of: %s is corrupt (can't "
+			      "decompress it to: %s)", rp->segname,
+			      rp->sectname, ofile->sf.object_name,
+			      rp->filename);
+		    }
+		    else{
+			error("can't write: %s (%s)", rp->filename,
+			      strerror(errno));
+		    }
+		    rp->failed = 1;
+		    result = -1;
+		}
+	    }
+	    pos += len;
+	}
+
+	/*
+	 * After an error reading the input close what is still open.  Tar
+	 * archive entries that are cut short are not written.
+	 */
+	for(i = 0; i < ofile->nranges; i++){
+	    rp = ofile->ranges + i;
+	    if(rp->filename == NULL)
+		continue;
+	    if(rp->cs != NULL)
+		compress_stream_close(rp->cs, -1);
+	    if(rp->ds != NULL)
+		decompress_stream_close(rp->ds, -1, NULL);
+	    if(rp->fd != -1)
+		close(rp->fd);
+	    free(rp->hash);
+	    free(rp->tar_buf);
+	    free(rp->filename);
+	    result = -1;
+	}
+	ofile->nranges = 0;
+	return(result);
+}
+
+/*
+ * write_stream_entry writes the tar archive entry of a section read from a
+ * stream, whose contents are gathered in tar_buf or the temporary file, with
+ * tar_lock held.  The temporary file is read back through the stream buffer,
+ * which is not in use between the chunks of the input.
+ */
+static
+void
+write_stream_entry(
+struct ofile *ofile,
+struct stream_range *rp)
+{
+    uint64_t start, left;
+    ssize_t n;
+
+	pthread_mutex_lock(&tar_lock);
+	tar_begin_entry(ofile, rp->segname, rp->sectname, rp->size);
+	start = phase_begin();
+	if(rp->fd == -1){
+	    if(write_all(tar_fd, rp->tar_buf, rp->size) == -1)
+		fatal("can't write: %s (%s)", tar_name, strerror(errno));
+	}
+	else{
+	    if(lseek(rp->fd, 0, SEEK_SET) == -1)
+		fatal("can't read the temporary file for section (%s,%s) of: "
+		      "%s (%s)", rp->segname, rp->sectname,
+		      ofile->sf.object_name, strerror(errno));
+	    left = rp->size;
+	    while(left != 0){
+		n = read(rp->fd, ofile->stream_buf,
+			 left < STREAM_BUFSIZE ? left : STREAM_BUFSIZE);
+		if(n == -1 && errno == EINTR)
+		    continue;
+		if(n <= 0)
+		    fatal("can't read the temporary file for section (%s,%s) "
+			  "of: %s (%s)", rp->segname, rp->sectname,
+			  ofile->sf.object_name,
+			  n == 0 ? "end of file" : strerror(errno));
+		if(write_all(tar_fd, ofile->stream_buf, n) == -1)
+		    fatal("can't write: %s (%s)", tar_name, strerror(errno));
+		left -= n;
+	    }
+	}
+	phase_end(ofile, PHASE_COPY, start, rp->size);
+	tar_end_entry(rp->size);
+	pthread_mutex_unlock(&tar_lock);
+}
+
+/*
+ * Function for qsort for comparing two stream ranges by their offsets.
+ */
+static
+int
+compare_stream_ranges(
+const void *p1,
+const void *p2)
+{
+    const struct stream_range *r1, *r2;
+
+	r1 = p1;
+	r2 = p2;
+	if(r1->offset < r2->offset)
+	    return(-1);
+	if(r1->offset > r2->offset)
+	    return(1);
+	return(0);
+}
+
+/*
+ * stream_read reads size bytes from the input stream into buf.  It returns -1
+ * and prints an error if they can't be read.
+ */
+static
+int
+stream_read(
+struct ofile *ofile,
+char *buf,
+uint64_t size)
+{
+    ssize_t n;
+    uint64_t start;
+
+	while(size != 0){
+	    start = phase_begin();
+	    n = read(ofile->sf.file_fd, buf,
+		     size > SSIZE_MAX ? SSIZE_MAX : size);
+	    phase_end(ofile, PHASE_READ, start, n > 0 ? n : 0);
+	    if(n == -1 && errno == EINTR)
+		continue;
+	    if(n == -1){
+		error("can't read input file: %s (%s)", ofile->sf.file_name,
+		      strerror(errno));
+		return(-1);
+	    }
+	    if(n == 0){
+		ofile->stream_eof = 1;
+		error("truncated or malformed object (unexpected end of file) "
+		      "in: %s", ofile->sf.object_name != NULL ?
+		      ofile->sf.object_name : ofile->sf.file_name);
+		return(-1);
+	    }
+	    buf += n;
+	    size -= n;
+	    ofile->stream_pos += n;
+	}
+	return(0);
+}
+
+/*
+ * stream_skip reads past size bytes of the input stream.  It returns -1 and
+ * prints an error if they can't be read.
+ */
+static
+int
+stream_skip(
+struct ofile *ofile,
+uint64_t size)
+{
+    uint64_t len;
+
+	while(size != 0){
+	    len = size > STREAM_BUFSIZE ? STREAM_BUFSIZE : size;
+	    if(stream_read(ofile, ofile->stream_buf, len) == -1)
+		return(-1);
+	    size -= len;
+	}
+	return(0);
+}
+
+/*
+ * use_cache looks up the section tables of the mapped input file in the
+ * -cache-dir directory, and adds them there if they are not.  The time is
+ * counted as parsing.  A cache that can't be written is warned about, and the
+ * input file is then operated on without it.  Without -cache-dir it does
+ * nothing.
+ */
+void
+use_cache(
+struct ofile *ofile)
+{
+    uint64_t start;
+    enum segedit_error status;
+
+	if(cache_dir == NULL)
+	    return;
+	start = phase_begin();
+	status = segedit_use_cache(&ofile->sf, cache_dir);
+	phase_end(ofile, PHASE_PARSE, start, 0);
+	if(status != SEGEDIT_OK)
+	    print_error(ofile);
+}
+
+/*
+ * map_object checks the object of the specified size at the specified address
+ * in the mapped input file, or in a copy of its headers when the input file is
+ * read as a stream, with segedit_map_object().  It returns -1 and prints an
+ * error if the object is malformed.
+ */
+static
+int
+map_object(
+struct ofile *ofile,
+char *addr,
+uint64_t size)
+{
+    uint64_t start;
+    enum segedit_error status;
+
+	start = phase_begin();
+	status = segedit_map_object(&ofile->sf, addr, size);
+	return(mapped_object(ofile, start, status));
+}
+
+/*
+ * map_arch checks the i'th object of the mapped input file like map_object(),
+ * or takes it from the cache if there is one.
+ */
+int
+map_arch(
+struct ofile *ofile,
+uint32_t i)
+{
+    uint64_t start;
+    enum segedit_error status;
+
+	start = phase_begin();
+	status = segedit_map_arch(&ofile->sf, i);
+	if(status == SEGEDIT_OK && ofile->sf.cache_mapped)
+	    ofile->ncached++;
+	return(mapped_object(ofile, start, status));
+}
+
+/*
+ * mapped_object finishes map_object() and map_arch(), which started at start
+ * and returned status.  It returns -1 and prints an error if the object is
+ * malformed.
+ */
+static
+int
+mapped_object(
+struct ofile *ofile,
+uint64_t start,
+enum segedit_error status)
+{
+	phase_end(ofile, PHASE_PARSE, start, status != SEGEDIT_OK ? 0 :
+		  (ofile->sf.mhp64 != NULL ? ofile->sf.mhp64->sizeofcmds :
+					     ofile->sf.mhp->sizeofcmds));
+	if(status != SEGEDIT_OK){
+	    print_error(ofile);
+	    return(-1);
+	}
+	if(ofile->sf.warning[0] != '\0')
+	    error("%s", ofile->sf.warning);
+	ofile->nobjects++;
+	ofile->nswapped += ofile->sf.swapped;
+	return(0);
+}
+
+/*
+ * This routine extracts the sections in the extracts list from the object
+ * and writes then to the file specified in the list.  Each section is looked
+ * up in the hash table of the extract structures, and the load commands are
+ * no longer walked once all of them are found.  The found flags of extract
+ * structures whose names are patterns are never set, so with those all the
+ * load commands are walked, and it is no error if they match no section.  The
+ * symbols of -extract-symbol are extracted after the walk.  It returns -1 if
+ * any of them could not be extracted.
+ */
+static
+int
+extract_sections(
+struct ofile *ofile)
+{
+    int result;
+    uint64_t start, nested;
+    struct extract *ep;
+
+	memset(ofile->found, '\0', nextracts);
+	ofile->nfound = 0;
+	ofile->extract_result = 0;
+
+	/* the time of the phases within the walk is not counted in it */
+	start = phase_begin();
+	nested = ofile->stats[PHASE_CREATE].time +
+		 ofile->stats[PHASE_COPY].time;
+	segedit_sections(&ofile->sf, extract_matching, ofile);
+	nested = ofile->stats[PHASE_CREATE].time +
+		 ofile->stats[PHASE_COPY].time - nested;
+	phase_end(ofile, PHASE_WALK, start + nested, 0);
+	if(nsymbols != 0)
+	    extract_symbols(ofile);
+	if(ofile->hashes != NULL)
+	    finish_hashes(ofile);
+	if(ofile->inflates != NULL)
+	    finish_inflates(ofile);
+
+	result = ofile->extract_result;
+	ep = extracts;
+	while(ep != NULL){
+	    if(ep->match == MATCH_EXACT && ep->symbol == NULL &&
+	       ofile->found[ep->index] == 0){
+		error("section (%s,%s) not found in: %s", ep->segname,
+		      ep->sectname, ofile->sf.object_name);
+		result = -1;
+	    }
+	    ep = ep->next;
+	}
+	return(result);
+}
+
+/*
+ * extract_matching is called by segedit_sections() for each section of the
+ * object.  It extracts the section for the extract structures with its names
+ * and those whose patterns match its names.  In a tar archive a section only
+ * makes one entry, however many extract structures it is for.  It sets
+ * extract_result to -1 if the section could not be extracted, and stops the
+ * walk once all the extract structures are found.
+ */
+static
+int
+extract_matching(
+void *arg,
+const struct segedit_section *section)
+{
+    struct ofile *ofile;
+    uint32_t i;
+    int matched;
+    struct section_key key;
+    struct extract *ep;
+
+	ofile = arg;
+	make_section_key(&key, section->sectname, section->segname);
+	matched = 0;
+	if((ep = lookup_extract(&key)) != NULL){
+	    if(extract_section(ofile, ep, section) == -1)
+		ofile->extract_result = -1;
+	    matched = 1;
+	}
+	if(npatterns != 0 && (matched == 0 || single_entry == 0)){
+	    for(i = 0; i < npatterns; i++){
+		if(match_extract(patterns[i], section->segname,
+				 section->sectname) == 0)
+		    continue;
+		if(extract_section(ofile, patterns[i], section) == -1)
+		    ofile->extract_result = -1;
+		if(single_entry)
+		    break;
+	    }
+	}
+	return(ofile->nfound == nextracts - nsymbols);
+}
+
+/*
+ * extract_section writes the contents of the section to the files of the
+ * extract structures chained off ep, which have the section's names or
+ * patterns that match them.  Like before, only the first section with the
+ * names is extracted for exact names.  Zero fill sections are silently
+ * skipped for patterns.  When the input file is read as a stream the ranges to
+ * copy are only recorded.
+ */
+static
+int
+extract_section(
+struct ofile *ofile,
+struct extract *ep,
+const struct segedit_section *section)
+{
+    int fd, result;
+    char *filename, *objname;
+    uint64_t offset, size, start, copy_start, close_start;
+    struct extract *same;
+    struct stream_range *rp;
+
+	if(ep->match == MATCH_EXACT){
+	    if(ofile->found[ep->index] != 0)
+		return(0);
+	    for(same = ep; same != NULL; same = same->same){
+		ofile->found[same->index] = 1;
+		ofile->nfound++;
+	    }
+	}
+	offset = section->offset;
+	size = section->size;
+
+	result = 0;
+	if(is_zerofill(section->flags)){
+	    if(ep->match != MATCH_EXACT)
+		return(0);
+	    error("meaningless to extract zero fill section (%s,%s) in: %s",
+		  section->segname, section->sectname, ofile->sf.object_name);
+	    return(-1);
+	}
+	if(offset > ofile->sf.object_size ||
+	   size > ofile->sf.object_size - offset){
+	    error("truncated or malformed object (section contents of "
+		  "(%s,%s) extends past the end of the file) in: %s",
+		  section->segname, section->sectname, ofile->sf.object_name);
+	    return(-1);
+	}
+	/*
+	 * From a stream the contents are copied later, in stream_sections().
+	 * In a tar archive extract structures with the same names make one
+	 * entry.
+	 */
+	if(ofile->streaming){
+	    for( ; ep != NULL; ep = single_entry == 0 ? ep->same : NULL){
+		if(ofile->nranges == ofile->maxranges){
+		    ofile->maxranges = ofile->maxranges == 0 ? 16 :
+				       ofile->maxranges * 2;
+		    ofile->ranges = reallocate(ofile->ranges,
+			ofile->maxranges * sizeof(struct stream_range));
+		}
+		rp = ofile->ranges + ofile->nranges++;
+		memset(rp, '\0', sizeof(struct stream_range));
+		rp->offset = offset;
+		rp->size = size;
+		rp->ep = ep;
+		strcpy(rp->segname, section->segname);
+		strcpy(rp->sectname, section->sectname);
+		rp->fd = -1;
+	    }
+	    return(0);
+	}
+	if(hash_file != NULL){
+	    add_hash(ofile, section, offset, size);
+	    return(0);
+	}
+	if(tar_fd != -1){
+	    pthread_mutex_lock(&tar_lock);
+	    start = phase_begin();
+	    tar_begin_entry(ofile, section->segname, section->sectname, size);
+	    phase_end(ofile, PHASE_CREATE, start, 0);
+	    copy_start = phase_begin();
+	    if(copy_section(ofile, tar_fd, offset, size) == -1)
+		fatal("can't write: %s (%s)", tar_name, strerror(errno));
+	    phase_end(ofile, PHASE_COPY, copy_start, size);
+	    tar_end_entry(size);
+	    pthread_mutex_unlock(&tar_lock);
+	    trace_section(ofile, section->segname, section->sectname, tar_name,
+			  start, size);
+	    return(0);
+	}
+	/* with -store the section is written once, and linked to each file */
+	objname = NULL;
+	if(store_dir != NULL &&
+	   (objname = store_section(ofile, offset, size)) == NULL)
+	    return(-1);
+	for( ; ep != NULL; ep = ep->same){
+	    filename = output_filename(ofile, ep, section->segname,
+				       section->sectname);
+	    start = phase_begin();
+	    if(objname != NULL){
+		if(link_output(objname, filename) == -1 &&
+		   clone_output(ofile, objname, filename, offset, size) == -1)
+		    result = -1;
+		phase_end(ofile, PHASE_CREATE, start, 0);
+		trace_section(ofile, section->segname, section->sectname,
+			      filename, start, size);
+	    }
+	    else if((fd = create_output(filename)) == -1){
+		phase_end(ofile, PHASE_CREATE, start, 0);
+		error("can't create: %s", filename);
+		result = -1;
+	    }
+	    else if(decompress &&
+		    decompress_format(ofile->sf.object_addr + offset, size) !=
+		    DECOMPRESS_RAW){
+		phase_end(ofile, PHASE_CREATE, start, 0);
+		add_inflate(ofile, section, offset, size, fd, filename, start);
+		continue;
+	    }
+	    else{
+		phase_end(ofile, PHASE_CREATE, start, 0);
+		copy_start = phase_begin();
+		if((compress_format != COMPRESS_NONE ?
+		    compress_write(compress_format, wq, fd,
+				   ofile->sf.object_addr + offset, size) :
+		    copy_section(ofile, fd, offset, size)) == -1){
+		    error("can't write: %s (%s)", filename, strerror(errno));
+		    result = -1;
+		}
+		phase_end(ofile, PHASE_COPY, copy_start, size);
+		close_start = phase_begin();
+		if(close(fd) == -1){
+		    error("can't close: %s", filename);
+		    result = -1;
+		}
+		/* closing is counted as part of creating */
+		ofile->stats[PHASE_CREATE].time += phase_begin() - close_start;
+		trace_section(ofile, section->segname, section->sectname,
+			      filename, start, size);
+	    }
+	    free(filename);
+	}
+	free(objname);
+	return(result);
+}
+
+/*
+ * extract_symbols extracts the symbols of the -extract-symbol extract
+ * structures from the object, each as if it were a section from its address
+ * up to the next symbol in its section.  Symbols in zero fill sections have
+ * no contents and are an error.  The symbol index is built for the object
+ * once, however many symbols are looked up in it.  It sets
+ * extract_result to -1 if any of them could not be extracted.
+ */
+static
+void
+extract_symbols(
+struct ofile *ofile)
+{
+    uint64_t start;
+    struct extract *ep;
+    struct symbol_index si;
+    struct symbol *sp;
+    struct segedit_section section;
+
+	if(ofile->streaming){
+	    error("can't extract symbols from: %s (not a regular file)",
+		  ofile->sf.object_name);
+	    ofile->extract_result = -1;
+	    return;
+	}
+	start = phase_begin();
+	if(build_symbol_index(ofile, &si, 1) == -1){
+	    phase_end(ofile, PHASE_PARSE, start, 0);
+	    ofile->extract_result = -1;
+	    return;
+	}
+	phase_end(ofile, PHASE_PARSE, start, 0);
+
+	for(ep = extracts; ep != NULL; ep = ep->next){
+	    if(ep->symbol == NULL)
+		continue;
+	    if((sp = lookup_symbol(&si, ep->symbol)) == NULL){
+		error("symbol %s not found in: %s", ep->symbol,
+		      ofile->sf.object_name);
+		ofile->extract_result = -1;
+		continue;
+	    }
+	    section = si.sections[sp->sect - 1];
+	    if(is_zerofill(section.flags)){
+		error("symbol %s is in zero fill section (%s,%s), which has no "
+		      "contents to extract, in: %s", ep->symbol,
+		      section.segname, section.sectname, ofile->sf.object_name);
+		ofile->extract_result = -1;
+		continue;
+	    }
+	    section.offset += sp->value - section.addr;
+	    section.addr = sp->value;
+	    section.size = symbol_size(&si, sp);
+	    section.contents = NULL;
+	    section.header = NULL;
+	    if(extract_section(ofile, ep, &section) == -1)
+		ofile->extract_result = -1;
+	}
+	free_symbol_index(&si);
+}
+
+/*
+ * copy_section writes size bytes at offset in the object to the output file
+ * at its current position, with copy_input().
+ */
+int
+copy_section(
+struct ofile *ofile,
+int fd,
+uint64_t offset,
+uint64_t size)
+{
+	return(copy_input(ofile, fd, (ofile->sf.object_addr -
+				      ofile->sf.file_addr) + offset, size));
+}
+
+/*
+ * copy_input writes size bytes at offset in the input file to the output file
+ * at its current position.  The bytes are not copied through user space when
+ * that can be avoided: if the range is block aligned the output file shares
+ * the input file's blocks (FICLONERANGE), otherwise the kernel copies them
+ * with copy_file_range(2), which itself may clone or copy on the server, or
+ * with sendfile(2) when the output is a pipe.  Only when none of these works
+ * the bytes are written from the mapped input file.
+ * It returns -1 with errno set if the bytes can't be written.
+ */
+int
+copy_input(
+struct ofile *ofile,
+int fd,
+uint64_t offset,
+uint64_t size)
+{
+    loff_t in_offset, out_offset;
+    ssize_t n;
+    size_t len;
+#ifdef FICLONERANGE
+    struct file_clone_range clone_range;
+#endif
+
+	in_offset = offset;
+	out_offset = lseek(fd, 0, SEEK_CUR);
+
+#ifdef FICLONERANGE
+	/*
+	 * Cloning needs the offsets block aligned, and the size too unless the
+	 * range goes up to the end of the input file.
+	 */
+	if(out_offset != -1 && size != 0 && ofile->sf.file_blksize != 0 &&
+	   in_offset % ofile->sf.file_blksize == 0 &&
+	   out_offset % ofile->sf.file_blksize == 0 &&
+	   (size % ofile->sf.file_blksize == 0 ||
+	    in_offset + size == ofile->sf.file_size)){
+	    clone_range.src_fd = ofile->sf.file_fd;
+	    clone_range.src_offset = in_offset;
+	    clone_range.src_length = size;
+	    clone_range.dest_offset = out_offset;
+	    if(ioctl(fd, FICLONERANGE, &clone_range) == 0 &&
+	       lseek(fd, out_offset + size, SEEK_SET) != -1)
+		return(0);
+	}
+#endif
+
+	while(size != 0 && out_offset != -1 && have_copy_file_range){
+	    len = size > SSIZE_MAX ? SSIZE_MAX : size;
+	    n = copy_file_range(ofile->sf.file_fd, &in_offset, fd, NULL, len,
+				0);
+	    if(n > 0){
+		size -= n;
+		continue;
+	    }
+	    if(n == -1 && errno == EINTR)
+		continue;
+	    if(n == -1 && errno == ENOSYS)
+		have_copy_file_range = 0;
+	    /*
+	     * Anything else (EXDEV, EINVAL, EOPNOTSUPP, or the input file
+	     * having shrunk) leaves the rest to be written below.
+	     */
+	    break;
+	}
+
+	/* sendfile(2) also copies in the kernel to pipes and sockets */
+	while(size != 0){
+	    len = size > SSIZE_MAX ? SSIZE_MAX : size;
+	    n = sendfile(fd, ofile->sf.file_fd, &in_offset, len);
+	    if(n > 0){
+		size -= n;
+		continue;
+	    }
+	    if(n == -1 && errno == EINTR)
+		continue;
+	    break;
+	}
+
+	return(write_all(fd, ofile->sf.file_addr + in_offset, size));
+}
+
+/*
+ * write_all writes the size bytes at buf to fd.  It returns -1 with errno set
+ * if they can't be written.
+ */
+static
+int
+write_all(
+int fd,
+const char *buf,
+uint64_t size)
+{
+    ssize_t n;
+
+	while(size != 0){
+	    n = write(fd, buf, size > SSIZE_MAX ? SSIZE_MAX : size);
+	    if(n == -1 && errno == EINTR)
+		continue;
+	    if(n <= 0){
+		if(n == 0)
+		    errno = EIO;
+		return(-1);
+	    }
+	    buf += n;
+	    size -= n;
+	}
+	return(0);
+}
+
+/*
+ * tar_begin_entry writes the header of the tar archive entry for the section
+ * of size bytes with the names, with tar_lock held.  The entry is
+ * named "<input file>/<segname>/<sectname>", with the architecture name
+ * appended when more than one object is operated on, and has the modification
+ * time of the input file.  tar_header() makes the name relative, so that an
+ * input file named with an absolute path or "../" is extracted under the
+ * current directory.
+ */
+static
+void
+tar_begin_entry(
+struct ofile *ofile,
+const char *segname,
+const char *sectname,
+uint64_t size)
+{
+    const char *input;
+    char *name, *header, seg[17], sect[17];
+    size_t len;
+
+	input = ofile->sf.file_name;
+	safe_name(seg, segname);
+	safe_name(sect, sectname);
+	len = strlen(input) + strlen(seg) + strlen(sect) + 3;
+	if(ofile->arch_suffix != NULL)
+	    len += strlen(ofile->arch_suffix) + 1;
+	name = allocate(len);
+	sprintf(name, "%s/%s/%s%s%s", input, seg, sect,
+		ofile->arch_suffix != NULL ? "." : "",
+		ofile->arch_suffix != NULL ? ofile->arch_suffix : "");
+	header = tar_header(name, size, 0644, ofile->sf.file_mtime, &len);
+	if(write_all(tar_fd, header, len) == -1)
+	    fatal("can't write: %s (%s)", tar_name, strerror(errno));
+	free(header);
+	free(name);
+}
+
+/*
+ * tar_end_entry pads the contents of the tar archive entry of size bytes to a
+ * whole block, with tar_lock held.
+ */
+static
+void
+tar_end_entry(
+uint64_t size)
+{
+	if(write_all(tar_fd, zero_blocks, tar_padding(size)) == -1)
+	    fatal("can't write: %s (%s)", tar_name, strerror(errno));
+}
+
+/*
+ * phase_begin returns the time a phase begins at, when the phases are timed.
+ */
+uint64_t
+phase_begin(void)
+{
+	return(timing ? trace_now() : 0);
+}
+
+/*
+ * phase_end adds the time since start, one call and the bytes to the
+ * statistics of the phase, when the phases are timed.
+ */
+void
+phase_end(
+struct ofile *ofile,
+enum phase phase,
+uint64_t start,
+uint64_t bytes)
+{
+	if(timing == 0)
+	    return;
+	ofile->stats[phase].time += trace_now() - start;
+	ofile->stats[phase].calls++;
+	ofile->stats[phase].bytes += bytes;
+}
+
+/*
+ * trace_section writes the -trace event of the section extracted to the
+ * output file from start on.
+ */
+static
+void
+trace_section(
+struct ofile *ofile,
+const char *segname,
+const char *sectname,
+const char *filename,
+uint64_t start,
+uint64_t size)
+{
+    char name[36];
+
+	if(trace_name == NULL)
+	    return;
+	sprintf(name, "%s,%s", segname, sectname);
+	trace_event("section", name, filename, start, trace_now(), size);
+}
+
+/*
+ * add_stats adds the statistics of the input file to the totals.
+ */
+static
+void
+add_stats(
+struct ofile *ofile)
+{
+    uint32_t i;
+
+	pthread_mutex_lock(&stats_lock);
+	for(i = 0; i < NPHASES; i++){
+	    total_stats[i].time += ofile->stats[i].time;
+	    total_stats[i].calls += ofile->stats[i].calls;
+	    total_stats[i].bytes += ofile->stats[i].bytes;
+	}
+	total_files++;
+	total_objects += ofile->nobjects;
+	total_swapped += ofile->nswapped;
+	total_cached += ofile->ncached;
+	total_stored += ofile->nstored;
+	total_linked += ofile->nlinked;
+	pthread_mutex_unlock(&stats_lock);
+}
+
+/*
+ * print_stats prints the -stats summary of the run, which took elapsed
+ * nanoseconds.  The time of each phase is added up over all the threads, so
+ * together they can take longer than the run.
+ */
+static
+void
+print_stats(
+uint64_t elapsed)
+{
+    uint32_t i;
+    double seconds;
+
+	fprintf(stderr, "%u input files, %u objects (%u swapped, %u cached) in "
+		"%.3f s with %u jobs\n", total_files, total_objects,
+		total_swapped, total_cached, elapsed / 1e9, njobs);
+	if(store_dir != NULL)
+	    fprintf(stderr, "%u sections written to the store, %u already in "
+		    "it\n", total_stored, total_linked);
+	fprintf(stderr, "%-8s %10s %10s %16s %10s\n", "phase", "time (s)",
+		"calls", "bytes", "MB/s");
+	for(i = 0; i < NPHASES; i++){
+	    if(total_stats[i].calls == 0)
+		continue;
+	    seconds = total_stats[i].time / 1e9;
+	    fprintf(stderr, "%-8s %10.3f %10llu %16llu", phase_names[i],
+		    seconds, (unsigned long long)total_stats[i].calls,
+		    (unsigned long long)total_stats[i].bytes);
+	    if(total_stats[i].bytes != 0 && seconds != 0)
+		fprintf(stderr, " %10.1f",
+			total_stats[i].bytes / seconds / 1e6);
+	    fprintf(stderr, "\n");
+	}
+}
+
+/*
+ * claim_input_name claims the base name of the input file, which is replaced
+ * for "%i" in the output file names.  It returns -1 and prints an error if
+ * another input file has already claimed it.
+ */
+static
+int
+claim_input_name(
+const char *file_name)
+{
+    struct input_name *in, **old;
+    const char *base;
+    uint32_t i, h, nold;
+
+	if((base = strrchr(file_name, '/')) != NULL)
+	    base++;
+	else
+	    base = file_name;
+	pthread_mutex_lock(&input_names_lock);
+	if(input_names == NULL){
+	    input_names_mask = 1023;
+	    input_names = allocate((input_names_mask + 1) *
+				   sizeof(struct input_name *));
+	    memset(input_names, '\0', (input_names_mask + 1) *
+		   sizeof(struct input_name *));
+	}
+	h = hash_symbol_name(base);
+	for(in = input_names[h & input_names_mask]; in != NULL; in = in->next){
+	    if(strcmp(in->base, base) == 0){
+		pthread_mutex_unlock(&input_names_lock);
+		error("input files: %s and %s have the same base name, so they "
+		      "would write the same output files (%%i)", in->name,
+		      file_name);
+		return(-1);
+	    }
+	}
+
+	/* keep the hash chains short as the bundle directories are searched */
+	if(ninput_names > 2 * input_names_mask){
+	    old = input_names;
+	    nold = input_names_mask + 1;
+	    input_names_mask = 2 * nold - 1;
+	    input_names = allocate(2 * nold * sizeof(struct input_name *));
+	    memset(input_names, '\0', 2 * nold * sizeof(struct input_name *));
+	    for(i = 0; i < nold; i++){
+		while((in = old[i]) != NULL){
+		    old[i] = in->next;
+		    h = hash_symbol_name(in->base) & input_names_mask;
+		    in->next = input_names[h];
+		    input_names[h] = in;
+		}
+	    }
+	    free(old);
+	    h = hash_symbol_name(base);
+	}
+	in = allocate(sizeof(struct input_name));
+	in->name = strdup(file_name);
+	in->base = in->name + (base - file_name);
+	in->next = input_names[h & input_names_mask];
+	input_names[h & input_names_mask] = in;
+	ninput_names++;
+	pthread_mutex_unlock(&input_names_lock);
+	return(0);
+}
+
+/*
+ * template_has returns 1 if the output file name template has the conversion
+ * "%c", which "%%" (a literal "%") never starts.
+ */
+static
+int
+template_has(
+const char *template,
+char c)
+{
+    const char *p;
+
+	for(p = template; *p != '\0'; p++){
+	    if(p[0] != '%' || p[1] == '\0')
+		continue;
+	    if(p[1] == c)
+		return(1);
+	    p++;
+	}
+	return(0);
+}
+
+/*
+ * output_filename returns the allocated name of the file to write a section to
+ * for the extract structure.  Its file name is a template in which "%i" is
+ * replaced with the base name of the input file, "%s" with the section's
+ * segment name, "%c" with its section name, "%a" with the architecture name of
+ * the object and "%%" with a single "%".  When more than one object is
+ * operated on and there is no "%a" the architecture name is appended.  With
+ * -compress the suffix of the compression format is appended last.
+ */
+static
+char *
+output_filename(
+struct ofile *ofile,
+struct extract *ep,
+const char *segname,
+const char *sectname)
+{
+    const char *p, *base, *value;
+    char *filename, seg[17], sect[17];
+    size_t len, n;
+    int pass, has_arch;
+
+	if((base = strrchr(ofile->sf.file_name, '/')) != NULL)
+	    base++;
+	else
+	    base = ofile->sf.file_name;
+	safe_name(seg, segname);
+	safe_name(sect, sectname);
+
+	/* the first pass counts the length, the second fills in the name */
+	filename = NULL;
+	len = 0;
+	has_arch = 0;
+	for(pass = 0; pass < 2; pass++){
+	    n = 0;
+	    for(p = ep->filename; *p != '\0'; p++){
+		value = NULL;
+		if(p[0] == '%'){
+		    switch(p[1]){
+		    case 'i': value = base; break;
+		    case 's': value = seg; break;
+		    case 'c': value = sect; break;
+		    case 'a':
+			value = ofile->arch_suffix != NULL ?
+				ofile->arch_suffix : ofile->sf.arch_name;
+			has_arch = 1;
+			break;
+		    case '%': value = "%"; break;
+		    }
+		}
+		if(value != NULL){
+		    if(filename != NULL)
+			strcpy(filename + n, value);
+		    n += strlen(value);
+		    p++;
+		}
+		else{
+		    if(filename != NULL)
+			filename[n] = *p;
+		    n++;
+		}
+	    }
+	    if(ofile->arch_suffix != NULL && has_arch == 0){
+		if(filename != NULL){
+		    filename[n] = '.';
+		    strcpy(filename + n + 1, ofile->arch_suffix);
+		}
+		n += strlen(ofile->arch_suffix) + 1;
+	    }
+	    if(compress_format != COMPRESS_NONE){
+		if(filename != NULL)
+		    strcpy(filename + n, compress_suffix(compress_format));
+		n += strlen(compress_suffix(compress_format));
+	    }
+	    if(filename == NULL){
+		len = n + 1;
+		filename = allocate(len);
+	    }
+	}
+	filename[len - 1] = '\0';
+	return(filename);
+}
+
+/*
+ * safe_name copies the 16 byte name of a segment or section to name, so that
+ * it can be used in a file name.  Slashes are replaced with underscores, as is
+ * the first dot of "." and "..".
+ */
+static
+void
+safe_name(
+char *name,
+const char *section_name)
+{
+    uint32_t i;
+
+	for(i = 0; i < 16 && section_name[i] != '\0'; i++)
+	    name[i] = section_name[i] == '/' ? '_' : section_name[i];
+	name[i] = '\0';
+	if(strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+	    name[0] = '_';
+}
+
+/*
+ * create_output creates the output file, and the directories it is in if they
+ * don't exist yet.  It returns the open file or -1 with errno set.
+ */
+int
+create_output(
+char *filename)
+{
+    int fd;
+
+	fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if(fd != -1 || errno != ENOENT)
+	    return(fd);
+	if(make_dirs(filename) == -1)
+	    return(-1);
+	return(open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666));
+}
+
+/*
+ * create_temporary creates a temporary file in $TMPDIR, or /tmp, and removes
+ * its name at once, so that it is gone when it is closed.  It returns the
+ * open file or -1 with errno set.
+ */
+static
+int
+create_temporary(void)
+{
+    const char *dir;
+    char *name;
+    int fd;
+
+	if((dir = getenv("TMPDIR")) == NULL || *dir == '\0')
+	    dir = "/tmp";
+	name = allocate(strlen(dir) + sizeof("/segedit.XXXXXX"));
+	sprintf(name, "%s/segedit.XXXXXX", dir);
+	if((fd = mkstemp(name)) != -1)
+	    unlink(name);
+	free(name);
+	return(fd);
+}
+
+/*
+ * make_dirs creates the directories the file is in if they don't exist yet.
+ * It returns -1 with errno set if they can't be created.
+ */
+int
+make_dirs(
+char *filename)
+{
+    char *p;
+
+	for(p = strchr(filename + 1, '/'); p != NULL; p = strchr(p + 1, '/')){
+	    *p = '\0';
+	    if(mkdir(filename, 0777) == -1 && errno != EEXIST){
+		*p = '/';
+		return(-1);
+	    }
+	    *p = '/';
+	}
+	return(0);
+}
+
+/*
+ * add_hash queues the hashing of size bytes at offset in the mapped object
+ * for -hash.  The digests are written to the manifest by finish_hashes(), in
+ * the order the sections were added.  Large sections have their SHA-256 and
+ * XXH64 computed by different threads.
+ */
+static
+void
+add_hash(
+struct ofile *ofile,
+const struct segedit_section *section,
+uint64_t offset,
+uint64_t size)
+{
+    struct section_hash *h;
+
+	h = new_hash(section->segname, section->sectname,
+		     (ofile->sf.object_addr - ofile->sf.file_addr) + offset,
+		     size);
+	h->contents = ofile->sf.object_addr + offset;
+	*ofile->hashes_tail = h;
+	ofile->hashes_tail = &h->next;
+	if(size >= HASH_SPLIT){
+	    workqueue_add(wq, &ofile->hash_group, hash_sha256, h);
+	    workqueue_add(wq, &ofile->hash_group, hash_xxh64, h);
+	}
+	else
+	    workqueue_add(wq, &ofile->hash_group, hash_contents, h);
+}
+
+/*
+ * new_hash returns a new section_hash for size bytes of the section at offset
+ * in the input file, with its digests started.
+ */
+static
+struct section_hash *
+new_hash(
+const char *segname,
+const char *sectname,
+uint64_t offset,
+uint64_t size)
+{
+    struct section_hash *h;
+
+	h = allocate(sizeof(struct section_hash));
+	memset(h, '\0', sizeof(struct section_hash));
+	strcpy(h->segname, segname);
+	strcpy(h->sectname, sectname);
+	h->offset = offset;
+	h->size = size;
+	sha256_init(&h->sha256);
+	xxh64_init(&h->xxh64, 0);
+	return(h);
+}
+
+/*
+ * hash_sha256, hash_xxh64 and hash_contents are the work items that compute
+ * the SHA-256, the XXH64 or both of the mapped section contents.  The time
+ * they take is added to the -stats by finish_hashes().
+ */
+static
+void
+hash_sha256(
+void *arg)
+{
+    struct section_hash *h;
+    uint64_t start;
+
+	h = arg;
+	start = phase_begin();
+	sha256_update(&h->sha256, h->contents, h->size);
+	h->time[0] = phase_begin() - start;
+}
+
+static
+void
+hash_xxh64(
+void *arg)
+{
+    struct section_hash *h;
+    uint64_t start;
+
+	h = arg;
+	start = phase_begin();
+	xxh64_update(&h->xxh64, h->contents, h->size);
+	h->time[1] = phase_begin() - start;
+}
+
+static
+void
+hash_contents(
+void *arg)
+{
+	hash_sha256(arg);
+	hash_xxh64(arg);
+}
+
+/*
+ * finish_hashes waits for the hashing of the sections of the object queued by
+ * add_hash(), and writes their digests to the manifest.
+ */
+static
+void
+finish_hashes(
+struct ofile *ofile)
+{
+    struct section_hash *h, *next;
+
+	workqueue_wait(wq, &ofile->hash_group);
+	for(h = ofile->hashes; h != NULL; h = next){
+	    next = h->next;
+	    if(timing){
+		ofile->stats[PHASE_HASH].time += h->time[0] + h->time[1];
+		ofile->stats[PHASE_HASH].calls++;
+		ofile->stats[PHASE_HASH].bytes += h->size;
+	    }
+	    print_hash(ofile, h);
+	    free(h);
+	}
+	ofile->hashes = NULL;
+	ofile->hashes_tail = &ofile->hashes;
+}
+
+/*
+ * print_hash finishes the digests of the section and writes its line to the
+ * manifest, which is: the input file name, the architecture name, the segment
+ * and section names, the offset and size of the contents in the input file,
+ * the SHA-256 and the XXH64, separated by tabs.
+ */
+static
+void
+print_hash(
+struct ofile *ofile,
+struct section_hash *h)
+{
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+    char hex[2 * SHA256_DIGEST_LENGTH + 1];
+    uint64_t xxh;
+    uint32_t i;
+
+	sha256_final(&h->sha256, digest);
+	xxh = xxh64_final(&h->xxh64);
+	for(i = 0; i < SHA256_DIGEST_LENGTH; i++)
+	    sprintf(hex + 2 * i, "%02x", digest[i]);
+	pthread_mutex_lock(&hash_lock);
+	fprintf(hash_file, "%s\t%s\t%s\t%s\t%llu\t%llu\t%s\t%016llx\n",
+		ofile->sf.file_name, ofile->sf.arch_name, h->segname,
+		h->sectname, (unsigned long long)h->offset,
+		(unsigned long long)h->size, hex, (unsigned long long)xxh);
+	pthread_mutex_unlock(&hash_lock);
+}
+
+/*
+ * add_inflate queues the inflating of size bytes at offset in the mapped
+ * object, which are compressed, to the open output file for -decompress.  The
+ * work item closes the output file, and the filename is freed by
+ * finish_inflates(), which waits for the work items of the object.
+ */
+static
+void
+add_inflate(
+struct ofile *ofile,
+const struct segedit_section *section,
+uint64_t offset,
+uint64_t size,
+int fd,
+char *filename,
+uint64_t start)
+{
+    struct inflate_job *job;
+
+	job = allocate(sizeof(struct inflate_job));
+	memset(job, '\0', sizeof(struct inflate_job));
+	job->ofile = ofile;
+	strcpy(job->segname, section->segname);
+	strcpy(job->sectname, section->sectname);
+	job->data = ofile->sf.object_addr + offset;
+	job->size = size;
+	job->fd = fd;
+	job->filename = filename;
+	job->start = start;
+	*ofile->inflates_tail = job;
+	ofile->inflates_tail = &job->next;
+	workqueue_add(wq, &ofile->inflate_group, inflate_section, job);
+}
+
+/*
+ * inflate_section is the work item that inflates a section to its output
+ * file.  Data that only looked like zlib data by its first two bytes is
+ * written as it is when it turns out not to be.
+ */
+static
+void
+inflate_section(
+void *arg)
+{
+    struct inflate_job *job;
+    struct decompress_stream *ds;
+    enum decompress_format format;
+    uint64_t start, pos, len;
+    int result;
+
+	job = arg;
+	start = phase_begin();
+	if((ds = decompress_stream_open()) == NULL)
+	    fatal("virtual memory exhausted (calloc failed)");
+	result = 0;
+	for(pos = 0; pos < job->size && result == 0; pos += len){
+	    len = job->size - pos > 1024 * 1024 * 1024 ? 1024 * 1024 * 1024 :
+							 job->size - pos;
+	    result = decompress_stream_write(ds, job->fd, job->data + pos, len);
+	}
+	if(result == -1)
+	    decompress_stream_close(ds, -1, &format);
+	else
+	    result = decompress_stream_close(ds, job->fd, &format);
+	if(result == -1 && errno == EILSEQ && format == DECOMPRESS_ZLIB &&
+	   ftruncate(job->fd, 0) == 0 && lseek(job->fd, 0, SEEK_SET) == 0)
+	    result = write_all(job->fd, job->data, job->size);
+	if(result == -1 && errno == EILSEQ){
+	    error("section (%s,%s) of: %s is corrupt (can't decompress it to: "
+		  "%s)", job->segname, job->sectname,
+		  job->ofile->sf.object_name, job->filename);
+	}
+	else if(result == -1){
+	    error("can't write: %s (%s)", job->filename, strerror(errno));
+	}
+	if(close(job->fd) == -1){
+	    error("can't close: %s", job->filename);
+	    result = -1;
+	}
+	job->result = result;
+	job->time = phase_begin() - start;
+	trace_section(job->ofile, job->segname, job->sectname, job->filename,
+		      job->start, job->size);
+}
+
+/*
+ * finish_inflates waits for the inflating of the sections of the object
+ * queued by add_inflate(), and sets extract_result to -1 if any failed.
+ */
+static
+void
+finish_inflates(
+struct ofile *ofile)
+{
+    struct inflate_job *job, *next;
+
+	workqueue_wait(wq, &ofile->inflate_group);
+	for(job = ofile->inflates; job != NULL; job = next){
+	    next = job->next;
+	    if(timing){
+		ofile->stats[PHASE_COPY].time += job->time;
+		ofile->stats[PHASE_COPY].calls++;
+		ofile->stats[PHASE_COPY].bytes += job->size;
+	    }
+	    if(job->result == -1)
+		ofile->extract_result = -1;
+	    free(job->filename);
+	    free(job);
+	}
+	ofile->inflates = NULL;
+	ofile->inflates_tail = &ofile->inflates;
+}
+
+/*
+ * is_zerofill returns 1 if the section flags are those of a section without
+ * contents in the file.
+ */
+int
+is_zerofill(
+uint32_t flags)
+{
+	flags &= SECTION_TYPE;
+	return(flags == S_ZEROFILL || flags == S_GB_ZEROFILL ||
+	       flags == S_THREAD_LOCAL_ZEROFILL);
+}
+
+// misc/allocate.c
+void *
+allocate(
+size_t size)
+{
+    void *p;
+
+	if(size == 0)
+	    return(NULL);
+	if((p = malloc(size)) == NULL)
+	    fatal("virtual memory exhausted (malloc failed)");
+	return(p);
+}
+
+void *
+reallocate(
+void *p,
+size_t size)
+{
+	if(p == NULL)
+	    return(allocate(size));
+	if((p = realloc(p, size)) == NULL)
+	    fatal("virtual memory exhausted (realloc failed)");
 	return(p);
 }
 
@@ -426,7 +3531,23 @@ static
 void
 usage(void)
 {
-	fprintf(stderr, "Usage: %s <input file> [-extract <segname> <sectname> "
-			"<filename>] ...\n", progname);
+	fprintf(stderr, "Usage: %s <input file> ... [-files-from <file>] "
+			"[-files0-from <file>] [-bundle-dir <dir>] ... "
+			"[-cache-dir <dir>] [-j <jobs>] [-tar <file>] "
+			"[-store <dir>] [-hash <file>] [-compress <gz|zst>] "
+			"[-decompress] "
+			"[-stats] [-trace <file>] "
+			"[-arch <arch_type>] "
+			"... [-extract <segname> <sectname> <filename>] ... "
+			"[-extract-regex <segname> <sectname> <filename>] ... "
+			"[-extract-all <filename>] ... "
+			"[-extract-symbol <name> <filename>] ... "
+			"[-symbolicate] "
+			"[-verify-signature] "
+			"[-replace <segname> <sectname> <filename>] ... "
+			"[-remove <segname> <sectname>] ... "
+			"[-remove-segment <segname>] ... "
+			"[-output <filename>]\n",
+			progname);
 	exit(1);
 }
@@ -0,0 +1,234 @@
+/*
+ * libsegedit, the library segedit(1) reads the sections of Mach-O files with.
+ *
+ * A struct segedit_file holds the state of one input file, which is mapped
+ * read-only, and of the object in it that is operated on.  The library has no
+ * other state, so any number of them can be used at once, each by one thread
+ * at a time.  Errors are returned as an enum segedit_error with a message in
+ * the struct segedit_file; the library never prints or exits.
+ */
+#ifndef _SEGEDIT_H_
+#define _SEGEDIT_H_
+
+#include <stdint.h>
+#include "mach-o-loader.h"
+#include "mach-o-fat.h"
+#include "mach-o-nlist.h"
+
+enum segedit_error {
+    SEGEDIT_OK = 0,
+    SEGEDIT_ESYS,		/* a system call failed, see sys_errno */
+    SEGEDIT_ENOTREG,		/* not a regular file, so it can't be mapped */
+    SEGEDIT_EMALFORMED,		/* the file is truncated or malformed */
+    SEGEDIT_EMAGIC,		/* the file is not a Mach-O or fat file */
+    SEGEDIT_ENOMEM		/* memory can't be allocated */
+};
+
+struct segedit_file {
+    /* These fields are set by segedit_init() and segedit_map_fd() */
+    char *file_name;		/* name of the input file */
+    int file_fd;		/* the open input file, -1 if none */
+    char *file_addr;		/* address of where the input file is mapped,
+				   NULL if it is not */
+    uint64_t file_size;		/* size of the input file */
+    uint32_t file_mode;		/* mode of the input file */
+    uint32_t file_blksize;	/* block size of the input file's file system */
+    int64_t file_mtime;		/* modification time of the input file */
+    int64_t file_mtime_nsec;	/*  and its nanoseconds */
+    uint64_t file_dev;		/* device and inode number of the input file */
+    uint64_t file_ino;
+    struct fat_header fat_header; /* the input file's fat header */
+    struct fat_arch_64
+	*fat_archs;		/* the input file's fat_arch structs, converted
+				   to fat_arch_64 structs for 32-bit fat files,
+				   NULL if the input is not fat */
+
+    /* These fields are set by segedit_map_object() */
+    char *object_addr;		/* address of the object */
+    uint64_t object_size;	/* size of the object */
+    char *object_name;		/* name of the object for messages, set by the
+				   caller, the file name if NULL */
+    const char *arch_name;	/* name of the object's architecture */
+    char arch_name_buf[64];	/* arch_name of an unknown architecture, which
+				   is not in the table of arch.c */
+    struct mach_header mh;	/* copy of the object's mach header, or */
+    struct mach_header_64 mh64;	/*  for 64-bit files, in the host byte sex */
+    struct mach_header *mhp;	/* pointer to mh, NULL for 64-bit files */
+    struct mach_header_64 *mhp64; /* pointer to mh64, NULL for 32-bit files */
+    uint32_t mh_ncmds;		/* number of load commands */
+    struct load_command
+	*load_commands;		/* pointer to the object's load commands, these
+				   are left in the object's byte sex */
+    char swapped;		/* 1 if the object's headers must be swapped */
+
+    /* These fields are set by segedit_use_cache() */
+    char *cache;		/* the section tables of the input file, NULL if
+				   the cache is not used */
+    uint64_t cache_size;	/* size of the section tables */
+    char cache_mapped;		/* 1 if they are mapped from the cache file, 0
+				   if they were built and allocated */
+    const void *cache_object;	/* the cached object mapped by
+				   segedit_map_arch(), NULL if it was parsed */
+
+    /* These fields are set when an error is returned */
+    enum segedit_error error;	/* the last error */
+    int sys_errno;		/* errno for SEGEDIT_ESYS */
+    char message[256];		/* the message for the last error */
+    char warning[256];		/* the message for the last warning, empty if
+				   there was none */
+};
+
+/*
+ * A view of a section of the object, as passed to the function given to
+ * segedit_sections().  Nothing is copied from the object except the names.
+ */
+struct segedit_section {
+    char segname[17];		/* segment name, null terminated */
+    char sectname[17];		/* section name, null terminated */
+    uint32_t flags;		/* section type and attributes */
+    uint64_t addr;		/* memory address of the section */
+    uint64_t offset;		/* offset of the contents in the object */
+    uint64_t size;		/* size of the contents */
+    const char *contents;	/* the contents in the mapped input file, NULL
+				   for zero fill sections, for contents that
+				   extend past the end of the object, and when
+				   the object is not in a mapped input file */
+    const void *header;		/* the section header in the object, a struct
+				   section or section_64 in its byte sex, NULL
+				   when the section is taken from the cache */
+};
+
+/*
+ * The function called for each section by segedit_sections().  It returns 0
+ * to go on with the next section, anything else stops the walk.
+ */
+typedef int (*segedit_section_func)(
+    void *arg,
+    const struct segedit_section *section);
+
+/*
+ * A symbol table entry of the object, as passed to the function given to
+ * segedit_symbols(), with its fields in the host byte sex.
+ */
+struct segedit_symbol {
+    const char *name;		/* the name in the mapped string table, null
+				   terminated */
+    uint8_t type;		/* n_type, see mach-o-nlist.h */
+    uint8_t sect;		/* n_sect, the section number or NO_SECT */
+    uint16_t desc;		/* n_desc */
+    uint64_t value;		/* n_value, the address of defined symbols */
+};
+
+/*
+ * The function called for each symbol by segedit_symbols().  It returns 0 to
+ * go on with the next symbol, anything else stops the walk.
+ */
+typedef int (*segedit_symbol_func)(
+    void *arg,
+    const struct segedit_symbol *symbol);
+
+/*
+ * segedit_init() initializes the struct segedit_file for the named input file.
+ */
+extern void segedit_init(
+    struct segedit_file *sf,
+    char *file_name);
+
+/*
+ * segedit_open() opens the input file named in segedit_init() and maps it with
+ * segedit_map_fd().
+ */
+extern enum segedit_error segedit_open(
+    struct segedit_file *sf);
+
+/*
+ * segedit_map_fd() maps the open input file fd, which is closed again by
+ * segedit_close().  If the input file is a fat file its fat_header and
+ * fat_arch structs are checked and swapped into the host byte sex.  If it is
+ * not a regular file SEGEDIT_ENOTREG is returned with the file left open.
+ */
+extern enum segedit_error segedit_map_fd(
+    struct segedit_file *sf,
+    int fd);
+
+/*
+ * segedit_set_fat_archs() sets fat_archs from the fat_arch (or fat_arch_64)
+ * structs at addr, which follow the fat header already in fat_header.  It is
+ * for fat headers that are not in a mapped input file.
+ */
+extern enum segedit_error segedit_set_fat_archs(
+    struct segedit_file *sf,
+    const char *addr);
+
+/*
+ * segedit_map_object() checks the object of size bytes at addr, which is in
+ * the mapped input file or a copy of its headers, and sets the object fields.
+ */
+extern enum segedit_error segedit_map_object(
+    struct segedit_file *sf,
+    char *addr,
+    uint64_t size);
+
+/*
+ * segedit_map_arch() maps the i'th object of a fat file, or the object of a
+ * thin file when i is 0, with segedit_map_object().
+ */
+extern enum segedit_error segedit_map_arch(
+    struct segedit_file *sf,
+    uint32_t i);
+
+/*
+ * segedit_use_cache() looks up the section tables of the objects of the mapped
+ * input file in the cache directory, where they are kept by the device and
+ * inode number of the input file.  They are used if the input file has the
+ * same size and modification time as when they were cached and its objects
+ * the same LC_UUID, and then segedit_map_arch() and segedit_sections() take
+ * the headers and sections from them instead of parsing the load commands.
+ * Otherwise the objects are parsed, and the section tables are used and
+ * written to the cache.  If the input file turns out to be malformed the cache
+ * is not used, which leaves the errors to segedit_map_arch().  SEGEDIT_ESYS is
+ * returned if the section tables can't be written to the cache, in which case
+ * they are still used.
+ */
+extern enum segedit_error segedit_use_cache(
+    struct segedit_file *sf,
+    const char *dir);
+
+/*
+ * segedit_narchs() returns the number of objects in the input file.
+ */
+extern uint32_t segedit_narchs(
+    struct segedit_file *sf);
+
+/*
+ * segedit_sections() calls func for each section of the object, in the order
+ * of the load commands, until it returns something other than 0.  It returns
+ * that, or 0 when all the sections were walked.
+ */
+extern int segedit_sections(
+    struct segedit_file *sf,
+    segedit_section_func func,
+    void *arg);
+
+/*
+ * segedit_symbols() calls func for each entry of the LC_SYMTAB symbol table of
+ * the object, in the order of the table, until it returns something other
+ * than 0.  The symbol table and the string table must be in the mapped input
+ * file, or SEGEDIT_ENOTREG is returned.  SEGEDIT_EMALFORMED is returned if
+ * they extend past the end of the object, or at the first entry whose name is
+ * not in the string table.  An object without an LC_SYMTAB command has no
+ * symbols.
+ */
+extern enum segedit_error segedit_symbols(
+    struct segedit_file *sf,
+    segedit_symbol_func func,
+    void *arg);
+
+/*
+ * segedit_close() unmaps and closes the input file, and frees what the
+ * library allocated for it.
+ */
+extern void segedit_close(
+    struct segedit_file *sf);
+
+#endif /* _SEGEDIT_H_ */
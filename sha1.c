@@ -0,0 +1,146 @@
+/*
+ * The SHA-1 message digest, as in FIPS 180-4.
+ */
+#include <string.h>
+#include "sha1.h"
+
+#define ROL(x, n)	(((x) << (n)) | ((x) >> (32 - (n))))
+
+static void transform(
+    uint32_t state[5],
+    const uint8_t *data,
+    size_t nblocks);
+
+void
+sha1_init(
+struct sha1_ctx *ctx)
+{
+	ctx->state[0] = 0x67452301;
+	ctx->state[1] = 0xefcdab89;
+	ctx->state[2] = 0x98badcfe;
+	ctx->state[3] = 0x10325476;
+	ctx->state[4] = 0xc3d2e1f0;
+	ctx->length = 0;
+}
+
+void
+sha1_update(
+struct sha1_ctx *ctx,
+const void *data,
+size_t len)
+{
+    const uint8_t *p;
+    size_t used, n;
+
+	p = data;
+	used = ctx->length % 64;
+	ctx->length += len;
+	if(used != 0){
+	    n = 64 - used < len ? 64 - used : len;
+	    memcpy(ctx->block + used, p, n);
+	    p += n;
+	    len -= n;
+	    if(used + n < 64)
+		return;
+	    transform(ctx->state, ctx->block, 1);
+	}
+	/* whole blocks are hashed in place */
+	if(len >= 64){
+	    transform(ctx->state, p, len / 64);
+	    p += len & ~(size_t)63;
+	    len %= 64;
+	}
+	memcpy(ctx->block, p, len);
+}
+
+void
+sha1_final(
+struct sha1_ctx *ctx,
+uint8_t digest[SHA1_DIGEST_LENGTH])
+{
+    uint64_t bits;
+    size_t used;
+    uint32_t i;
+
+	bits = ctx->length * 8;
+	used = ctx->length % 64;
+	ctx->block[used++] = 0x80;
+	if(used > 56){
+	    memset(ctx->block + used, '\0', 64 - used);
+	    transform(ctx->state, ctx->block, 1);
+	    used = 0;
+	}
+	memset(ctx->block + used, '\0', 56 - used);
+	for(i = 0; i < 8; i++)
+	    ctx->block[56 + i] = bits >> (56 - 8 * i);
+	transform(ctx->state, ctx->block, 1);
+	for(i = 0; i < 5; i++){
+	    digest[4 * i] = ctx->state[i] >> 24;
+	    digest[4 * i + 1] = ctx->state[i] >> 16;
+	    digest[4 * i + 2] = ctx->state[i] >> 8;
+	    digest[4 * i + 3] = ctx->state[i];
+	}
+}
+
+void
+sha1(
+const void *data,
+size_t len,
+uint8_t digest[SHA1_DIGEST_LENGTH])
+{
+    struct sha1_ctx ctx;
+
+	sha1_init(&ctx);
+	sha1_update(&ctx, data, len);
+	sha1_final(&ctx, digest);
+}
+
+/*
+ * transform hashes the nblocks 64 byte blocks at data into state.
+ */
+static
+void
+transform(
+uint32_t state[5],
+const uint8_t *data,
+size_t nblocks)
+{
+    uint32_t w[80], a, b, c, d, e, f, t;
+    uint32_t i;
+
+	for( ; nblocks != 0; nblocks--, data += 64){
+	    for(i = 0; i < 16; i++)
+		w[i] = (uint32_t)data[4 * i] << 24 |
+		       (uint32_t)data[4 * i + 1] << 16 |
+		       (uint32_t)data[4 * i + 2] << 8 |
+		       (uint32_t)data[4 * i + 3];
+	    for(i = 16; i < 80; i++)
+		w[i] = ROL(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+	    a = state[0];
+	    b = state[1];
+	    c = state[2];
+	    d = state[3];
+	    e = state[4];
+	    for(i = 0; i < 80; i++){
+		if(i < 20)
+		    f = ((b & c) | (~b & d)) + 0x5a827999;
+		else if(i < 40)
+		    f = (b ^ c ^ d) + 0x6ed9eba1;
+		else if(i < 60)
+		    f = ((b & c) | (b & d) | (c & d)) + 0x8f1bbcdc;
+		else
+		    f = (b ^ c ^ d) + 0xca62c1d6;
+		t = ROL(a, 5) + f + e + w[i];
+		e = d;
+		d = c;
+		c = ROL(b, 30);
+		b = a;
+		a = t;
+	    }
+	    state[0] += a;
+	    state[1] += b;
+	    state[2] += c;
+	    state[3] += d;
+	    state[4] += e;
+	}
+}
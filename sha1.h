@@ -0,0 +1,47 @@
+/*
+ * The SHA-1 message digest, as in FIPS 180-4.
+ */
+#ifndef _SHA1_H_
+#define _SHA1_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SHA1_DIGEST_LENGTH 20
+
+struct sha1_ctx {
+    uint32_t state[5];		/* the hash value so far */
+    uint64_t length;		/* number of bytes hashed */
+    uint8_t block[64];		/* bytes that don't fill a block yet */
+};
+
+/*
+ * sha1_init() starts hashing a new message.
+ */
+extern void sha1_init(
+    struct sha1_ctx *ctx);
+
+/*
+ * sha1_update() adds the len bytes at data to the message.
+ */
+extern void sha1_update(
+    struct sha1_ctx *ctx,
+    const void *data,
+    size_t len);
+
+/*
+ * sha1_final() finishes the message and leaves its digest in digest.
+ */
+extern void sha1_final(
+    struct sha1_ctx *ctx,
+    uint8_t digest[SHA1_DIGEST_LENGTH]);
+
+/*
+ * sha1() leaves the digest of the len bytes at data in digest.
+ */
+extern void sha1(
+    const void *data,
+    size_t len,
+    uint8_t digest[SHA1_DIGEST_LENGTH]);
+
+#endif /* _SHA1_H_ */
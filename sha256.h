@@ -0,0 +1,47 @@
+/*
+ * The SHA-256 message digest, as in FIPS 180-4.
+ */
+#ifndef _SHA256_H_
+#define _SHA256_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SHA256_DIGEST_LENGTH 32
+
+struct sha256_ctx {
+    uint32_t state[8];		/* the hash value so far */
+    uint64_t length;		/* number of bytes hashed */
+    uint8_t block[64];		/* bytes that don't fill a block yet */
+};
+
+/*
+ * sha256_init() starts hashing a new message.
+ */
+extern void sha256_init(
+    struct sha256_ctx *ctx);
+
+/*
+ * sha256_update() adds the len bytes at data to the message.
+ */
+extern void sha256_update(
+    struct sha256_ctx *ctx,
+    const void *data,
+    size_t len);
+
+/*
+ * sha256_final() finishes the message and leaves its digest in digest.
+ */
+extern void sha256_final(
+    struct sha256_ctx *ctx,
+    uint8_t digest[SHA256_DIGEST_LENGTH]);
+
+/*
+ * sha256() leaves the digest of the len bytes at data in digest.
+ */
+extern void sha256(
+    const void *data,
+    size_t len,
+    uint8_t digest[SHA256_DIGEST_LENGTH]);
+
+#endif /* _SHA256_H_ */
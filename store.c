@@ -0,0 +1,230 @@
+/*
+ * The content-addressed store of -store.
+ */
+#define _FILE_OFFSET_BITS 64
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+
+#include "sha256.h"
+#include "store.h"
+
+char *store_dir;
+
+static char *object_filename(
+    const uint8_t digest[SHA256_DIGEST_LENGTH]);
+
+/*
+ * object_filename returns the allocated name of the file in the -store
+ * directory for contents with the SHA-256 digest, which is
+ * objects/<first two hex digits>/<the other hex digits>.
+ */
+static
+char *
+object_filename(
+const uint8_t digest[SHA256_DIGEST_LENGTH])
+{
+    char *filename, *p;
+    uint32_t i;
+
+	filename = allocate(strlen(store_dir) + sizeof("/objects/xx/") +
+			    2 * SHA256_DIGEST_LENGTH);
+	p = filename + sprintf(filename, "%s/objects/", store_dir);
+	for(i = 0; i < SHA256_DIGEST_LENGTH; i++){
+	    p += sprintf(p, "%02x", digest[i]);
+	    if(i == 0)
+		*p++ = '/';
+	}
+	return(filename);
+}
+
+char *
+store_section(
+struct ofile *ofile,
+uint64_t offset,
+uint64_t size)
+{
+    int fd;
+    char *objname, *tmpname;
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+    uint64_t start;
+
+	start = phase_begin();
+	sha256(ofile->sf.object_addr + offset, size, digest);
+	phase_end(ofile, PHASE_HASH, start, size);
+	objname = object_filename(digest);
+	if(access(objname, F_OK) == 0){
+	    ofile->nlinked++;
+	    return(objname);
+	}
+
+	start = phase_begin();
+	tmpname = allocate(strlen(objname) + sizeof(".XXXXXX"));
+	sprintf(tmpname, "%s.XXXXXX", objname);
+	if((fd = mkstemp(tmpname)) == -1 && errno == ENOENT &&
+	   make_dirs(tmpname) == 0){
+	    sprintf(tmpname, "%s.XXXXXX", objname);
+	    fd = mkstemp(tmpname);
+	}
+	phase_end(ofile, PHASE_CREATE, start, 0);
+	if(fd == -1){
+	    error("can't create: %s (%s)", tmpname, strerror(errno));
+	    free(tmpname);
+	    free(objname);
+	    return(NULL);
+	}
+	start = phase_begin();
+	if(copy_section(ofile, fd, offset, size) == -1){
+	    error("can't write: %s (%s)", tmpname, strerror(errno));
+	    close(fd);
+	    goto fail;
+	}
+	phase_end(ofile, PHASE_COPY, start, size);
+	/* the output files are links to it, so it is made read-only */
+	start = phase_begin();
+	if(fchmod(fd, 0444) == -1 || close(fd) == -1 ||
+	   rename(tmpname, objname) == -1){
+	    error("can't store: %s (%s)", objname, strerror(errno));
+	    goto fail;
+	}
+	phase_end(ofile, PHASE_CREATE, start, 0);
+	free(tmpname);
+	ofile->nstored++;
+	return(objname);
+
+fail:
+	unlink(tmpname);
+	free(tmpname);
+	free(objname);
+	return(NULL);
+}
+
+int
+store_output(
+struct ofile *ofile,
+char *filename)
+{
+    int fd;
+    char *addr, *objname;
+    struct stat stat_buf;
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+    uint64_t start;
+
+	if((fd = open(filename, O_RDONLY)) == -1 ||
+	   fstat(fd, &stat_buf) == -1){
+	    error("can't open: %s (%s)", filename, strerror(errno));
+	    if(fd != -1)
+		close(fd);
+	    return(-1);
+	}
+	addr = NULL;
+	if(stat_buf.st_size != 0 &&
+	   (addr = mmap(0, stat_buf.st_size, PROT_READ, MAP_FILE|MAP_PRIVATE,
+			fd, 0)) == MAP_FAILED){
+	    error("can't map: %s (%s)", filename, strerror(errno));
+	    close(fd);
+	    return(-1);
+	}
+	start = phase_begin();
+	sha256(addr, stat_buf.st_size, digest);
+	phase_end(ofile, PHASE_HASH, start, stat_buf.st_size);
+	if(addr != NULL)
+	    munmap(addr, stat_buf.st_size);
+	close(fd);
+
+	start = phase_begin();
+	objname = object_filename(digest);
+	if(access(objname, F_OK) == 0){
+	    if(link_output(objname, filename) == 0)
+		ofile->nlinked++;
+	}
+	else{
+	    /* if another thread stores it first this one is left as is */
+	    chmod(filename, 0444);
+	    if(link(filename, objname) == -1 && errno == ENOENT &&
+	       make_dirs(objname) == 0)
+		link(filename, objname);
+	    if(access(objname, F_OK) == 0)
+		ofile->nstored++;
+	}
+	phase_end(ofile, PHASE_CREATE, start, 0);
+	free(objname);
+	return(0);
+}
+
+int
+link_output(
+const char *objname,
+char *filename)
+{
+    int fd, saved_errno;
+    char *tmpname;
+
+	tmpname = allocate(strlen(filename) + sizeof(".XXXXXX"));
+	sprintf(tmpname, "%s.XXXXXX", filename);
+	if((fd = mkstemp(tmpname)) == -1 && errno == ENOENT &&
+	   make_dirs(tmpname) == 0){
+	    sprintf(tmpname, "%s.XXXXXX", filename);
+	    fd = mkstemp(tmpname);
+	}
+	if(fd == -1){
+	    free(tmpname);
+	    return(-1);
+	}
+	close(fd);
+	/* the name is reserved by the file mkstemp() made */
+	unlink(tmpname);
+	if(link(objname, tmpname) == -1 || rename(tmpname, filename) == -1){
+	    saved_errno = errno;
+	    unlink(tmpname);
+	    free(tmpname);
+	    errno = saved_errno;
+	    return(-1);
+	}
+	free(tmpname);
+	return(0);
+}
+
+int
+clone_output(
+struct ofile *ofile,
+const char *objname,
+char *filename,
+uint64_t offset,
+uint64_t size)
+{
+    int fd, result, cloned;
+#ifdef FICLONE
+    int objfd;
+#endif
+
+	if((fd = create_output(filename)) == -1){
+	    error("can't create: %s", filename);
+	    return(-1);
+	}
+	result = 0;
+	cloned = 0;
+#ifdef FICLONE
+	if((objfd = open(objname, O_RDONLY)) != -1){
+	    cloned = ioctl(fd, FICLONE, objfd) == 0;
+	    close(objfd);
+	}
+#endif
+	if(cloned == 0 && copy_section(ofile, fd, offset, size) == -1){
+	    error("can't write: %s (%s)", filename, strerror(errno));
+	    result = -1;
+	}
+	if(close(fd) == -1){
+	    error("can't close: %s", filename);
+	    result = -1;
+	}
+	return(result);
+}
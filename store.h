@@ -0,0 +1,65 @@
+/*
+ * The content-addressed store of -store.
+ */
+#ifndef _STORE_H_
+#define _STORE_H_
+
+#include <stdint.h>
+#include "ofile.h"
+
+/*
+ * With -store each extracted section is written once to this directory, named
+ * after the SHA-256 of its contents, and the output files are hard links to
+ * it.  Sections that are already in it are not written again.
+ */
+extern char *store_dir;
+
+/*
+ * store_section() hashes size bytes at offset in the object and returns the
+ * allocated name of the file in the -store directory with them.  If there is
+ * none yet the bytes are copied to a temporary file there, which is then
+ * renamed, so that a file in the store is always complete.  It returns NULL
+ * and prints an error if the file can't be written.
+ */
+extern char *store_section(
+    struct ofile *ofile,
+    uint64_t offset,
+    uint64_t size);
+
+/*
+ * store_output() moves the contents of an output file that was written from an
+ * input stream into the -store directory.  The output file is hashed after it
+ * is written, and becomes the file in the store or a link to the one that is
+ * already there.  If it can't be linked it is left as it is.  It returns -1
+ * and prints an error if it can't be read.
+ */
+extern int store_output(
+    struct ofile *ofile,
+    char *filename);
+
+/*
+ * link_output() makes the output file a hard link to the file in the -store
+ * directory.  The link is made with a temporary name and renamed, so that an
+ * existing output file is replaced at once.  It returns -1 with errno set if
+ * the link can't be made, like when the output file is on another file
+ * system.
+ */
+extern int link_output(
+    const char *objname,
+    char *filename);
+
+/*
+ * clone_output() writes the output file for size bytes at offset in the object
+ * when it can't be linked to the file in the -store directory.  It shares the
+ * blocks of the file in the store if the file system can (FICLONE), and
+ * otherwise the bytes are copied from the input file with copy_section().  It
+ * returns -1 and prints an error if the output file can't be written.
+ */
+extern int clone_output(
+    struct ofile *ofile,
+    const char *objname,
+    char *filename,
+    uint64_t offset,
+    uint64_t size);
+
+#endif /* _STORE_H_ */
@@ -0,0 +1,589 @@
+/*
+ * The symbol index of an object for -extract-symbol, and the address lookup
+ * of -symbolicate.
+ */
+#define _GNU_SOURCE	/* for fputs_unlocked() */
+#define _FILE_OFFSET_BITS 64
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "ofile.h"
+#include "symbols.h"
+
+/*
+ * With -symbolicate the symbol index of each input file is built once, and
+ * the addresses read from the standard input are looked up in them.  The
+ * input files stay mapped until then, as the symbol names are in them.  The
+ * distinct addresses of the symbols are kept in Eytzinger order, the order of
+ * a breadth first walk of a balanced binary search tree, so that the top of
+ * the tree shares a few cache lines and the search can prefetch the keys of
+ * three levels down.
+ */
+struct image {
+    char *name;			/* name of the input file */
+    const char *base;		/* its base name, in name */
+    struct segedit_file sf;	/* the input file, see segedit.h */
+    struct symbol_index si;	/* the symbols of the object in it */
+    uint64_t *keys;		/* the distinct addresses of the symbols in
+				   Eytzinger order, from keys[1] */
+    uint32_t *prev;		/* for each key the symbol at the next lower
+				   address, NO_SYMBOL if there is none */
+    uint32_t nkeys;
+    uint32_t last;		/* the symbol at the highest address */
+};
+#define NO_SYMBOL UINT32_MAX
+static struct image **images;	/* the indexed input files */
+static uint32_t nimages;
+static pthread_mutex_t images_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int add_symbol_section(
+    void *arg,
+    const struct segedit_section *section);
+static int add_symbol(
+    void *arg,
+    const struct segedit_symbol *symbol);
+static void sort_symbols(
+    struct symbol *symbols,
+    uint32_t nsymbols);
+static int index_object(
+    struct ofile *ofile);
+static uint32_t place_keys(
+    struct image *im,
+    const uint32_t *unique,
+    uint32_t rank,
+    uint64_t k);
+static int compare_images(
+    const void *p1,
+    const void *p2);
+static struct image *find_image(
+    const char *name,
+    size_t size);
+static struct symbol *lookup_address(
+    struct image *im,
+    uint64_t value);
+static void free_image(
+    struct image *im);
+
+int
+build_symbol_index(
+struct ofile *ofile,
+struct symbol_index *si,
+int hash_names)
+{
+    uint32_t i, j, h, size;
+    struct symbol *sp;
+
+	/* the names are hashed as the string table is read, in its order */
+	memset(si, '\0', sizeof(struct symbol_index));
+	si->hash_names = hash_names;
+	segedit_sections(&ofile->sf, add_symbol_section, si);
+	if(segedit_symbols(&ofile->sf, add_symbol, si) != SEGEDIT_OK){
+	    print_error(ofile);
+	    free_symbol_index(si);
+	    return(-1);
+	}
+	sort_symbols(si->symbols, si->nsymbols);
+	if(hash_names == 0)
+	    return(0);
+
+	/* the table is kept at most half full */
+	for(size = 2; size < (uint64_t)si->nsymbols * 2; size *= 2)
+	    ;
+	si->names = allocate(size * sizeof(uint64_t));
+	memset(si->names, '\0', size * sizeof(uint64_t));
+	si->names_mask = size - 1;
+	for(i = 0; i < si->nsymbols; i++){
+	    sp = si->symbols + i;
+	    h = sp->hash & si->names_mask;
+	    while((j = (uint32_t)si->names[h]) != 0 &&
+		  ((si->names[h] >> 32) != sp->hash ||
+		   strcmp(si->symbols[j - 1].name, sp->name) != 0))
+		h = (h + 1) & si->names_mask;
+	    if(j == 0 ||
+	       ((si->symbols[j - 1].type & N_EXT) == 0 &&
+		(sp->type & N_EXT) != 0))
+		si->names[h] = ((uint64_t)sp->hash << 32) | (i + 1);
+	}
+	return(0);
+}
+
+/*
+ * add_symbol_section is called by segedit_sections() for each section of the
+ * object, to number them for the symbols.  It stops the walk at the last
+ * section a symbol can be in.
+ */
+static
+int
+add_symbol_section(
+void *arg,
+const struct segedit_section *section)
+{
+    struct symbol_index *si;
+
+	si = arg;
+	if(si->nsections == si->maxsections){
+	    si->maxsections = si->maxsections == 0 ? 16 : si->maxsections * 2;
+	    si->sections = reallocate(si->sections,
+		si->maxsections * sizeof(struct segedit_section));
+	}
+	si->sections[si->nsections++] = *section;
+	return(si->nsections == MAX_SECT);
+}
+
+/*
+ * add_symbol is called by segedit_symbols() for each symbol table entry of the
+ * object, and adds it to the symbol index if it is defined in a section.
+ */
+static
+int
+add_symbol(
+void *arg,
+const struct segedit_symbol *symbol)
+{
+    struct symbol_index *si;
+    struct segedit_section *section;
+    struct symbol *sp;
+
+	si = arg;
+	if((symbol->type & N_STAB) != 0 ||
+	   (symbol->type & N_TYPE) != N_SECT ||
+	   symbol->sect == NO_SECT || symbol->sect > si->nsections)
+	    return(0);
+	section = si->sections + symbol->sect - 1;
+	if(symbol->value < section->addr ||
+	   symbol->value - section->addr > section->size)
+	    return(0);
+	if(si->nsymbols == si->maxsymbols){
+	    si->maxsymbols = si->maxsymbols == 0 ? 1024 : si->maxsymbols * 2;
+	    si->symbols = reallocate(si->symbols,
+		(size_t)si->maxsymbols * sizeof(struct symbol));
+	}
+	sp = si->symbols + si->nsymbols++;
+	sp->value = symbol->value;
+	sp->name = symbol->name;
+	sp->hash = si->hash_names ? hash_symbol_name(symbol->name) : 0;
+	sp->sect = symbol->sect;
+	sp->type = symbol->type;
+	return(0);
+}
+
+/*
+ * sort_symbols sorts the symbols by address with a radix sort, a byte at a
+ * time from the lowest, which keeps symbols with the same address in the
+ * order of the symbol table.  The counts of all eight bytes are taken in one
+ * pass, and bytes that are the same in every address are not sorted on, which
+ * are most of the high ones.
+ */
+static
+void
+sort_symbols(
+struct symbol *symbols,
+uint32_t nsymbols)
+{
+    uint32_t i, b, n, sum, counts[8][256];
+    struct symbol *from, *to, *tmp, *t;
+
+	if(nsymbols < 2)
+	    return;
+	memset(counts, '\0', sizeof(counts));
+	for(i = 0; i < nsymbols; i++)
+	    for(b = 0; b < 8; b++)
+		counts[b][(symbols[i].value >> (b * 8)) & 0xff]++;
+
+	tmp = allocate((size_t)nsymbols * sizeof(struct symbol));
+	from = symbols;
+	to = tmp;
+	for(b = 0; b < 8; b++){
+	    /* symbols always holds all of them, whatever the pass */
+	    if(counts[b][(symbols[0].value >> (b * 8)) & 0xff] == nsymbols)
+		continue;
+	    for(sum = 0, i = 0; i < 256; i++){
+		n = counts[b][i];
+		counts[b][i] = sum;
+		sum += n;
+	    }
+	    for(i = 0; i < nsymbols; i++)
+		to[counts[b][(from[i].value >> (b * 8)) & 0xff]++] = from[i];
+	    t = from;
+	    from = to;
+	    to = t;
+	}
+	if(from != symbols)
+	    memcpy(symbols, from, (size_t)nsymbols * sizeof(struct symbol));
+	free(tmp);
+}
+
+uint32_t
+hash_symbol_name(
+const char *name)
+{
+    uint64_t h;
+
+	h = 0xcbf29ce484222325ULL;
+	for( ; *name != '\0'; name++)
+	    h = (h ^ (unsigned char)*name) * 0x100000001b3ULL;
+	return((uint32_t)(h >> 32) ^ (uint32_t)h);
+}
+
+struct symbol *
+lookup_symbol(
+struct symbol_index *si,
+const char *name)
+{
+    uint32_t hash, h, j;
+
+	hash = hash_symbol_name(name);
+	h = hash & si->names_mask;
+	while((j = (uint32_t)si->names[h]) != 0){
+	    if((si->names[h] >> 32) == hash &&
+	       strcmp(si->symbols[j - 1].name, name) == 0)
+		return(si->symbols + j - 1);
+	    h = (h + 1) & si->names_mask;
+	}
+	return(NULL);
+}
+
+uint64_t
+symbol_size(
+struct symbol_index *si,
+struct symbol *sp)
+{
+    uint64_t end;
+    struct symbol *next;
+    struct segedit_section *section;
+
+	section = si->sections + sp->sect - 1;
+	end = section->addr + section->size;
+	for(next = sp + 1;
+	    next < si->symbols + si->nsymbols && next->value < end;
+	    next++){
+	    if(next->value != sp->value && next->sect == sp->sect)
+		return(next->value - sp->value);
+	}
+	return(end - sp->value);
+}
+
+void
+free_symbol_index(
+struct symbol_index *si)
+{
+	free(si->symbols);
+	free(si->names);
+	free(si->sections);
+}
+
+int
+index_input(
+struct ofile *ofile)
+{
+    uint32_t i;
+    int result, nselected;
+    char *selected;
+
+	if(ofile->streaming){
+	    error("can't symbolicate with: %s (not a regular file)",
+		  ofile->sf.file_name);
+	    return(-1);
+	}
+	use_cache(ofile);
+
+	if(ofile->sf.fat_archs == NULL){
+	    ofile->sf.object_name = ofile->sf.file_name;
+	    if(map_arch(ofile, 0) == -1 ||
+	       check_arch_flags(ofile) == -1)
+		return(-1);
+	    return(index_object(ofile));
+	}
+
+	selected = allocate(ofile->sf.fat_header.nfat_arch);
+	if((nselected = select_fat_archs(ofile, selected)) == -1){
+	    free(selected);
+	    return(-1);
+	}
+	if(nselected != 1){
+	    error("more than one architecture in: %s (use -arch to select the "
+		  "one to symbolicate with)", ofile->sf.file_name);
+	    free(selected);
+	    return(-1);
+	}
+	for(i = 0; selected[i] == 0; i++)
+	    ;
+	free(selected);
+	set_object_name(ofile, i, nselected);
+	result = -1;
+	if(map_arch(ofile, i) == 0)
+	    result = index_object(ofile);
+	free(ofile->sf.object_name);
+	ofile->sf.object_name = NULL;
+	return(result);
+}
+
+/*
+ * index_object builds the symbol index of the object and adds it to the
+ * images.  The input file is handed over to the image, which keeps it mapped.
+ * The symbols at the same address are searched for as one, and named after
+ * the external one, or the first in the symbol table.
+ */
+static
+int
+index_object(
+struct ofile *ofile)
+{
+    uint32_t i, nunique, *unique;
+    uint64_t start;
+    struct image *im;
+    struct symbol *symbols;
+    char *object_name;
+
+	im = allocate(sizeof(struct image));
+	memset(im, '\0', sizeof(struct image));
+	start = phase_begin();
+	if(build_symbol_index(ofile, &im->si, 0) == -1){
+	    phase_end(ofile, PHASE_PARSE, start, 0);
+	    free(im);
+	    return(-1);
+	}
+	symbols = im->si.symbols;
+	unique = allocate((im->si.nsymbols + 1) * sizeof(uint32_t));
+	nunique = 0;
+	for(i = 0; i < im->si.nsymbols; i++){
+	    if(nunique != 0 &&
+	       symbols[unique[nunique - 1]].value == symbols[i].value){
+		if((symbols[unique[nunique - 1]].type & N_EXT) == 0 &&
+		   (symbols[i].type & N_EXT) != 0)
+		    unique[nunique - 1] = i;
+		continue;
+	    }
+	    unique[nunique++] = i;
+	}
+	im->nkeys = nunique;
+	/* the eight children three levels down share a cache line */
+	if(posix_memalign((void **)&im->keys, 64,
+			  (nunique + 1) * sizeof(uint64_t)) != 0)
+	    fatal("virtual memory exhausted (posix_memalign failed)");
+	im->prev = allocate((nunique + 1) * sizeof(uint32_t));
+	place_keys(im, unique, 0, 1);
+	im->last = nunique != 0 ? unique[nunique - 1] : NO_SYMBOL;
+	free(unique);
+	phase_end(ofile, PHASE_PARSE, start, 0);
+
+	im->name = allocate(strlen(ofile->sf.file_name) + 1);
+	strcpy(im->name, ofile->sf.file_name);
+	im->base = strrchr(im->name, '/') != NULL ?
+		   strrchr(im->name, '/') + 1 : im->name;
+	im->sf = ofile->sf;
+	im->sf.file_name = im->name;
+	if(ofile->sf.arch_name == ofile->sf.arch_name_buf)
+	    im->sf.arch_name = im->sf.arch_name_buf;
+	im->sf.object_name = NULL;
+	object_name = ofile->sf.object_name;
+	segedit_init(&ofile->sf, ofile->sf.file_name);
+	ofile->sf.object_name = object_name;
+
+	pthread_mutex_lock(&images_lock);
+	images = reallocate(images, (nimages + 1) * sizeof(struct image *));
+	images[nimages++] = im;
+	pthread_mutex_unlock(&images_lock);
+	return(0);
+}
+
+/*
+ * place_keys puts the keys of the subtree at k, which has the symbols of the
+ * distinct addresses in unique from rank on, in Eytzinger order, an in order
+ * walk of the tree.  It returns the rank after them.
+ */
+static
+uint32_t
+place_keys(
+struct image *im,
+const uint32_t *unique,
+uint32_t rank,
+uint64_t k)
+{
+	if(k > im->nkeys)
+	    return(rank);
+	rank = place_keys(im, unique, rank, 2 * k);
+	im->keys[k] = im->si.symbols[unique[rank]].value;
+	im->prev[k] = rank != 0 ? unique[rank - 1] : NO_SYMBOL;
+	return(place_keys(im, unique, rank + 1, 2 * k + 1));
+}
+
+/*
+ * Function for qsort for comparing images by name.
+ */
+static
+int
+compare_images(
+const void *p1,
+const void *p2)
+{
+	return(strcmp((*(struct image **)p1)->name,
+		      (*(struct image **)p2)->name));
+}
+
+int
+symbolicate(void)
+{
+    char *line, *address, *endp;
+    size_t linesize, namesize;
+    ssize_t len;
+    int named, result;
+    uint32_t i;
+    uint64_t value;
+    struct image *im;
+    struct symbol *sp;
+
+	qsort(images, nimages, sizeof(struct image *), compare_images);
+	result = 0;
+	line = NULL;
+	linesize = 0;
+	flockfile(stdout);
+	while((len = getline(&line, &linesize, stdin)) != -1){
+	    if(len != 0 && line[len - 1] == '\n')
+		line[--len] = '\0';
+	    address = line + strspn(line, " \t");
+	    namesize = strcspn(address, " \t");
+	    named = address[namesize] != '\0' &&
+		    address[namesize +
+			    strspn(address + namesize, " \t")] != '\0';
+	    im = NULL;
+	    if(named){
+		im = find_image(address, namesize);
+		address += namesize;
+		address += strspn(address, " \t");
+	    }
+	    if(*address == '\0'){
+		fputs_unlocked(line, stdout);
+		putc_unlocked('\n', stdout);
+		continue;
+	    }
+	    value = strtoull(address, &endp, 16);
+	    if(endp == address || endp[strspn(endp, " \t")] != '\0'){
+		error("bad address: %s", address);
+		result = -1;
+		fputs_unlocked(line, stdout);
+		fputs_unlocked("\t??\n", stdout);
+		continue;
+	    }
+
+	    sp = NULL;
+	    if(im != NULL)
+		sp = lookup_address(im, value);
+	    else if(named == 0){
+		for(i = 0; i < nimages && sp == NULL; i++)
+		    sp = lookup_address(images[i], value);
+	    }
+	    fputs_unlocked(line, stdout);
+	    putc_unlocked('\t', stdout);
+	    if(sp == NULL)
+		fputs_unlocked("??\n", stdout);
+	    else if(value == sp->value){
+		fputs_unlocked(sp->name, stdout);
+		putc_unlocked('\n', stdout);
+	    }
+	    else
+		fprintf(stdout, "%s+0x%llx\n", sp->name,
+			(unsigned long long)(value - sp->value));
+	}
+	funlockfile(stdout);
+	free(line);
+	if(fflush(stdout) == EOF || ferror(stdout))
+	    fatal("can't write to standard output (%s)", strerror(errno));
+	return(result);
+}
+
+/*
+ * find_image returns the image of the input file with the name of size
+ * characters, or with it as its base name, or NULL if there is none.  The
+ * image found last is tried first, as addresses in the same input file tend
+ * to come together.
+ */
+static
+struct image *
+find_image(
+const char *name,
+size_t size)
+{
+    static struct image *last;
+    uint32_t i;
+    struct image *im;
+
+	if(last != NULL &&
+	   ((strncmp(last->name, name, size) == 0 &&
+	     last->name[size] == '\0') ||
+	    (strncmp(last->base, name, size) == 0 &&
+	     last->base[size] == '\0')))
+	    return(last);
+	for(i = 0; i < nimages; i++){
+	    im = images[i];
+	    if((strncmp(im->name, name, size) == 0 && im->name[size] == '\0') ||
+	       (strncmp(im->base, name, size) == 0 && im->base[size] == '\0'))
+		return(last = im);
+	}
+	return(NULL);
+}
+
+/*
+ * lookup_address returns the symbol at the highest address not above value,
+ * if value is in its section, or NULL.  The search walks down the tree of
+ * keys to the first one above value, where the last step to the left was
+ * taken, and the symbol is the one just before it.
+ */
+static
+struct symbol *
+lookup_address(
+struct image *im,
+uint64_t value)
+{
+    uint64_t k;
+    uint32_t i;
+    struct symbol *sp;
+    struct segedit_section *section;
+
+	k = 1;
+	while(k <= im->nkeys){
+	    __builtin_prefetch(im->keys + k * 8);
+	    k = 2 * k + (im->keys[k] <= value);
+	}
+	/* undo the steps to the right after the last one to the left */
+	k >>= __builtin_ffsll(~k);
+	i = k != 0 ? im->prev[k] : im->last;
+	if(i == NO_SYMBOL)
+	    return(NULL);
+	sp = im->si.symbols + i;
+	section = im->si.sections + sp->sect - 1;
+	if(value - section->addr >= section->size)
+	    return(NULL);
+	return(sp);
+}
+
+/*
+ * free_image frees the image and closes its input file.
+ */
+static
+void
+free_image(
+struct image *im)
+{
+	free(im->keys);
+	free(im->prev);
+	free_symbol_index(&im->si);
+	segedit_close(&im->sf);
+	free(im->name);
+	free(im);
+}
+
+void
+free_images(void)
+{
+    uint32_t i;
+
+	for(i = 0; i < nimages; i++)
+	    free_image(images[i]);
+	free(images);
+	images = NULL;
+	nimages = 0;
+}
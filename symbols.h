@@ -0,0 +1,105 @@
+/*
+ * The symbol index of an object for -extract-symbol, and the address lookup
+ * of -symbolicate.
+ */
+#ifndef _SYMBOLS_H_
+#define _SYMBOLS_H_
+
+#include <stdint.h>
+#include "ofile.h"
+
+/*
+ * The symbol index of an object for -extract-symbol, built once for each
+ * object from its LC_SYMTAB symbol table and its sections.  The symbols
+ * defined in a section are sorted by address, so that each is sized by the
+ * next one in its section, and their names are in a hash table.  The names
+ * and sections are views into the mapped input file.
+ */
+struct symbol {
+    uint64_t value;		/* address of the symbol */
+    const char *name;		/* its name in the string table */
+    uint32_t hash;		/* hash of the name */
+    uint8_t sect;		/* number of its section */
+    uint8_t type;		/* its n_type */
+};
+struct symbol_index {
+    struct symbol *symbols;	/* the symbols sorted by address */
+    uint32_t nsymbols;
+    uint32_t maxsymbols;	/* number of symbols allocated */
+    uint64_t *names;		/* hash table of the names, the hash of the
+				   name in the high 32 bits and the index into
+				   symbols plus 1 in the low ones, 0 for a free
+				   slot */
+    uint32_t names_mask;
+    char hash_names;		/* set if the names are hashed */
+    struct segedit_section *sections; /* the sections by number minus 1 */
+    uint32_t nsections;
+    uint32_t maxsections;	/* number of sections allocated */
+};
+
+/*
+ * build_symbol_index() builds the symbol index of the object, with the hash
+ * table of the names if hash_names is set.  Only the symbols defined in a
+ * section are in it, and only those within their section.  When more than
+ * one symbol has a name the hash table has the external one, or the one with
+ * the lowest address.  It returns -1 and prints an error if the symbol table
+ * is malformed.
+ */
+extern int build_symbol_index(
+    struct ofile *ofile,
+    struct symbol_index *si,
+    int hash_names);
+
+/*
+ * hash_symbol_name() returns the FNV-1a hash of the name.
+ */
+extern uint32_t hash_symbol_name(
+    const char *name);
+
+/*
+ * lookup_symbol() returns the symbol with the name in the symbol index, or NULL
+ * if there is none.
+ */
+extern struct symbol *lookup_symbol(
+    struct symbol_index *si,
+    const char *name);
+
+/*
+ * symbol_size() returns the size of the symbol, which ends at the next higher
+ * address of a symbol in its section, or at the end of the section.
+ */
+extern uint64_t symbol_size(
+    struct symbol_index *si,
+    struct symbol *sp);
+
+/*
+ * free_symbol_index() frees what the symbol index allocated.
+ */
+extern void free_symbol_index(
+    struct symbol_index *si);
+
+/*
+ * index_input() builds the symbol index of the mapped input file for
+ * -symbolicate, of the one architecture selected in a fat file.  It returns
+ * -1 and prints an error if it can't.
+ */
+extern int index_input(
+    struct ofile *ofile);
+
+/*
+ * symbolicate() reads addresses from the standard input, one on each line in
+ * hex and optionally after the name of an input file (or its base name),
+ * and writes each line followed by a tab and the symbol the address is in
+ * with the offset in it, or ?? if it is in none.  An address without a name is
+ * looked up in each input file in the order of their names, until one has a
+ * section with the address.  Lines without an address are written as they
+ * are.  It returns -1 if a line has an address that can't be read.
+ */
+extern int symbolicate(void);
+
+/*
+ * free_images() frees the images of the input files, which closes them.
+ */
+extern void free_images(void);
+
+#endif /* _SYMBOLS_H_ */
@@ -0,0 +1,232 @@
+/*
+ * Writing POSIX (pax) tar archives.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tar.h"
+
+/* the ustar header, as in POSIX.1-2001 */
+struct ustar_header {
+    char name[100];
+    char mode[8];
+    char uid[8];
+    char gid[8];
+    char size[12];
+    char mtime[12];
+    char chksum[8];
+    char typeflag;
+    char linkname[100];
+    char magic[6];
+    char version[2];
+    char uname[32];
+    char gname[32];
+    char devmajor[8];
+    char devminor[8];
+    char prefix[155];
+    char pad[12];
+};
+
+/* the largest size a 12 byte octal field holds */
+#define TAR_MAXOCTAL 077777777777ULL
+
+static void fill_header(
+    char *block,
+    const char *name,
+    uint64_t size,
+    uint32_t mode,
+    int64_t mtime,
+    char typeflag);
+static void put_octal(
+    char *field,
+    size_t len,
+    uint64_t value);
+static size_t pax_record(
+    char *buf,
+    const char *keyword,
+    const char *value);
+static char *relative_name(
+    const char *name);
+static void *allocate(
+    size_t size);
+
+char *
+tar_header(
+const char *name,
+uint64_t size,
+uint32_t mode,
+int64_t mtime,
+size_t *len)
+{
+    char *buf, *pax, *rel, number[24];
+    size_t name_len, pax_len, nblocks;
+
+	rel = relative_name(name);
+	name = rel;
+
+	/* the pax records, each at most the value plus 32 bytes long */
+	name_len = strlen(name);
+	pax = allocate(name_len + 2 * 32 + sizeof(number));
+	pax_len = 0;
+	if(name_len >= sizeof(((struct ustar_header *)0)->name))
+	    pax_len += pax_record(pax + pax_len, "path", name);
+	if(size > TAR_MAXOCTAL){
+	    snprintf(number, sizeof(number), "%llu", (unsigned long long)size);
+	    pax_len += pax_record(pax + pax_len, "size", number);
+	}
+
+	nblocks = 1;
+	if(pax_len != 0)
+	    nblocks += 1 + (pax_len + TAR_BLOCKSIZE - 1) / TAR_BLOCKSIZE;
+	*len = nblocks * TAR_BLOCKSIZE;
+	buf = allocate(*len);
+	memset(buf, '\0', *len);
+	if(pax_len != 0){
+	    fill_header(buf, "././@PaxHeader", pax_len, 0644, mtime, 'x');
+	    memcpy(buf + TAR_BLOCKSIZE, pax, pax_len);
+	}
+	fill_header(buf + *len - TAR_BLOCKSIZE, name, size, mode, mtime, '0');
+	free(pax);
+	free(rel);
+	return(buf);
+}
+
+size_t
+tar_padding(
+uint64_t size)
+{
+	return((TAR_BLOCKSIZE - size % TAR_BLOCKSIZE) % TAR_BLOCKSIZE);
+}
+
+/*
+ * relative_name returns the allocated name without its leading slashes and
+ * its empty, "." and ".." components, so that extracting the entry can't
+ * write outside the directory it is extracted in.
+ */
+static
+char *
+relative_name(
+const char *name)
+{
+    char *rel, *p;
+    size_t len;
+
+	rel = allocate(strlen(name) + 1);
+	p = rel;
+	while(*name != '\0'){
+	    len = strcspn(name, "/");
+	    if(len != 0 &&
+	       (len != 1 || name[0] != '.') &&
+	       (len != 2 || name[0] != '.' || name[1] != '.')){
+		if(p != rel)
+		    *p++ = '/';
+		memcpy(p, name, len);
+		p += len;
+	    }
+	    name += len;
+	    if(*name == '/')
+		name++;
+	}
+	*p = '\0';
+	return(rel);
+}
+
+/*
+ * fill_header fills in the ustar header block.  A name that is too long is
+ * truncated, as it is also in a pax header.  A size that is too large for the
+ * octal field is stored in base 256 like GNU tar does.
+ */
+static
+void
+fill_header(
+char *block,
+const char *name,
+uint64_t size,
+uint32_t mode,
+int64_t mtime,
+char typeflag)
+{
+    struct ustar_header *h;
+    uint32_t i, sum;
+
+	h = (struct ustar_header *)block;
+	memset(h, '\0', sizeof(struct ustar_header));
+	strncpy(h->name, name, sizeof(h->name) - 1);
+	put_octal(h->mode, sizeof(h->mode), mode & 07777);
+	put_octal(h->uid, sizeof(h->uid), 0);
+	put_octal(h->gid, sizeof(h->gid), 0);
+	if(size > TAR_MAXOCTAL){
+	    h->size[0] = (char)0x80;
+	    for(i = sizeof(h->size) - 1; i > 0; i--){
+		h->size[i] = size & 0xff;
+		size >>= 8;
+	    }
+	}
+	else
+	    put_octal(h->size, sizeof(h->size), size);
+	put_octal(h->mtime, sizeof(h->mtime), mtime < 0 ? 0 : mtime);
+	h->typeflag = typeflag;
+	memcpy(h->magic, "ustar", 6);
+	memcpy(h->version, "00", 2);
+
+	memset(h->chksum, ' ', sizeof(h->chksum));
+	sum = 0;
+	for(i = 0; i < sizeof(struct ustar_header); i++)
+	    sum += (unsigned char)block[i];
+	put_octal(h->chksum, sizeof(h->chksum) - 1, sum);
+}
+
+/*
+ * put_octal puts the value in the field as len - 1 octal digits followed by
+ * a null.
+ */
+static
+void
+put_octal(
+char *field,
+size_t len,
+uint64_t value)
+{
+	field[--len] = '\0';
+	while(len > 0){
+	    field[--len] = '0' + (value & 7);
+	    value >>= 3;
+	}
+}
+
+/*
+ * pax_record puts the pax extended header record "<length> keyword=value\n"
+ * in buf, where the length is that of the whole record, and returns it.
+ */
+static
+size_t
+pax_record(
+char *buf,
+const char *keyword,
+const char *value)
+{
+    size_t len, n;
+
+	len = strlen(keyword) + strlen(value) + 3;
+	for(n = 1; ; n++){
+	    if(snprintf(NULL, 0, "%zu", len + n) == (int)n)
+		break;
+	}
+	len += n;
+	sprintf(buf, "%zu %s=%s\n", len, keyword, value);
+	return(len);
+}
+
+static
+void *
+allocate(
+size_t size)
+{
+    void *p;
+
+	if((p = malloc(size)) == NULL){
+	    fprintf(stderr, "virtual memory exhausted (malloc failed)\n");
+	    exit(1);
+	}
+	return(p);
+}
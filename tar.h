@@ -0,0 +1,34 @@
+/*
+ * Writing POSIX (pax) tar archives.
+ */
+#ifndef _TAR_H_
+#define _TAR_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TAR_BLOCKSIZE 512
+
+/*
+ * tar_header() returns the allocated header blocks for a regular file entry
+ * of size bytes with the name, mode and modification time, and sets *len to
+ * their size.  Names longer than a ustar header holds and sizes of 8 GiB or
+ * more are put in a pax extended header before it.  The name is made relative
+ * to where the archive is extracted: leading slashes and empty, "." and ".."
+ * components are left out of it.
+ */
+extern char *tar_header(
+    const char *name,
+    uint64_t size,
+    uint32_t mode,
+    int64_t mtime,
+    size_t *len);
+
+/*
+ * tar_padding() returns the number of zero bytes that must follow size bytes
+ * of file contents to fill their last block.
+ */
+extern size_t tar_padding(
+    uint64_t size);
+
+#endif /* _TAR_H_ */
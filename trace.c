@@ -0,0 +1,119 @@
+/*
+ * Writing Chrome trace event files, which trace viewers like about:tracing
+ * and Perfetto load.
+ *
+ * The file is in the JSON object format of the Trace Event Format, with each
+ * event a complete ("X") event of the thread that writes it.
+ */
+#define _GNU_SOURCE	/* for syscall() */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "trace.h"
+
+static FILE *trace_file;	/* the open trace file */
+static uint64_t trace_start;	/* when it was opened */
+static uint32_t trace_nevents;	/* number of events written */
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void put_string(
+    const char *s);
+
+uint64_t
+trace_now(void)
+{
+    struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+int
+trace_open(
+const char *filename)
+{
+	if((trace_file = fopen(filename, "w")) == NULL)
+	    return(-1);
+	trace_start = trace_now();
+	trace_nevents = 0;
+	fprintf(trace_file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	return(0);
+}
+
+void
+trace_event(
+const char *cat,
+const char *name,
+const char *file,
+uint64_t start,
+uint64_t end,
+uint64_t bytes)
+{
+    long tid;
+
+	tid = syscall(SYS_gettid);
+	pthread_mutex_lock(&trace_lock);
+	fprintf(trace_file, "%s{\"ph\":\"X\",\"pid\":%ld,\"tid\":%ld,"
+		"\"ts\":%.3f,\"dur\":%.3f,\"cat\":",
+		trace_nevents != 0 ? ",\n" : "", (long)getpid(), tid,
+		(start - trace_start) / 1e3, (end - start) / 1e3);
+	put_string(cat);
+	fprintf(trace_file, ",\"name\":");
+	put_string(name);
+	if(file != NULL || bytes != 0){
+	    fprintf(trace_file, ",\"args\":{");
+	    if(file != NULL){
+		fprintf(trace_file, "\"file\":");
+		put_string(file);
+	    }
+	    if(bytes != 0)
+		fprintf(trace_file, "%s\"bytes\":%llu", file != NULL ? "," : "",
+			(unsigned long long)bytes);
+	    fprintf(trace_file, "}");
+	}
+	fprintf(trace_file, "}");
+	trace_nevents++;
+	pthread_mutex_unlock(&trace_lock);
+}
+
+int
+trace_close(void)
+{
+    int result;
+
+	fprintf(trace_file, "\n]}\n");
+	result = ferror(trace_file) ? -1 : 0;
+	if(fclose(trace_file) == EOF)
+	    result = -1;
+	trace_file = NULL;
+	return(result);
+}
+
+/*
+ * put_string writes s to the trace file as a JSON string.
+ */
+static
+void
+put_string(
+const char *s)
+{
+    unsigned char c;
+
+	putc('"', trace_file);
+	for( ; (c = *s) != '\0'; s++){
+	    if(c == '"' || c == '\\'){
+		putc('\\', trace_file);
+		putc(c, trace_file);
+	    }
+	    else if(c < 0x20)
+		fprintf(trace_file, "\\u%04x", c);
+	    else
+		putc(c, trace_file);
+	}
+	putc('"', trace_file);
+}
@@ -0,0 +1,43 @@
+/*
+ * Writing Chrome trace event files, which trace viewers like about:tracing
+ * and Perfetto load.
+ */
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+
+/*
+ * trace_now() returns the time of the monotonic clock in nanoseconds.
+ */
+extern uint64_t trace_now(void);
+
+/*
+ * trace_open() creates the trace file, into which trace_event() then writes.
+ * The times of the events are relative to when it is opened.  It returns -1
+ * with errno set if the file can't be created.
+ */
+extern int trace_open(
+    const char *filename);
+
+/*
+ * trace_event() writes a complete event from start to end, times as returned
+ * by trace_now(), on the calling thread.  The event has the name and category
+ * and as arguments the file if not NULL and the bytes if not 0.  It may be
+ * called from any thread.
+ */
+extern void trace_event(
+    const char *cat,
+    const char *name,
+    const char *file,
+    uint64_t start,
+    uint64_t end,
+    uint64_t bytes);
+
+/*
+ * trace_close() finishes and closes the trace file.  It returns -1 with errno
+ * set if it can't be written.
+ */
+extern int trace_close(void);
+
+#endif /* _TRACE_H_ */
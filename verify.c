@@ -0,0 +1,452 @@
+/*
+ * Checking the page hashes of the code signature of an object, for
+ * -verify-signature.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stddef.h>
+
+#include "ofile.h"
+#include "bytesex.h"
+#include "sha1.h"
+#include "sha256.h"
+#include "mach-o-cs_blobs.h"
+#include "verify.h"
+
+/*
+ * With -verify-signature the pages of each object are hashed again and
+ * compared with their hashes in the code directories of its code signature,
+ * and nothing is extracted from objects that don't match.  The pages are
+ * hashed by work items of about VERIFY_CHUNK bytes, so that a large object is
+ * hashed by all the threads at once.
+ */
+#define VERIFY_CHUNK (1024 * 1024)
+
+/* code signatures are big-endian whatever the byte sex of the object */
+#define CS_SWAPPED (HOST_BYTE_SEX != BIG_ENDIAN_BYTE_SEX)
+
+/* the pages of an object hashed by one work item */
+struct verify_job {
+    const char *code;		/* the signed bytes, from the start of the
+				   object */
+    uint64_t code_limit;	/* number of signed bytes */
+    uint64_t page_size;		/* size of a page */
+    const uint8_t *hashes;	/* the hash of page 0 in the code directory */
+    uint32_t hash_type;		/* CS_HASHTYPE_SHA1 or one of SHA-256 */
+    uint32_t hash_size;		/* size of each hash */
+    uint32_t first;		/* the first page hashed */
+    uint32_t npages;		/* number of pages hashed */
+    uint32_t *bad;		/* the pages that don't match */
+    uint32_t nbad;
+    uint64_t time;		/* time spent hashing, for -stats */
+};
+
+static int verify_directory(
+    struct ofile *ofile,
+    const char *sb,
+    uint32_t sb_length,
+    uint32_t offset);
+static int verify_blob(
+    struct ofile *ofile,
+    const char *sb,
+    uint32_t sb_length,
+    uint32_t type,
+    const uint8_t *hash,
+    uint32_t hash_type,
+    uint32_t hash_size);
+static void verify_pages(
+    void *arg);
+static const char *hash_type_name(
+    uint32_t hash_type);
+static void cs_hash(
+    const void *data,
+    uint64_t size,
+    uint32_t hash_type,
+    uint8_t digest[SHA256_DIGEST_LENGTH]);
+
+int
+verify_object(
+struct ofile *ofile)
+{
+    uint32_t i, cmd, cmdsize, dataoff, datasize, length, count, type, ncds;
+    uint32_t nchecked;
+    int result;
+    char *lcp;
+    const char *sb, *bi;
+
+	lcp = (char *)ofile->sf.load_commands;
+	for(i = 0; i < ofile->sf.mh_ncmds; i++){
+	    cmd = get_uint32(lcp + offsetof(struct load_command, cmd),
+			     ofile->sf.swapped);
+	    cmdsize = get_uint32(lcp + offsetof(struct load_command, cmdsize),
+				 ofile->sf.swapped);
+	    if(cmd == LC_CODE_SIGNATURE &&
+	       cmdsize >= sizeof(struct linkedit_data_command))
+		break;
+	    lcp += cmdsize;
+	}
+	if(i == ofile->sf.mh_ncmds){
+	    error("no code signature in: %s", ofile->sf.object_name);
+	    return(-1);
+	}
+	dataoff = get_uint32(lcp + offsetof(struct linkedit_data_command,
+					    dataoff), ofile->sf.swapped);
+	datasize = get_uint32(lcp + offsetof(struct linkedit_data_command,
+					     datasize), ofile->sf.swapped);
+	if(dataoff > ofile->sf.object_size ||
+	   datasize > ofile->sf.object_size - dataoff){
+	    error("truncated or malformed object (code signature extends past "
+		  "the end of the file) in: %s", ofile->sf.object_name);
+	    return(-1);
+	}
+
+	/* the code signature is a super blob of the code directories and
+	   the blobs they have the hashes of, which are all big-endian */
+	sb = ofile->sf.object_addr + dataoff;
+	if(datasize < sizeof(CS_SuperBlob) ||
+	   get_uint32(sb + offsetof(CS_SuperBlob, magic), CS_SWAPPED) !=
+	   CSMAGIC_EMBEDDED_SIGNATURE){
+	    error("malformed code signature (bad magic number) in: %s",
+		  ofile->sf.object_name);
+	    return(-1);
+	}
+	length = get_uint32(sb + offsetof(CS_SuperBlob, length), CS_SWAPPED);
+	count = get_uint32(sb + offsetof(CS_SuperBlob, count), CS_SWAPPED);
+	if(length > datasize || length < sizeof(CS_SuperBlob) ||
+	   count > (length - sizeof(CS_SuperBlob)) / sizeof(CS_BlobIndex)){
+	    error("malformed code signature (bad length) in: %s",
+		  ofile->sf.object_name);
+	    return(-1);
+	}
+
+	result = 0;
+	ncds = 0;
+	nchecked = 0;
+	for(i = 0; i < count; i++){
+	    bi = sb + sizeof(CS_SuperBlob) + i * sizeof(CS_BlobIndex);
+	    type = get_uint32(bi + offsetof(CS_BlobIndex, type), CS_SWAPPED);
+	    if(type != CSSLOT_CODEDIRECTORY &&
+	       (type < CSSLOT_ALTERNATE_CODEDIRECTORIES ||
+		type >= CSSLOT_ALTERNATE_CODEDIRECTORY_LIMIT))
+		continue;
+	    ncds++;
+	    switch(verify_directory(ofile, sb, length, get_uint32(bi +
+		   offsetof(CS_BlobIndex, offset), CS_SWAPPED))){
+	    case -1:
+		result = -1;
+		nchecked++;
+		break;
+	    case 0:
+		nchecked++;
+		break;
+	    }
+	}
+	if(ncds == 0){
+	    error("no code directory in the code signature of: %s",
+		  ofile->sf.object_name);
+	    return(-1);
+	}
+	if(nchecked == 0){
+	    error("no code directory that can be checked in the code signature "
+		  "of: %s", ofile->sf.object_name);
+	    return(-1);
+	}
+	return(result);
+}
+
+/*
+ * verify_directory checks the object against the code directory at offset in
+ * the super blob sb of sb_length bytes.  Its code slots have the hashes of
+ * the pages of the object up to the code limit, and its special slots those
+ * of the other blobs in the super blob, of which the requirements and the
+ * entitlements are checked.  The pages are hashed by work items on the
+ * workqueue.  It returns -1 and prints an error if the object doesn't match,
+ * and 1 without checking anything for a code directory with a hash type that
+ * is not known.
+ */
+static
+int
+verify_directory(
+struct ofile *ofile,
+const char *sb,
+uint32_t sb_length,
+uint32_t offset)
+{
+    const char *cd;
+    uint32_t i, length, version, hash_offset, nspecial, ncode, hash_size;
+    uint32_t hash_type, page_shift, pages_per_job, njobs, nbad, j;
+    uint64_t code_limit, page_size;
+    int result;
+    struct verify_job *jobs, *job;
+    struct work_group verify_group;
+
+#define CD_FIELD(field) \
+	get_uint32(cd + offsetof(CS_CodeDirectory, field), CS_SWAPPED)
+	if(offset > sb_length ||
+	   sb_length - offset < offsetof(CS_CodeDirectory, scatterOffset)){
+	    error("malformed code signature (code directory extends past its "
+		  "end) in: %s", ofile->sf.object_name);
+	    return(-1);
+	}
+	cd = sb + offset;
+	length = CD_FIELD(length);
+	if(CD_FIELD(magic) != CSMAGIC_CODEDIRECTORY ||
+	   length > sb_length - offset ||
+	   length < offsetof(CS_CodeDirectory, scatterOffset)){
+	    error("malformed code signature (bad code directory) in: %s",
+		  ofile->sf.object_name);
+	    return(-1);
+	}
+	version = CD_FIELD(version);
+	hash_offset = CD_FIELD(hashOffset);
+	nspecial = CD_FIELD(nSpecialSlots);
+	ncode = CD_FIELD(nCodeSlots);
+	code_limit = CD_FIELD(codeLimit);
+	hash_size = *(const uint8_t *)(cd + offsetof(CS_CodeDirectory,
+						     hashSize));
+	hash_type = *(const uint8_t *)(cd + offsetof(CS_CodeDirectory,
+						     hashType));
+	page_shift = *(const uint8_t *)(cd + offsetof(CS_CodeDirectory,
+						      pageSize));
+	if(version >= CS_SUPPORTSSCATTER &&
+	   length >= offsetof(CS_CodeDirectory, teamOffset) &&
+	   CD_FIELD(scatterOffset) != 0){
+	    error("code directory with a scatter vector can't be checked in: "
+		  "%s", ofile->sf.object_name);
+	    return(-1);
+	}
+	if(version >= CS_SUPPORTSCODELIMIT64 &&
+	   length >= offsetof(CS_CodeDirectory, execSegBase) &&
+	   get_uint64(cd + offsetof(CS_CodeDirectory, codeLimit64), 0) != 0)
+	    code_limit = get_uint64(cd + offsetof(CS_CodeDirectory,
+						  codeLimit64), CS_SWAPPED);
+#undef CD_FIELD
+
+	if(hash_type_name(hash_type) == NULL){
+	    error("code directory with hash type %u not checked in: %s",
+		  hash_type, ofile->sf.object_name);
+	    return(1);
+	}
+	if(hash_size != (hash_type == CS_HASHTYPE_SHA256 ? CS_SHA256_LEN :
+							    CS_SHA1_LEN) ||
+	   page_shift >= 32 ||
+	   hash_offset > length ||
+	   (uint64_t)ncode * hash_size > length - hash_offset ||
+	   (uint64_t)nspecial * hash_size > hash_offset ||
+	   code_limit > ofile->sf.object_size){
+	    error("malformed code signature (bad code directory) in: %s",
+		  ofile->sf.object_name);
+	    return(-1);
+	}
+	/* a page size of 0 is one page of all the signed bytes */
+	page_size = page_shift != 0 ? (uint64_t)1 << page_shift : code_limit;
+	if(ncode != (page_size == 0 ? 0 :
+		     (code_limit + page_size - 1) / page_size)){
+	    error("malformed code signature (%u code slots for %llu bytes) in: "
+		  "%s", ncode, (unsigned long long)code_limit,
+		  ofile->sf.object_name);
+	    return(-1);
+	}
+
+	result = 0;
+	if(nspecial >= CSSLOT_REQUIREMENTS &&
+	   verify_blob(ofile, sb, sb_length, CSSLOT_REQUIREMENTS,
+		       (const uint8_t *)cd + hash_offset -
+		       CSSLOT_REQUIREMENTS * hash_size, hash_type,
+		       hash_size) == -1)
+	    result = -1;
+	if(nspecial >= CSSLOT_ENTITLEMENTS &&
+	   verify_blob(ofile, sb, sb_length, CSSLOT_ENTITLEMENTS,
+		       (const uint8_t *)cd + hash_offset -
+		       CSSLOT_ENTITLEMENTS * hash_size, hash_type,
+		       hash_size) == -1)
+	    result = -1;
+	if(nspecial >= CSSLOT_DER_ENTITLEMENTS &&
+	   verify_blob(ofile, sb, sb_length, CSSLOT_DER_ENTITLEMENTS,
+		       (const uint8_t *)cd + hash_offset -
+		       CSSLOT_DER_ENTITLEMENTS * hash_size, hash_type,
+		       hash_size) == -1)
+	    result = -1;
+	if(ncode == 0)
+	    return(result);
+
+	pages_per_job = page_size >= VERIFY_CHUNK ? 1 :
+			VERIFY_CHUNK / page_size;
+	njobs = (ncode + pages_per_job - 1) / pages_per_job;
+	jobs = allocate(njobs * sizeof(struct verify_job));
+	memset(jobs, '\0', njobs * sizeof(struct verify_job));
+	workqueue_group_init(&verify_group);
+	for(i = 0; i < njobs; i++){
+	    job = jobs + i;
+	    job->code = ofile->sf.object_addr;
+	    job->code_limit = code_limit;
+	    job->page_size = page_size;
+	    job->hashes = (const uint8_t *)cd + hash_offset;
+	    job->hash_type = hash_type;
+	    job->hash_size = hash_size;
+	    job->first = i * pages_per_job;
+	    job->npages = ncode - job->first < pages_per_job ?
+			  ncode - job->first : pages_per_job;
+	    workqueue_add(wq, &verify_group, verify_pages, job);
+	}
+	workqueue_wait(wq, &verify_group);
+
+	nbad = 0;
+	for(i = 0; i < njobs; i++){
+	    job = jobs + i;
+	    if(timing){
+		ofile->stats[PHASE_HASH].time += job->time;
+		ofile->stats[PHASE_HASH].calls++;
+		ofile->stats[PHASE_HASH].bytes +=
+		    (job->first + job->npages == ncode ? code_limit :
+		     (uint64_t)(job->first + job->npages) * page_size) -
+		    (uint64_t)job->first * page_size;
+	    }
+	    for(j = 0; j < job->nbad; j++)
+		error("page %u (offset %llu) does not match its %s hash in "
+		      "the code signature of: %s", job->bad[j],
+		      (unsigned long long)job->bad[j] * page_size,
+		      hash_type_name(hash_type), ofile->sf.object_name);
+	    nbad += job->nbad;
+	    free(job->bad);
+	}
+	free(jobs);
+	if(nbad != 0){
+	    error("%u of %u pages do not match the code signature of: %s",
+		  nbad, ncode, ofile->sf.object_name);
+	    result = -1;
+	}
+	return(result);
+}
+
+/*
+ * verify_blob checks the hash of the blob in the special slot type of a code
+ * directory against the blob of that type in the super blob sb of sb_length
+ * bytes.  A slot of all zeros is for a blob that the code signature doesn't
+ * have.  It returns -1 and prints an error if they don't match.
+ */
+static
+int
+verify_blob(
+struct ofile *ofile,
+const char *sb,
+uint32_t sb_length,
+uint32_t type,
+const uint8_t *hash,
+uint32_t hash_type,
+uint32_t hash_size)
+{
+    uint32_t i, count, offset, length;
+    const char *bi, *name;
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+
+	for(i = 0; i < hash_size && hash[i] == 0; i++)
+	    ;
+	if(i == hash_size)
+	    return(0);
+	name = type == CSSLOT_REQUIREMENTS ? "requirements" :
+	       type == CSSLOT_ENTITLEMENTS ? "entitlements" :
+					     "DER entitlements";
+	count = get_uint32(sb + offsetof(CS_SuperBlob, count), CS_SWAPPED);
+	for(i = 0; i < count; i++){
+	    bi = sb + sizeof(CS_SuperBlob) + i * sizeof(CS_BlobIndex);
+	    if(get_uint32(bi + offsetof(CS_BlobIndex, type), CS_SWAPPED) ==
+	       type)
+		break;
+	}
+	if(i == count){
+	    error("missing %s blob in the code signature of: %s", name,
+		  ofile->sf.object_name);
+	    return(-1);
+	}
+	offset = get_uint32(bi + offsetof(CS_BlobIndex, offset), CS_SWAPPED);
+	if(offset > sb_length ||
+	   sb_length - offset < sizeof(CS_GenericBlob) ||
+	   (length = get_uint32(sb + offset + offsetof(CS_GenericBlob, length),
+				CS_SWAPPED)) > sb_length - offset){
+	    error("malformed code signature (%s blob extends past its end) "
+		  "in: %s", name, ofile->sf.object_name);
+	    return(-1);
+	}
+	cs_hash(sb + offset, length, hash_type, digest);
+	if(memcmp(digest, hash, hash_size) != 0){
+	    error("%s blob does not match its %s hash in the code signature "
+		  "of: %s", name, hash_type_name(hash_type),
+		  ofile->sf.object_name);
+	    return(-1);
+	}
+	return(0);
+}
+
+/*
+ * verify_pages is the work item that hashes the pages of a verify_job and
+ * records those that don't match their hashes in the code directory.  The
+ * last page of the object ends at the code limit.
+ */
+static
+void
+verify_pages(
+void *arg)
+{
+    struct verify_job *job;
+    uint64_t start, offset, size;
+    uint32_t i, page;
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+
+	job = arg;
+	start = phase_begin();
+	for(i = 0; i < job->npages; i++){
+	    page = job->first + i;
+	    offset = (uint64_t)page * job->page_size;
+	    size = job->code_limit - offset < job->page_size ?
+		   job->code_limit - offset : job->page_size;
+	    cs_hash(job->code + offset, size, job->hash_type, digest);
+	    if(memcmp(digest, job->hashes + (uint64_t)page * job->hash_size,
+		      job->hash_size) == 0)
+		continue;
+	    if(job->bad == NULL)
+		job->bad = allocate(job->npages * sizeof(uint32_t));
+	    job->bad[job->nbad++] = page;
+	}
+	job->time = phase_begin() - start;
+}
+
+/*
+ * hash_type_name returns the name of the code directory hash type, or NULL if
+ * it is not one that can be checked.
+ */
+static
+const char *
+hash_type_name(
+uint32_t hash_type)
+{
+	switch(hash_type){
+	case CS_HASHTYPE_SHA1:
+	    return("SHA-1");
+	case CS_HASHTYPE_SHA256:
+	    return("SHA-256");
+	case CS_HASHTYPE_SHA256_TRUNCATED:
+	    return("truncated SHA-256");
+	default:
+	    return(NULL);
+	}
+}
+
+/*
+ * cs_hash computes the digest of the code directory hash type of size bytes
+ * of data.  The truncated SHA-256 is the first bytes of the full one.
+ */
+static
+void
+cs_hash(
+const void *data,
+uint64_t size,
+uint32_t hash_type,
+uint8_t digest[SHA256_DIGEST_LENGTH])
+{
+	if(hash_type == CS_HASHTYPE_SHA1)
+	    sha1(data, size, digest);
+	else
+	    sha256(data, size, digest);
+}
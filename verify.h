@@ -0,0 +1,22 @@
+/*
+ * Checking the page hashes of the code signature of an object, for
+ * -verify-signature.
+ */
+#ifndef _VERIFY_H_
+#define _VERIFY_H_
+
+#include "ofile.h"
+
+/*
+ * verify_object() checks the object against the code directories of the code
+ * signature that its LC_CODE_SIGNATURE command points to, the primary one and
+ * any alternate ones with other hash types.  Only the hashes of the signed
+ * contents are checked, not the signature over the code directories.  It
+ * returns -1 and prints an error for each page that doesn't match, and if the
+ * object has no code signature or none of its code directories can be
+ * checked.
+ */
+extern int verify_object(
+    struct ofile *ofile);
+
+#endif /* _VERIFY_H_ */
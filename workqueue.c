@@ -0,0 +1,206 @@
+/*
+ * A small pool of worker threads that run queued work items.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "workqueue.h"
+
+static void *worker(
+    void *arg);
+static struct work *take_work(
+    struct workqueue *wq,
+    struct work_group *group);
+static void run_work(
+    struct workqueue *wq,
+    struct work *w);
+
+struct workqueue *
+workqueue_create(
+uint32_t nthreads)
+{
+    struct workqueue *wq;
+    uint32_t i;
+
+	if((wq = calloc(1, sizeof(struct workqueue))) == NULL){
+	    fprintf(stderr, "virtual memory exhausted (calloc failed)\n");
+	    exit(1);
+	}
+	pthread_mutex_init(&wq->lock, NULL);
+	pthread_cond_init(&wq->work_cond, NULL);
+	pthread_cond_init(&wq->done_cond, NULL);
+	wq->head = NULL;
+	wq->tail = &wq->head;
+	wq->nthreads = nthreads > 1 ? nthreads - 1 : 0;
+	if(wq->nthreads == 0)
+	    return(wq);
+	if((wq->threads = calloc(wq->nthreads, sizeof(pthread_t))) == NULL){
+	    fprintf(stderr, "virtual memory exhausted (calloc failed)\n");
+	    exit(1);
+	}
+	for(i = 0; i < wq->nthreads; i++){
+	    if(pthread_create(wq->threads + i, NULL, worker, wq) != 0){
+		/* run with the threads we have got */
+		wq->nthreads = i;
+		break;
+	    }
+	}
+	return(wq);
+}
+
+void
+workqueue_group_init(
+struct work_group *group)
+{
+	group->pending = 0;
+	group->head = NULL;
+	group->tail = &group->head;
+}
+
+void
+workqueue_add(
+struct workqueue *wq,
+struct work_group *group,
+void (*func)(void *arg),
+void *arg)
+{
+    struct work *w;
+
+	if((w = malloc(sizeof(struct work))) == NULL){
+	    fprintf(stderr, "virtual memory exhausted (malloc failed)\n");
+	    exit(1);
+	}
+	w->func = func;
+	w->arg = arg;
+	w->group = group;
+	w->next = NULL;
+	w->group_next = NULL;
+	pthread_mutex_lock(&wq->lock);
+	group->pending++;
+	w->prevp = wq->tail;
+	*wq->tail = w;
+	wq->tail = &w->next;
+	*group->tail = w;
+	group->tail = &w->group_next;
+	/* wake an idle worker, or a waiter that can run it itself */
+	pthread_cond_signal(&wq->work_cond);
+	pthread_cond_signal(&wq->done_cond);
+	pthread_mutex_unlock(&wq->lock);
+}
+
+void
+workqueue_wait(
+struct workqueue *wq,
+struct work_group *group)
+{
+    struct work *w;
+
+	pthread_mutex_lock(&wq->lock);
+	while(group->pending != 0){
+	    if((w = take_work(wq, group)) != NULL)
+		run_work(wq, w);
+	    else
+		pthread_cond_wait(&wq->done_cond, &wq->lock);
+	}
+	pthread_mutex_unlock(&wq->lock);
+}
+
+void
+workqueue_destroy(
+struct workqueue *wq)
+{
+    uint32_t i;
+
+	pthread_mutex_lock(&wq->lock);
+	wq->exiting = 1;
+	pthread_cond_broadcast(&wq->work_cond);
+	pthread_mutex_unlock(&wq->lock);
+	for(i = 0; i < wq->nthreads; i++)
+	    pthread_join(wq->threads[i], NULL);
+	pthread_cond_destroy(&wq->done_cond);
+	pthread_cond_destroy(&wq->work_cond);
+	pthread_mutex_destroy(&wq->lock);
+	free(wq->threads);
+	free(wq);
+}
+
+uint32_t
+workqueue_ncpus(void)
+{
+    long n;
+
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+	return(n > 0 ? (uint32_t)n : 1);
+}
+
+static
+void *
+worker(
+void *arg)
+{
+    struct workqueue *wq;
+    struct work *w;
+
+	wq = arg;
+	pthread_mutex_lock(&wq->lock);
+	for(;;){
+	    if((w = take_work(wq, NULL)) != NULL)
+		run_work(wq, w);
+	    else if(wq->exiting)
+		break;
+	    else
+		pthread_cond_wait(&wq->work_cond, &wq->lock);
+	}
+	pthread_mutex_unlock(&wq->lock);
+	return(NULL);
+}
+
+/*
+ * take_work() takes the first queued work item of the group off the queue, or
+ * the first of any group if group is NULL.  It returns NULL if there is none.
+ * Work items are queued in order, so the first of the queue is also the first
+ * of its group, and either way it is the head of its group's list.  It is
+ * called with the workqueue's lock held.
+ */
+static
+struct work *
+take_work(
+struct workqueue *wq,
+struct work_group *group)
+{
+    struct work *w;
+
+	w = group != NULL ? group->head : wq->head;
+	if(w == NULL)
+	    return(NULL);
+	*w->prevp = w->next;
+	if(w->next != NULL)
+	    w->next->prevp = w->prevp;
+	else
+	    wq->tail = w->prevp;
+	group = w->group;
+	if((group->head = w->group_next) == NULL)
+	    group->tail = &group->head;
+	return(w);
+}
+
+/*
+ * run_work() runs a work item that was taken off the queue.  It is called and
+ * returns with the workqueue's lock held, but drops it while the work runs.
+ */
+static
+void
+run_work(
+struct workqueue *wq,
+struct work *w)
+{
+    struct work_group *group;
+
+	pthread_mutex_unlock(&wq->lock);
+	w->func(w->arg);
+	group = w->group;
+	free(w);
+	pthread_mutex_lock(&wq->lock);
+	if(--group->pending == 0)
+	    pthread_cond_broadcast(&wq->done_cond);
+}
@@ -0,0 +1,93 @@
+/*
+ * A small pool of worker threads that run queued work items.
+ */
+#ifndef _WORKQUEUE_H_
+#define _WORKQUEUE_H_
+
+#include <stdint.h>
+#include <pthread.h>
+
+/*
+ * A work_group counts the work items added with it that have not finished
+ * yet, so that a caller can wait for just its own work, and keeps those that
+ * are still queued so that the caller can run them itself.
+ */
+struct work_group {
+    uint32_t pending;	/* number of unfinished work items, protected by the
+			   workqueue's lock */
+    struct work *head;	/* first queued work item of the group, NULL if
+			   none */
+    struct work **tail;	/* where to link its next work item */
+};
+
+struct work {
+    void (*func)(void *arg);	/* the routine to run */
+    void *arg;			/* its argument */
+    struct work_group *group;	/* the group it belongs to */
+    struct work *next;		/* next work item in the queue */
+    struct work **prevp;	/* what points to it in the queue */
+    struct work *group_next;	/* next queued work item of the group */
+};
+
+struct workqueue {
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;	/* signaled when work is added */
+    pthread_cond_t done_cond;	/* signaled when a work group finishes or
+				   work is added */
+    struct work *head;		/* first queued work item, NULL if none */
+    struct work **tail;		/* where to link the next work item */
+    pthread_t *threads;		/* the worker threads */
+    uint32_t nthreads;		/* number of worker threads */
+    int exiting;		/* set to make the worker threads exit */
+};
+
+/*
+ * workqueue_create() starts a workqueue with nthreads - 1 worker threads.  The
+ * thread calling workqueue_wait() runs work too, so nthreads work items can be
+ * run at the same time.  With nthreads of 1 all work is run by the thread
+ * that waits for it.
+ */
+extern struct workqueue *workqueue_create(
+    uint32_t nthreads);
+
+/*
+ * workqueue_group_init() makes the work group empty, ready for workqueue_add().
+ */
+extern void workqueue_group_init(
+    struct work_group *group);
+
+/*
+ * workqueue_add() queues func(arg) to be run as part of the work group.
+ */
+extern void workqueue_add(
+    struct workqueue *wq,
+    struct work_group *group,
+    void (*func)(void *arg),
+    void *arg);
+
+/*
+ * workqueue_wait() waits for all the work in the work group to finish.  While
+ * waiting the calling thread runs the queued work of the group itself, so work
+ * items may add and wait for work of their own without running out of threads.
+ * It never runs the work of other groups, which could be a whole input file
+ * queued behind its own work.
+ */
+extern void workqueue_wait(
+    struct workqueue *wq,
+    struct work_group *group);
+
+/*
+ * workqueue_destroy() stops the worker threads and frees the workqueue.  All
+ * work groups must have been waited for.
+ */
+extern void workqueue_destroy(
+    struct workqueue *wq);
+
+/*
+ * workqueue_ncpus() returns the number of online processors, the default
+ * number of threads.
+ */
+extern uint32_t workqueue_ncpus(
+    void);
+
+#endif /* _WORKQUEUE_H_ */
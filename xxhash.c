@@ -0,0 +1,205 @@
+/*
+ * The XXH64 hash of xxHash, a fast non-cryptographic hash.
+ *
+ * The message is read as little endian 64-bit words in 32 byte stripes, one
+ * word into each of four accumulators, so that they are independent.
+ */
+#include <string.h>
+#include "xxhash.h"
+
+#define PRIME64_1	0x9e3779b185ebca87ULL
+#define PRIME64_2	0xc2b2ae3d27d4eb4fULL
+#define PRIME64_3	0x165667b19e3779f9ULL
+#define PRIME64_4	0x85ebca77c2b2ae63ULL
+#define PRIME64_5	0x27d4eb2f165667c5ULL
+
+#define ROL(x, n)	(((x) << (n)) | ((x) >> (64 - (n))))
+
+static inline uint64_t read64(
+    const uint8_t *p);
+static inline uint32_t read32(
+    const uint8_t *p);
+static inline uint64_t round64(
+    uint64_t acc,
+    uint64_t input);
+static inline uint64_t merge_round(
+    uint64_t acc,
+    uint64_t v);
+static const uint8_t *stripes(
+    uint64_t v[4],
+    const uint8_t *p,
+    size_t nstripes);
+
+void
+xxh64_init(
+struct xxh64_ctx *ctx,
+uint64_t seed)
+{
+	ctx->v[0] = seed + PRIME64_1 + PRIME64_2;
+	ctx->v[1] = seed + PRIME64_2;
+	ctx->v[2] = seed;
+	ctx->v[3] = seed - PRIME64_1;
+	ctx->seed = seed;
+	ctx->length = 0;
+}
+
+void
+xxh64_update(
+struct xxh64_ctx *ctx,
+const void *data,
+size_t len)
+{
+    const uint8_t *p;
+    size_t used, n;
+
+	p = data;
+	used = ctx->length % 32;
+	ctx->length += len;
+	if(used != 0){
+	    n = 32 - used < len ? 32 - used : len;
+	    memcpy(ctx->block + used, p, n);
+	    p += n;
+	    len -= n;
+	    if(used + n < 32)
+		return;
+	    stripes(ctx->v, ctx->block, 1);
+	}
+	p = stripes(ctx->v, p, len / 32);
+	memcpy(ctx->block, p, len % 32);
+}
+
+uint64_t
+xxh64_final(
+struct xxh64_ctx *ctx)
+{
+    uint64_t h;
+    const uint8_t *p, *end;
+
+	if(ctx->length >= 32){
+	    h = ROL(ctx->v[0], 1) + ROL(ctx->v[1], 7) +
+		ROL(ctx->v[2], 12) + ROL(ctx->v[3], 18);
+	    h = merge_round(h, ctx->v[0]);
+	    h = merge_round(h, ctx->v[1]);
+	    h = merge_round(h, ctx->v[2]);
+	    h = merge_round(h, ctx->v[3]);
+	}
+	else
+	    h = ctx->seed + PRIME64_5;
+	h += ctx->length;
+
+	/* the bytes after the last stripe */
+	p = ctx->block;
+	end = p + ctx->length % 32;
+	for( ; p + 8 <= end; p += 8){
+	    h ^= round64(0, read64(p));
+	    h = ROL(h, 27) * PRIME64_1 + PRIME64_4;
+	}
+	if(p + 4 <= end){
+	    h ^= read32(p) * PRIME64_1;
+	    h = ROL(h, 23) * PRIME64_2 + PRIME64_3;
+	    p += 4;
+	}
+	for( ; p < end; p++){
+	    h ^= *p * PRIME64_5;
+	    h = ROL(h, 11) * PRIME64_1;
+	}
+
+	h ^= h >> 33;
+	h *= PRIME64_2;
+	h ^= h >> 29;
+	h *= PRIME64_3;
+	h ^= h >> 32;
+	return(h);
+}
+
+uint64_t
+xxh64(
+const void *data,
+size_t len,
+uint64_t seed)
+{
+    struct xxh64_ctx ctx;
+
+	xxh64_init(&ctx, seed);
+	xxh64_update(&ctx, data, len);
+	return(xxh64_final(&ctx));
+}
+
+static inline
+uint64_t
+read64(
+const uint8_t *p)
+{
+    uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap64(v);
+#endif
+	return(v);
+}
+
+static inline
+uint32_t
+read32(
+const uint8_t *p)
+{
+    uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap32(v);
+#endif
+	return(v);
+}
+
+static inline
+uint64_t
+round64(
+uint64_t acc,
+uint64_t input)
+{
+	acc += input * PRIME64_2;
+	acc = ROL(acc, 31);
+	return(acc * PRIME64_1);
+}
+
+static inline
+uint64_t
+merge_round(
+uint64_t acc,
+uint64_t v)
+{
+	acc ^= round64(0, v);
+	return(acc * PRIME64_1 + PRIME64_4);
+}
+
+/*
+ * stripes adds the nstripes 32 byte stripes at p to the accumulators, and
+ * returns the address after them.
+ */
+static
+const uint8_t *
+stripes(
+uint64_t v[4],
+const uint8_t *p,
+size_t nstripes)
+{
+    uint64_t v0, v1, v2, v3;
+
+	v0 = v[0];
+	v1 = v[1];
+	v2 = v[2];
+	v3 = v[3];
+	for( ; nstripes != 0; nstripes--, p += 32){
+	    v0 = round64(v0, read64(p));
+	    v1 = round64(v1, read64(p + 8));
+	    v2 = round64(v2, read64(p + 16));
+	    v3 = round64(v3, read64(p + 24));
+	}
+	v[0] = v0;
+	v[1] = v1;
+	v[2] = v2;
+	v[3] = v3;
+	return(p);
+}
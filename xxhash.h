@@ -0,0 +1,46 @@
+/*
+ * The XXH64 hash of xxHash, a fast non-cryptographic hash.
+ */
+#ifndef _XXHASH_H_
+#define _XXHASH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct xxh64_ctx {
+    uint64_t v[4];		/* the four accumulators */
+    uint64_t seed;		/* the seed the hash was started with */
+    uint64_t length;		/* number of bytes hashed */
+    uint8_t block[32];		/* bytes that don't fill a stripe yet */
+};
+
+/*
+ * xxh64_init() starts hashing a new message with the seed.
+ */
+extern void xxh64_init(
+    struct xxh64_ctx *ctx,
+    uint64_t seed);
+
+/*
+ * xxh64_update() adds the len bytes at data to the message.
+ */
+extern void xxh64_update(
+    struct xxh64_ctx *ctx,
+    const void *data,
+    size_t len);
+
+/*
+ * xxh64_final() returns the hash of the message.
+ */
+extern uint64_t xxh64_final(
+    struct xxh64_ctx *ctx);
+
+/*
+ * xxh64() returns the hash of the len bytes at data with the seed.
+ */
+extern uint64_t xxh64(
+    const void *data,
+    size_t len,
+    uint64_t seed);
+
+#endif /* _XXHASH_H_ */
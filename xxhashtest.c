@@ -0,0 +1,86 @@
+/*
+ * xxhashtest, run by make check, which checks xxhash.c against the test
+ * vectors of the reference xxhsum.
+ *
+ * The sanity buffer of xxhsum is hashed whole and in prefixes, with seed 0
+ * and with the seed xxhsum uses, both at once and fed to xxh64_update() in
+ * pieces of every size, so that the stripes and the bytes left over are
+ * checked across the boundaries of the updates too.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "xxhash.h"
+
+#define PRIME32 2654435761U
+#define SANITY_BUFFER_SIZE 101
+
+static const struct {
+    size_t len;		/* length of the prefix of the sanity buffer */
+    uint64_t seed;
+    uint64_t hash;	/* its XXH64 */
+} vectors[] = {
+    { 0, 0, 0xef46db3751d8e999ULL },
+    { 0, PRIME32, 0xac75fda2929b17efULL },
+    { 1, 0, 0x4fce394cc88952d8ULL },
+    { 1, PRIME32, 0x739840cb819fa723ULL },
+    { 14, 0, 0xcffa8db881bc3a3dULL },
+    { 14, PRIME32, 0x5b9611585efcc9cbULL },
+    { SANITY_BUFFER_SIZE, 0, 0x0eab543384f878adULL },
+    { SANITY_BUFFER_SIZE, PRIME32, 0xcaa65939306f1e21ULL },
+};
+#define NVECTORS (sizeof(vectors) / sizeof(vectors[0]))
+
+int
+main(
+int argc,
+char *argv[])
+{
+    uint8_t buf[SANITY_BUFFER_SIZE];
+    uint32_t byte_gen, i, failures;
+    size_t piece, pos, n;
+    uint64_t hash;
+    struct xxh64_ctx ctx;
+
+	byte_gen = PRIME32;
+	for(i = 0; i < SANITY_BUFFER_SIZE; i++){
+	    buf[i] = byte_gen >> 24;
+	    byte_gen *= byte_gen;
+	}
+
+	failures = 0;
+	for(i = 0; i < NVECTORS; i++){
+	    hash = xxh64(buf, vectors[i].len, vectors[i].seed);
+	    if(hash != vectors[i].hash){
+		printf("FAIL: XXH64 of %zu bytes with seed %llu is %016llx, "
+		       "not %016llx\n", vectors[i].len,
+		       (unsigned long long)vectors[i].seed,
+		       (unsigned long long)hash,
+		       (unsigned long long)vectors[i].hash);
+		failures++;
+	    }
+	    for(piece = 1; piece <= vectors[i].len; piece++){
+		xxh64_init(&ctx, vectors[i].seed);
+		for(pos = 0; pos < vectors[i].len; pos += n){
+		    n = vectors[i].len - pos < piece ? vectors[i].len - pos :
+						       piece;
+		    xxh64_update(&ctx, buf + pos, n);
+		}
+		hash = xxh64_final(&ctx);
+		if(hash != vectors[i].hash){
+		    printf("FAIL: XXH64 of %zu bytes with seed %llu in pieces "
+			   "of %zu is %016llx, not %016llx\n", vectors[i].len,
+			   (unsigned long long)vectors[i].seed, piece,
+			   (unsigned long long)hash,
+			   (unsigned long long)vectors[i].hash);
+		    failures++;
+		}
+	    }
+	}
+	if(failures != 0)
+	    return(1);
+	printf("xxhash: all %u test vectors passed\n", (uint32_t)NVECTORS);
+	return(0);
+}